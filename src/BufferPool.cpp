@@ -0,0 +1,124 @@
+/////////////////////////////////////////////////////////////////////
+/// file: BufferPool.cpp
+///
+/// summary: shared pool of I/O buffers grouped by size classes
+/////////////////////////////////////////////////////////////////////
+
+#include "BufferPool.h"
+
+/////////////////////////////////////////////////////////////////////
+// From the small metadata replies (GETATTR, ACCESS, LOOKUP) up to the
+// largest READ and READDIR replies. The number of idle buffers kept
+// shrinks as the buffers grow.
+static const struct
+{
+	size_t bufferSize;
+	size_t maxIdle;
+} SIZE_CLASSES[] = {
+	{ 4 * 1024, 256 },
+	{ 16 * 1024, 128 },
+	{ 64 * 1024, 64 },
+	{ 256 * 1024, 32 },
+	{ 1024 * 1024, 16 }
+};
+
+/////////////////////////////////////////////////////////////////////
+BufferPool::SizeClass::SizeClass(size_t size, size_t maxIdleBuffers)
+	: bufferSize(size)
+	, maxIdle(maxIdleBuffers)
+{}
+
+/////////////////////////////////////////////////////////////////////
+BufferPool::BufferPool()
+	: m_oversized(0, 0)
+{
+	for (const auto& sizeClass : SIZE_CLASSES)
+	{
+		m_classes.emplace_back(std::make_unique<SizeClass>(sizeClass.bufferSize, sizeClass.maxIdle));
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+BufferPool::~BufferPool()
+{}
+
+/////////////////////////////////////////////////////////////////////
+BufferPool::SizeClass& BufferPool::FindClass(size_t size)
+{
+	for (auto& sizeClass : m_classes)
+	{
+		if (size <= sizeClass->bufferSize)
+		{
+			return *sizeClass;
+		}
+	}
+	return m_oversized;
+}
+
+/////////////////////////////////////////////////////////////////////
+BufferPool::Buffer BufferPool::Acquire(size_t size)
+{
+	auto& sizeClass = FindClass(size);
+	const size_t capacity = (&sizeClass == &m_oversized) ? size : sizeClass.bufferSize;
+	std::unique_ptr<unsigned char[]> data;
+	{
+		std::scoped_lock<std::mutex> lock(sizeClass.lock);
+		++sizeClass.acquired;
+		++sizeClass.inUse;
+		if (!sizeClass.idle.empty())
+		{
+			data = std::move(sizeClass.idle.back());
+			sizeClass.idle.pop_back();
+		}
+		else
+		{
+			++sizeClass.allocated;
+		}
+	}
+
+	if (!data)
+	{
+		data = std::make_unique<unsigned char[]>(capacity);
+	}
+
+	return Buffer{ data.release(), capacity };
+}
+
+/////////////////////////////////////////////////////////////////////
+void BufferPool::Release(Buffer buffer)
+{
+	if (nullptr == buffer.data)
+	{
+		return;
+	}
+
+	std::unique_ptr<unsigned char[]> data(buffer.data);
+	auto& sizeClass = FindClass(buffer.capacity);
+	std::scoped_lock<std::mutex> lock(sizeClass.lock);
+	--sizeClass.inUse;
+	if (sizeClass.idle.size() < sizeClass.maxIdle)
+	{
+		sizeClass.idle.emplace_back(std::move(data));
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+std::vector<BufferPool::ClassStatistics> BufferPool::GetStatistics() const
+{
+	std::vector<ClassStatistics> result;
+	result.reserve(m_classes.size() + 1);
+
+	auto collect = [&result](const SizeClass& sizeClass) {
+		std::scoped_lock<std::mutex> lock(sizeClass.lock);
+		result.push_back({ sizeClass.bufferSize, sizeClass.inUse, sizeClass.idle.size(),
+			sizeClass.acquired, sizeClass.allocated });
+	};
+
+	for (const auto& sizeClass : m_classes)
+	{
+		collect(*sizeClass);
+	}
+	collect(m_oversized);
+
+	return result;
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+/////////////////////////////////////////////////////////////////////
+/// file: BufferPool.h
+///
+/// summary: shared pool of I/O buffers grouped by size classes
+/////////////////////////////////////////////////////////////////////
+
+#ifndef ICENFSD_BUFFERPOOL_H
+#define ICENFSD_BUFFERPOOL_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <mutex>
+
+class BufferPool
+{
+public:
+	struct Buffer
+	{
+		unsigned char* data = nullptr;
+		size_t capacity = 0;
+	};
+
+	struct ClassStatistics
+	{
+		size_t bufferSize;   // 0 for the buffers larger than the largest class
+		size_t inUse;        // buffers borrowed at the moment
+		size_t idle;         // buffers kept in the pool
+		uint64_t acquired;   // total number of borrows
+		uint64_t allocated;  // borrows which had to allocate a new buffer
+	};
+
+	BufferPool();
+	~BufferPool();
+
+	BufferPool(const BufferPool&) = delete;
+	BufferPool& operator=(const BufferPool&) = delete;
+
+	/// <summary> Borrow a buffer of at least the specified size </summary>
+	/// <param name="size"> Required capacity </param>
+	/// <returns> Buffer of the smallest fitting size class </returns>
+	Buffer Acquire(size_t size);
+	/// <summary> Return the borrowed buffer to the pool </summary>
+	/// <param name="buffer"> Buffer obtained from Acquire() </param>
+	void Release(Buffer buffer);
+	/// <summary> Get the pool occupancy </summary>
+	/// <returns> One entry per size class, the last one is for oversized buffers </returns>
+	std::vector<ClassStatistics> GetStatistics() const;
+
+private:
+	struct SizeClass
+	{
+		size_t bufferSize;
+		size_t maxIdle;
+		std::vector<std::unique_ptr<unsigned char[]>> idle;
+		size_t inUse = 0;
+		uint64_t acquired = 0;
+		uint64_t allocated = 0;
+		mutable std::mutex lock;
+
+		SizeClass(size_t size, size_t maxIdleBuffers);
+	};
+
+	std::vector<std::unique_ptr<SizeClass>> m_classes;
+	SizeClass m_oversized; // buffers above the largest class are never kept
+
+	SizeClass& FindClass(size_t size);
+};
+
+#endif // ICENFSD_BUFFERPOOL_H
\ No newline at end of file
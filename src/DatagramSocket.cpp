@@ -5,6 +5,7 @@
 /////////////////////////////////////////////////////////////////////
 
 #include "DatagramSocket.h"
+#include "SocketReactor.h"
 #include "Socket.h"
 
 #include <boost/algorithm/string/trim.hpp>
@@ -12,12 +13,13 @@
 #include <stdexcept>
 
 /////////////////////////////////////////////////////////////////////
-DatagramSocket::DatagramSocket(const sockaddr_in& endpoint, ISocketListener* listener)
+DatagramSocket::DatagramSocket(const sockaddr_in& endpoint, ISocketListener* listener, SocketReactor& reactor, WorkerPool& workers, BufferPool& bufferPool)
 	: m_address(17, ' ')
 	, m_socket(socket(AF_INET, SOCK_DGRAM, 0))
 	, m_pSocket(nullptr)
 	, m_closed(true)
 	, m_listener(listener)
+	, m_reactor(reactor)
 {
 	if (m_socket == INVALID_SOCKET)
 	{
@@ -41,9 +43,18 @@ DatagramSocket::DatagramSocket(const sockaddr_in& endpoint, ISocketListener* lis
 		throw std::runtime_error("failed to bind UDP socket at " + m_address);
 	}
 
+	// the queued datagrams are received in batches until none is left
+	u_long nonBlocking = 1;
+	if (ioctlsocket(m_socket, FIONBIO, &nonBlocking) == SOCKET_ERROR)
+	{
+		closesocket(m_socket);
+		throw std::runtime_error("failed to setup UDP socket at " + m_address);
+	}
+
 	m_closed = false;
-	m_pSocket = new Socket(SOCK_DGRAM);
-	m_pSocket->Open(m_socket, m_listener);  //wait for receiving data
+	m_pSocket = std::make_shared<Socket>(SOCK_DGRAM, bufferPool, workers);
+	m_pSocket->Open(m_socket, m_listener);
+	m_reactor.Register(m_pSocket);  //wait for receiving data
 }
 
 /////////////////////////////////////////////////////////////////////
@@ -67,5 +78,7 @@ void DatagramSocket::Close()
 	}
 
 	m_closed = true;
-	delete m_pSocket;
+	m_reactor.Unregister(m_pSocket.get());
+	m_pSocket->Close();
+	m_pSocket.reset();
 }
\ No newline at end of file
@@ -9,15 +9,19 @@
 
 #include <WinSock2.h>
 #include <cstdint>
+#include <memory>
 #include <string>
 
 class Socket;
+class BufferPool;
+class WorkerPool;
+class SocketReactor;
 class ISocketListener;
 
 class DatagramSocket
 {
 public:
-	DatagramSocket(const sockaddr_in& endpoint, ISocketListener* listener);
+	DatagramSocket(const sockaddr_in& endpoint, ISocketListener* listener, SocketReactor& reactor, WorkerPool& workers, BufferPool& bufferPool);
 	~DatagramSocket();
 
 	const std::string& GetAddress() const noexcept;
@@ -26,9 +30,10 @@ public:
 private:
 	std::string m_address;
 	SOCKET m_socket;
-	Socket* m_pSocket;
+	std::shared_ptr<Socket> m_pSocket;
 	bool m_closed;
 	ISocketListener* m_listener;
+	SocketReactor& m_reactor;
 };
 
 #endif // ICENFSD_DATAGRAMSOCKET_H
@@ -0,0 +1,121 @@
+/////////////////////////////////////////////////////////////////////
+/// file: DuplicateRequestCache.cpp
+///
+/// summary: replies of the non-idempotent requests for retransmissions
+/////////////////////////////////////////////////////////////////////
+
+#include "DuplicateRequestCache.h"
+#include <stdexcept>
+#include <iterator>
+
+/////////////////////////////////////////////////////////////////////
+bool DuplicateRequestCache::Key::operator==(const Key& other) const noexcept
+{
+	return address == other.address && xid == other.xid
+		&& prog == other.prog && vers == other.vers && proc == other.proc
+		&& length == other.length && checksum == other.checksum;
+}
+
+/////////////////////////////////////////////////////////////////////
+size_t DuplicateRequestCache::KeyHash::operator()(const Key& key) const noexcept
+{
+	// the xid is unique enough for a client, mix the rest in anyway
+	uint64_t hash = (static_cast<uint64_t>(key.address) << 32) | key.xid;
+	hash ^= (static_cast<uint64_t>(key.prog) << 40) ^ (static_cast<uint64_t>(key.vers) << 32) ^ key.proc;
+	hash ^= (static_cast<uint64_t>(key.length) << 32) ^ key.checksum;
+	hash *= 0x9E3779B97F4A7C15ULL;
+	return static_cast<size_t>(hash ^ (hash >> 32));
+}
+
+/////////////////////////////////////////////////////////////////////
+DuplicateRequestCache::DuplicateRequestCache(size_t capacity)
+	: m_capacity(capacity)
+{
+	if (0 == capacity)
+	{
+		throw std::runtime_error("duplicate request cache capacity must not be zero");
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+DuplicateRequestCache::Status DuplicateRequestCache::Begin(const Key& key, Reply& reply)
+{
+	std::scoped_lock<std::mutex> lock(m_lock);
+	const auto it = m_entries.find(key);
+	if (m_entries.end() != it)
+	{
+		if (!it->second.completed)
+		{
+			return Status::InProgress;
+		}
+
+		reply = it->second.reply;
+		return Status::Completed;
+	}
+
+	// Forget the oldest completed request to make room for the new one.
+	// The ones in progress are kept, or their retransmissions would be
+	// executed concurrently with them; there are no more of them than
+	// the requests being executed.
+	if (m_entries.size() >= m_capacity)
+	{
+		for (auto age = m_ages.begin(); m_ages.end() != age; ++age)
+		{
+			const auto oldest = m_entries.find(*age);
+			if (oldest->second.completed)
+			{
+				m_entries.erase(oldest);
+				m_ages.erase(age);
+				break;
+			}
+		}
+	}
+
+	m_ages.push_back(key);
+	m_entries.emplace(key, Entry{ false, Reply{}, std::prev(m_ages.end()) });
+	return Status::New;
+}
+
+/////////////////////////////////////////////////////////////////////
+void DuplicateRequestCache::Complete(const Key& key, Reply reply)
+{
+	std::scoped_lock<std::mutex> lock(m_lock);
+	const auto it = m_entries.find(key);
+	if (m_entries.end() != it)  // it may be pushed out by the newer ones already
+	{
+		it->second.completed = true;
+		it->second.reply = std::move(reply);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+void DuplicateRequestCache::Abandon(const Key& key)
+{
+	std::scoped_lock<std::mutex> lock(m_lock);
+	const auto it = m_entries.find(key);
+	if (m_entries.end() != it)
+	{
+		m_ages.erase(it->second.age);
+		m_entries.erase(it);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+size_t DuplicateRequestCache::GetSize()
+{
+	std::scoped_lock<std::mutex> lock(m_lock);
+	return m_entries.size();
+}
+
+/////////////////////////////////////////////////////////////////////
+uint32_t DuplicateRequestCache::GetChecksum(const unsigned char* data, size_t size) noexcept
+{
+	// FNV-1a, the head of the arguments has the file handle and the offset
+	uint32_t hash = 2166136261U;
+	const size_t length = size < CHECKSUM_SIZE ? size : CHECKSUM_SIZE;
+	for (size_t i = 0; i < length; i++)
+	{
+		hash = (hash ^ data[i]) * 16777619U;
+	}
+	return hash;
+}
\ No newline at end of file
@@ -0,0 +1,88 @@
+/////////////////////////////////////////////////////////////////////
+/// file: DuplicateRequestCache.h
+///
+/// summary: replies of the non-idempotent requests for retransmissions
+/////////////////////////////////////////////////////////////////////
+
+#ifndef ICENFSD_DUPLICATEREQUESTCACHE_H
+#define ICENFSD_DUPLICATEREQUESTCACHE_H
+
+#include <unordered_map>
+#include <cstdint>
+#include <vector>
+#include <mutex>
+#include <list>
+
+// Clients retransmit a request when the reply is late, executing
+// CREATE, REMOVE, RENAME etc. once more would fail or redo the work.
+// The cache remembers such requests by the client address and xid
+// and keeps their replies to send them again.
+class DuplicateRequestCache
+{
+public:
+	using Reply = std::vector<unsigned char>;
+
+	struct Key
+	{
+		uint32_t address;  // client IPv4 address, the port changes when TCP reconnects
+		uint32_t xid;
+		uint32_t prog;
+		uint32_t vers;
+		uint32_t proc;
+		uint32_t length;   // of the call arguments
+		uint32_t checksum; // of their head, a reused xid is told apart by them as Linux nfsd does
+
+		bool operator==(const Key& other) const noexcept;
+	};
+
+	enum class Status
+	{
+		New,        // the request has to be executed
+		InProgress, // the request is being executed, drop the retransmission
+		Completed   // the request is done, send the cached reply
+	};
+
+	DuplicateRequestCache(size_t capacity = DEFAULT_CAPACITY);
+
+	/// <summary> Look the request up and start tracking it if it is new </summary>
+	/// <param name="key"> Request identity </param>
+	/// <param name="reply"> Receives the cached reply if the request is completed </param>
+	/// <returns> State of the request </returns>
+	Status Begin(const Key& key, Reply& reply);
+	/// <summary> Store the reply of the request started by Begin() </summary>
+	/// <param name="key"> Request identity </param>
+	/// <param name="reply"> Reply bytes without the record marking </param>
+	void Complete(const Key& key, Reply reply);
+	/// <summary> Forget the request which failed, so a retransmission executes it again </summary>
+	/// <param name="key"> Request identity </param>
+	void Abandon(const Key& key);
+	/// <summary> Get amount of the tracked requests </summary>
+	size_t GetSize();
+	/// <summary> Get the checksum of the call arguments for the key </summary>
+	/// <param name="data"> Arguments following the call header </param>
+	/// <param name="size"> Amount of the argument bytes, only the first CHECKSUM_SIZE of them are summed </param>
+	static uint32_t GetChecksum(const unsigned char* data, size_t size) noexcept;
+
+	static constexpr size_t DEFAULT_CAPACITY = 1024;
+	static constexpr size_t CHECKSUM_SIZE = 256;
+
+private:
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const noexcept;
+	};
+
+	struct Entry
+	{
+		bool completed;
+		Reply reply;
+		std::list<Key>::iterator age;
+	};
+
+	const size_t m_capacity;
+	std::mutex m_lock;
+	std::unordered_map<Key, Entry, KeyHash> m_entries;
+	std::list<Key> m_ages;  // the oldest request first
+};
+
+#endif // ICENFSD_DUPLICATEREQUESTCACHE_H
\ No newline at end of file
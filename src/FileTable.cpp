@@ -27,32 +27,38 @@ static std::string GetLastSystemError()
 
 /////////////////////////////////////////////////////////////////////
 FileTable::FileTable(uint64_t rowSize)
-	: m_rowSizeLimit(rowSize)
-	, m_rowPos(0)
-{
-	// Add first row
-	m_table.emplace_back(TableRow{ m_rowSizeLimit });
-}
+	: m_table(rowSize)
+{}
 
 /////////////////////////////////////////////////////////////////////
 FileTable::~FileTable()
 {}
 
 /////////////////////////////////////////////////////////////////////
-uint64_t FileTable::GetHandleByPath(const std::string& path)
+uint64_t FileTable::GetHandleByPath(std::string_view path)
 {
-	auto node = m_tree.FindFileItemForPath(path);
+	uint64_t handle = 0;
+	if (m_paths.Find(path, handle))
+	{
+		return handle;
+	}
+
+	const std::string fullPath(path);
+	std::scoped_lock<std::mutex> lock(m_lock);
+	auto node = m_tree.FindFileItemForPath(fullPath);
 	if (node == nullptr)
 	{
-		node = AddItem(path);
+		node = AddItem(fullPath);
 	}
 
+	m_paths.Insert(fullPath, node->data.handle);
 	return node->data.handle;
 }
 
 /////////////////////////////////////////////////////////////////////
-bool FileTable::GetPathByHandle(uint64_t handle, std::string& path)
+bool FileTable::GetPathByHandle(uint64_t handle, std::pmr::string& path)
 {
+	std::scoped_lock<std::mutex> lock(m_lock);
 	auto node = GetItemByID(handle);
 	if (node != nullptr)
 	{
@@ -66,66 +72,36 @@ bool FileTable::GetPathByHandle(uint64_t handle, std::string& path)
 /////////////////////////////////////////////////////////////////////
 FileTree::Node FileTable::AddItem(const std::string& path)
 {
-	// Add new table row if needed
-	if (m_rowPos > 0 && (m_rowPos & (m_rowSizeLimit - 1)) == 0)
-	{
-		m_table.emplace_back(TableRow{ m_rowSizeLimit });
-	}
-
-	const uint64_t handle = m_rowPos; // handle in equal the index of the table
+	const uint64_t handle = m_table.GetSize(); // handle is equal to the index in the table
 	auto node = m_tree.AddItem(path, handle);
-	auto& lastRow = m_table.back();
+	m_table.Add(node);
 
-	lastRow[m_rowPos & (m_rowSizeLimit - 1)] = node;  //add the new item in the file table
-	++m_rowPos;
-
-	return node;  //return the pointer to the new item
+	return node;
 }
 
 /////////////////////////////////////////////////////////////////////
 FileTree::Node FileTable::GetItemByID(uint64_t id)
 {
-	if (id >= m_rowPos)
-	{
-		return nullptr;
-	}
-
-	uint64_t i = m_rowSizeLimit;
-	auto row = m_table.cbegin();
-	for (; i <= id; i += m_rowSizeLimit)
-	{
-		++row;
-	}
-
-	return (*row)[id + m_rowSizeLimit - i];
+	return m_table.Get(id);
 }
 
 /////////////////////////////////////////////////////////////////////
 bool FileTable::RemoveItem(const std::string& path)
 {
+	std::scoped_lock<std::mutex> lock(m_lock);
 	auto foundDeletedItem = m_tree.FindFileItemForPath(path);
 	if (foundDeletedItem != nullptr)
 	{
-		// Remove from table
-		const uint64_t handle = foundDeletedItem->data.handle;
-
-		if (handle >= m_rowPos)
+		if (foundDeletedItem->data.handle >= m_table.GetSize())
 		{
 			return false;
 		}
 
-		auto row = m_table.begin();
-		uint64_t i = m_rowSizeLimit;
-		for (; i <= handle; i += m_rowSizeLimit)
-		{
-			++row;
-		}
-
-		(*row)[handle + m_rowSizeLimit - i] = nullptr;
-
-		// Remove from table end
+		// Remove the node and everything below it from the table and the index
 		std::string fullPath;
 		m_tree.GetNodeFullPath(foundDeletedItem, fullPath);
+		m_paths.Erase(path);
+		MovePaths(foundDeletedItem, fullPath, nullptr);
 		m_tree.RemoveItem(fullPath);
 		return true;
 	}
@@ -134,24 +110,58 @@ bool FileTable::RemoveItem(const std::string& path)
 }
 
 /////////////////////////////////////////////////////////////////////
-bool FileTable::FileExists(const std::string& path)
+void FileTable::MovePaths(FileTree::Node node, const std::string& pathFrom, const std::string* pathTo)
+{
+	// The subtree is renamed along with the node or removed with it, so
+	// are the full paths of its nodes, the handles stay with the nodes.
+	// The placeholders the tree inserts on renames have no handle.
+	m_paths.Erase(pathFrom);
+	if (m_table.Get(node->data.handle) == node)
+	{
+		if (pathTo != nullptr)
+		{
+			m_paths.Insert(*pathTo, node->data.handle);
+		}
+		else
+		{
+			m_table.Clear(node->data.handle);
+		}
+	}
+
+	for (auto child = node->first_child; child != nullptr; child = child->next_sibling)
+	{
+		const std::string childPathFrom = pathFrom + "\\" + child->data.path;
+		if (pathTo != nullptr)
+		{
+			const std::string childPathTo = *pathTo + "\\" + child->data.path;
+			MovePaths(child, childPathFrom, &childPathTo);
+		}
+		else
+		{
+			MovePaths(child, childPathFrom, nullptr);
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+bool FileTable::FileExists(const char* path)
 {
 	struct _finddata_t fileinfo;
 
-	auto handle = _findfirst(path.c_str(), &fileinfo);
+	auto handle = _findfirst(path, &fileinfo);
 	_findclose(handle);
 
-	return handle == -1 ? false : strcmp(fileinfo.name, strrchr(path.c_str(), '\\') + 1) == 0;  //filename must match case
+	return handle == -1 ? false : strcmp(fileinfo.name, strrchr(path, '\\') + 1) == 0;  //filename must match case
 }
 
 /////////////////////////////////////////////////////////////////////
-uint64_t FileTable::GetFileHandle(const std::string& path)
+uint64_t FileTable::GetFileHandle(std::string_view path)
 {
 	return GetHandleByPath(path);
 }
 
 /////////////////////////////////////////////////////////////////////
-bool FileTable::GetFilePath(uint64_t handle, std::string& filePath)
+bool FileTable::GetFilePath(uint64_t handle, std::pmr::string& filePath)
 {
 	return GetPathByHandle(handle, filePath);
 }
@@ -159,6 +169,8 @@ bool FileTable::GetFilePath(uint64_t handle, std::string& filePath)
 /////////////////////////////////////////////////////////////////////
 errno_t FileTable::RenameFile(const std::string& pathFrom, const std::string& pathTo)
 {
+	// keep the lock over the rename so the tree never disagrees with the disk
+	std::scoped_lock<std::mutex> lock(m_lock);
 	auto node = m_tree.FindFileItemForPath(pathFrom);
 	if (node == nullptr)
 	{
@@ -172,7 +184,18 @@ errno_t FileTable::RenameFile(const std::string& pathFrom, const std::string& pa
 		return errno;
 	}
 
+	std::string fullPathFrom;
+	m_tree.GetNodeFullPath(node, fullPathFrom);
 	m_tree.RenameItem(pathFrom, pathTo);
+
+	// The tree keeps the node where it was if the new parent is unknown
+	std::string fullPathTo;
+	m_tree.GetNodeFullPath(node, fullPathTo);
+	m_paths.Erase(pathFrom);
+	if (fullPathTo != fullPathFrom)
+	{
+		MovePaths(node, fullPathFrom, &fullPathTo);
+	}
 	BOOST_LOG_TRIVIAL(debug) << "path " << pathFrom << " renamed to " << pathTo;
 	return 0;
 }
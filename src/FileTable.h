@@ -11,30 +11,35 @@
 
 #include <vector>
 #include <string>
-#include <list>
+#include <string_view>
+#include <memory_resource>
+#include <mutex>
 
 #include "FileTree.h"
+#include "HandleIndex.h"
+#include "PathIndex.h"
 
 class FileTable
 {
-	using TableRow = std::vector<FileTree::Node>;
-	using Table = std::list<TableRow>;
+	using Table = HandleIndex<FileTree::Node>;
 
 public:
 
 	FileTable(uint64_t rowSize = DEFAULT_ROW_SIZE);
 	~FileTable();
 
-	bool FileExists(const std::string& path);
-	uint64_t GetFileHandle(const std::string& path);
-	bool GetFilePath(uint64_t handle, std::string& filePath);
+	bool FileExists(const char* path);
+	uint64_t GetFileHandle(std::string_view path);
+	bool GetFilePath(uint64_t handle, std::pmr::string& filePath);
 	errno_t RenameFile(const std::string&, const std::string& pathTo);
 	errno_t RenameDirectory(const std::string& pathFrom, const std::string& pathTo);
 	errno_t RemoveFolder(const std::string& path);
 	errno_t RemoveFile(const std::string& path);
 
-	uint64_t GetHandleByPath(const std::string& path);
-	bool GetPathByHandle(uint64_t handle, std::string& path);
+	// The paths are looked up by view and given out in the string of the
+	// caller, so a request resolves the known ones without the heap
+	uint64_t GetHandleByPath(std::string_view path);
+	bool GetPathByHandle(uint64_t handle, std::pmr::string& path);
 
 	bool RemoveItem(const std::string& path);
 
@@ -43,11 +48,12 @@ protected:
 
 private:
 	FileTree m_tree;
-	Table m_table;
-	const uint64_t m_rowSizeLimit;
-	uint64_t m_rowPos;
+	Table m_table; // handle to node, the handles are given out in sequence
+	PathIndex m_paths; // full path to handle, changed only with the lock held
+	std::mutex m_lock; // guards the tree and the table
 
 	FileTree::Node GetItemByID(uint64_t id);
+	void MovePaths(FileTree::Node node, const std::string& pathFrom, const std::string* pathTo);
 };
 
 #endif // ICENFSD_FILETABLE_H
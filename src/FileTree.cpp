@@ -11,99 +11,84 @@
 #include <windows.h>
 #include <sys/stat.h>
 
-#include "conv.h"
+// The paths are in Cp932, where the second byte of a double-byte
+// character may be a backslash, so the separators are found by walking
+// the characters rather than the bytes. The components are views into
+// the given path.
 
 /////////////////////////////////////////////////////////////////////
-static std::string FirstDirname(const std::string& path)
+static bool IsLeadByte932(unsigned char c)
 {
-	auto wcs = ConvFromCp932(path.c_str());
-	if (wcs == nullptr)
-	{
-		return path.substr(0, path.find('\\'));
-	}
+	return (c >= 0x81 && c <= 0x9F) || (c >= 0xE0 && c <= 0xFC);
+}
 
-	auto wpath = std::basic_string<wchar_t>(wcs);
-	delete wcs;
+/////////////////////////////////////////////////////////////////////
+static bool IsTrailByte932(unsigned char c)
+{
+	return c >= 0x40 && c <= 0xFC && c != 0x7F;
+}
 
-	auto dest = ConvToCp932(wpath.substr(0, wpath.find(L'\\')).c_str());
-	if (dest == nullptr) {
-		return path.substr(0, path.find('\\'));
+/////////////////////////////////////////////////////////////////////
+static size_t FindSeparator932(std::string_view path, bool last)
+{
+	size_t found = std::string_view::npos;
+	for (size_t i = 0; i < path.size(); i++)
+	{
+		const unsigned char c = static_cast<unsigned char>(path[i]);
+		if (IsLeadByte932(c) && i + 1 < path.size() && IsTrailByte932(static_cast<unsigned char>(path[i + 1])))
+		{
+			++i; // skip the trail byte
+		}
+		else if (c == '\\')
+		{
+			found = i;
+			if (!last)
+			{
+				break;
+			}
+		}
 	}
+	return found;
+}
 
-	auto result = std::string(dest);
-	delete dest;
-
-	return result;
+/////////////////////////////////////////////////////////////////////
+static std::string_view FirstDirname(std::string_view path)
+{
+	return path.substr(0, FindSeparator932(path, false));
 }
 
 /////////////////////////////////////////////////////////////////////
-static std::string Dirname932(const std::string& path)
+static std::string_view Dirname932(std::string_view path)
 {
-	auto wcs = ConvFromCp932(path.c_str());
-	auto result = path.find('\\') != std::string::npos ? path.substr(0, path.find_last_of('\\')) : std::string("");
-	if (wcs == nullptr)
-	{
-		return result;
-	}
-	auto wpath = std::basic_string<wchar_t>(wcs);
-	delete wcs;
+	const size_t separator = FindSeparator932(path, true);
+	return separator != std::string_view::npos ? path.substr(0, separator) : std::string_view();
+}
 
-	if (wpath.find(L'\\') == std::basic_string<wchar_t>::npos)
-	{
-		return result;
-	}
-	auto dest = ConvToCp932(wpath.substr(0, wpath.find_last_of(L'\\')).c_str());
-	if (dest == nullptr)
-	{
-		return result;
-	}
-	result = std::string(dest);
-	delete dest;
-	return result;
+/////////////////////////////////////////////////////////////////////
+static std::string_view FollowingPath(std::string_view path)
+{
+	const size_t separator = FindSeparator932(path, false);
+	return separator != std::string_view::npos ? path.substr(separator + 1) : std::string_view();
 }
 
 /////////////////////////////////////////////////////////////////////
-static std::string FollowingPath(const std::string& path)
+static std::string_view Basename932(std::string_view path)
 {
-	auto wcs = ConvFromCp932(path.c_str());
-	if (wcs == nullptr)
-	{
-		return path.find('\\') != std::string::npos ? path.substr(path.find('\\') + 1) : std::string("");
-	}
-	auto wpath = std::basic_string<wchar_t>(wcs);
-	delete wcs;
-	if (wpath.find(L'\\') == std::basic_string<wchar_t>::npos)
-	{
-		return std::string("");
-	}
-	auto dest = ConvToCp932(wpath.substr(wpath.find(L'\\') + 1).c_str());
-	if (dest == nullptr)
-	{
-		return path.find('\\') != std::string::npos ? path.substr(path.find('\\') + 1) : std::string("");
-	}
-	auto result = std::string(dest);
-	delete dest;
-	return result;
+	const size_t separator = FindSeparator932(path, true);
+	return separator != std::string_view::npos ? path.substr(separator + 1) : path;
 }
 
 /////////////////////////////////////////////////////////////////////
-static std::string Basename932(const std::string& path)
+size_t FileTree::NameHash::operator()(std::string_view name) const noexcept
 {
-	auto wcs = ConvFromCp932(path.c_str());
-	if (wcs == nullptr)
-	{
-		return path.substr(path.find_last_of('\\') + 1);
-	}
-	auto wpath = std::basic_string<wchar_t>(wcs);
-	delete wcs;
-	auto dest = ConvToCp932(wpath.substr(wpath.find_last_of(L'\\') + 1).c_str());
-	if (dest == nullptr)
+	// FNV-1a of the name with the ASCII letters folded to lower case
+	uint64_t hash = 14695981039346656037ULL;
+	for (const char c : name)
 	{
-		return path.substr(path.find_last_of('\\') + 1);
+		const unsigned char folded = (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c - 'A' + 'a') : static_cast<unsigned char>(c);
+		hash = (hash ^ folded) * 1099511628211ULL;
 	}
-	auto result = std::string(dest);
-	delete dest;
-	return result;
+	return static_cast<size_t>(hash);
 }
 
 /////////////////////////////////////////////////////////////////////
@@ -124,11 +109,12 @@ FileTree::Node FileTree::AddItem(const std::string& absolutePath, uint64_t handl
 	{
 		// Check if the requested path belongs to an already registered parent node.
 		tree_node_<FileItem>* parentNode = FindParentNodeFromRootForPath(absolutePath);
-		item.path = Basename932(absolutePath);
+		item.path = std::string(Basename932(absolutePath));
 		// If a parent was found use th parent.
 		if (parentNode)
 		{
 			auto result = m_filesTree.append_child(tree<FileItem>::iterator_base(parentNode), item);
+			AddChild(parentNode, result.node);
 			return result.node;
 		}
 		else
@@ -148,6 +134,7 @@ void FileTree::RemoveItem(const std::string& absolutePath)
 {
 	auto node = FindNodeFromRootWithPath(absolutePath);
 	if (node != nullptr) {
+		RemoveChild(node->parent, node);
 		m_filesTree.erase(tree<FileItem>::iterator(node));
 	}
 }
@@ -160,14 +147,19 @@ void FileTree::RenameItem(const std::string& absolutePathFrom, const std::string
 
 	if (parentNode != nullptr && node != nullptr)
 	{
+		// The full paths of the node and all below it change, they are rebuilt when asked for
+		++m_generation;
 		if (m_filesTree.number_of_children(parentNode) < 1)
 		{
 			FileItem emptyItem{};
-			m_filesTree.append_child(tree<FileItem>::iterator_base(parentNode), emptyItem);
+			auto placeholder = m_filesTree.append_child(tree<FileItem>::iterator_base(parentNode), emptyItem);
+			AddChild(parentNode, placeholder.node);
 		}
+		RemoveChild(node->parent, node);
 		tree<FileItem>::iterator firstChild = m_filesTree.begin(parentNode);
 		m_filesTree.move_after(firstChild, tree<FileItem>::iterator(node));
-		node->data.path = absolutePathTo.substr(absolutePathTo.find_last_of('\\') + 1);
+		node->data.path = std::string(Basename932(absolutePathTo));
+		AddChild(parentNode, node);
 	}
 }
 
@@ -197,8 +189,7 @@ FileTree::Node FileTree::FindNodeFromRootWithPath(const std::string& path)
 	// Use the node.
 	if (path.find(rootPath) != std::string::npos)
 	{
-		std::string subPath = path.substr(m_topNode->path.length() + 1);
-		return FindNodeWithPathFromNode(subPath, m_topNode.node);
+		return FindNodeWithPathFromNode(std::string_view(path).substr(m_topNode->path.length() + 1), m_topNode.node);
 	}
 	else
 	{
@@ -220,8 +211,7 @@ FileTree::Node FileTree::FindNodeFromRootWithPath(const std::string& path)
 				// If the item path is part of the requested path this is a subpath.
 				// Use the the item as topNode and continue analyzing.
 				m_topNode = it;
-				std::string subPath = path.substr(itPath.length() + 1);
-				return FindNodeWithPathFromNode(subPath.c_str(), it.node);
+				return FindNodeWithPathFromNode(std::string_view(path).substr(itPath.length() + 1), it.node);
 			}
 		}
 	}
@@ -230,31 +220,116 @@ FileTree::Node FileTree::FindNodeFromRootWithPath(const std::string& path)
 }
 
 /////////////////////////////////////////////////////////////////////
-FileTree::Node FileTree::FindNodeWithPathFromNode(const std::string& path, tree_node_<FileItem>* node) const
+FileTree::Node FileTree::FindNodeWithPathFromNode(std::string_view path, tree_node_<FileItem>* node) const
 {
-	tree<FileItem>::sibling_iterator sib = m_filesTree.begin(node);
-	tree<FileItem>::sibling_iterator end = m_filesTree.end(node);
+	// One component after another, down from the node
+	while (node != nullptr)
+	{
+		const std::string_view currentPath = FirstDirname(path);
+		const std::string_view followingPath = FollowingPath(path);
+
+		node = FindChild(node, currentPath);
+		if (followingPath.empty())
+		{
+			break;
+		}
+		path = followingPath;
+	}
+	return node;
+}
 
-	std::string currentPath = FirstDirname(path);
-	std::string followingPath = FollowingPath(path);
-	bool currentLevel = followingPath.empty();
+/////////////////////////////////////////////////////////////////////
+FileTree::Node FileTree::FindChild(Node parent, std::string_view name) const
+{
+	const auto& children = parent->data.children;
+	if (children != nullptr)
+	{
+		auto it = children->nodes.find(name);
+		return it != children->nodes.end() ? it->second : nullptr;
+	}
 
-	while (sib != end)
+	for (auto child = parent->first_child; child != nullptr; child = child->next_sibling)
 	{
-		if (sib->path == currentPath)
+		if (child->data.path == name)
 		{
-			if (currentLevel)
-			{
-				return sib.node;
-			}
-			else
+			return child;
+		}
+	}
+	return nullptr;
+}
+
+/////////////////////////////////////////////////////////////////////
+void FileTree::AddChild(Node parent, Node child)
+{
+	auto& children = parent->data.children;
+	if (children != nullptr)
+	{
+		// The latest one of the same name wins, it has been renamed over the others
+		auto result = children->nodes.emplace(child->data.path, child);
+		if (!result.second)
+		{
+			result.first->second = child;
+			++children->shadowed;
+		}
+		return;
+	}
+
+	size_t count = 0;
+	for (auto sibling = parent->first_child; sibling != nullptr && count <= CHILD_INDEX_THRESHOLD; sibling = sibling->next_sibling)
+	{
+		++count;
+	}
+	if (count > CHILD_INDEX_THRESHOLD)
+	{
+		// The directory has grown large, index all its children
+		children = std::make_shared<ChildIndex>();
+		children->nodes.reserve(count * 2);
+		for (auto sibling = parent->first_child; sibling != nullptr; sibling = sibling->next_sibling)
+		{
+			if (sibling != child && !children->nodes.emplace(sibling->data.path, sibling).second)
 			{
-				return FindNodeWithPathFromNode(followingPath, sib.node);
+				++children->shadowed;
 			}
 		}
-		++sib;
+		AddChild(parent, child);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+void FileTree::RemoveChild(Node parent, Node child)
+{
+	if (parent == nullptr || parent->data.children == nullptr)
+	{
+		return;
+	}
+
+	auto& children = *parent->data.children;
+	auto it = children.nodes.find(child->data.path);
+	if (it == children.nodes.end())
+	{
+		return;
+	}
+	if (it->second != child)
+	{
+		--children.shadowed;
+		return;
+	}
+	children.nodes.erase(it);
+
+	// Another child of the same name is found by the name now, scan only if there can be one
+	if (children.shadowed == 0)
+	{
+		return;
+	}
+	for (auto sibling = parent->first_child; sibling != nullptr; sibling = sibling->next_sibling)
+	{
+		if (sibling != child && sibling->data.path == child->data.path)
+		{
+			children.nodes.emplace(sibling->data.path, sibling);
+			--children.shadowed;
+			break;
+		}
 	}
-	return nullptr;
 }
 
 /////////////////////////////////////////////////////////////////////
@@ -269,8 +344,8 @@ FileTree::Node FileTree::FindParentNodeFromRootForPath(const std::string& path)
 	{
 		return nullptr;
 	}
-	std::string currentPath = path.substr(rootPath.length() + 1);
-	std::string followingPath = Dirname932(currentPath);
+	const std::string_view currentPath = std::string_view(path).substr(rootPath.length() + 1);
+	const std::string_view followingPath = Dirname932(currentPath);
 	if (followingPath.empty())
 	{
 		return m_topNode.node;
@@ -284,13 +359,35 @@ FileTree::Node FileTree::FindParentNodeFromRootForPath(const std::string& path)
 /////////////////////////////////////////////////////////////////////
 void FileTree::GetNodeFullPath(tree_node_<FileItem>* node, std::string& path)
 {
-	// TODO: refactor this, we build string from bottom to top
-	path.append(node->data.path);
-	tree_node_<FileItem>* parentNode = node->parent;
-	while (parentNode != nullptr)
+	path.append(GetCachedFullPath(node));
+}
+
+/////////////////////////////////////////////////////////////////////
+void FileTree::GetNodeFullPath(tree_node_<FileItem>* node, std::pmr::string& path)
+{
+	// the path of a request, built in its arena
+	path.append(GetCachedFullPath(node));
+}
+
+/////////////////////////////////////////////////////////////////////
+const std::string& FileTree::GetCachedFullPath(Node node)
+{
+	// Built once from the full path of the parent, which is cached as well,
+	// and again only after a rename somewhere in the tree
+	FileItem& item = node->data;
+	if (item.fullPathGeneration != m_generation)
 	{
-		path.insert(0, "\\");
-		path.insert(0, parentNode->data.path);
-		parentNode = parentNode->parent;
+		if (node->parent == nullptr)
+		{
+			item.fullPath = item.path;
+		}
+		else
+		{
+			const std::string& parentPath = GetCachedFullPath(node->parent);
+			item.fullPath.reserve(parentPath.size() + 1 + item.path.size());
+			item.fullPath.assign(parentPath).append(1, '\\').append(item.path);
+		}
+		item.fullPathGeneration = m_generation;
 	}
+	return item.fullPath;
 }
\ No newline at end of file
@@ -7,34 +7,65 @@
 #ifndef ICENFSD_FILETREE_H
 #define ICENFSD_FILETREE_H
 
+#include <unordered_map>
+#include <string_view>
+#include <memory>
+#include <memory_resource>
 #include <string>
 #include "tree.hh"
 
 class FileTree
 {
 public:
+	struct FileItem;
+
+	// The names of the children hash alike whatever their case is, the
+	// way NTFS folds them, while the lookups still compare them exactly
+	struct NameHash
+	{
+		size_t operator()(std::string_view name) const noexcept;
+	};
+	struct ChildIndex
+	{
+		std::unordered_map<std::string_view, tree_node_<FileItem>*, NameHash> nodes; // names point into the children
+		size_t shadowed = 0; // children hidden by a later one of the same name
+	};
+
 	struct FileItem
 	{
 		std::string path;
 		uint64_t handle = 0;
 		bool cached = false;
+		std::shared_ptr<ChildIndex> children; // of a large directory, shared_ptr as the items are copied into the tree
+		std::string fullPath;            // built by GetNodeFullPath()
+		uint64_t fullPathGeneration = 0; // of the tree when the full path was built
 	};
 	using Node = tree_node_<FileItem>*;
 
+	// Directories of up to this many children are scanned, larger ones indexed
+	static constexpr size_t CHILD_INDEX_THRESHOLD = 32;
+
 	Node AddItem(const std::string& absolutePath, uint64_t handle);
 	void RemoveItem(const std::string& absolutePath);
 	void RenameItem(const std::string& absolutePathFrom, const std::string& absolutePathTo);
 
 	Node FindFileItemForPath(const std::string& absolutePath);
 	void GetNodeFullPath(Node node, std::string& fullPath);
+	void GetNodeFullPath(Node node, std::pmr::string& fullPath);
 
 private:
 	Node FindNodeFromRootWithPath(const std::string& path);
-	Node FindNodeWithPathFromNode(const std::string& path, tree_node_<FileItem>* node) const;
+	Node FindNodeWithPathFromNode(std::string_view path, tree_node_<FileItem>* node) const;
 	Node FindParentNodeFromRootForPath(const std::string& path) const;
+	Node FindChild(Node parent, std::string_view name) const;
+	void AddChild(Node parent, Node child);
+	void RemoveChild(Node parent, Node child);
+
+	const std::string& GetCachedFullPath(Node node);
 
 	tree<FileItem> m_filesTree;
 	tree<FileItem>::iterator m_topNode;
+	uint64_t m_generation = 1; // changes when the items are renamed, the full paths built before are stale then
 };
 
 #endif // ICENFSD_FILETREE_H
\ No newline at end of file
@@ -0,0 +1,93 @@
+/////////////////////////////////////////////////////////////////////
+/// file: HandleIndex.h
+///
+/// summary: constant time index of the file handles
+/////////////////////////////////////////////////////////////////////
+
+#ifndef ICENFSD_HANDLEINDEX_H
+#define ICENFSD_HANDLEINDEX_H
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Handles are given out in sequence and never reused, so the index is a
+// directory of equally sized chunks: handle N is the slot N % chunk size
+// of the chunk N / chunk size. The chunk size is a power of two, so the
+// lookup is a shift, a mask and two loads whatever the handle is. The
+// chunks never move once allocated, only the directory grows.
+template <typename T>
+class HandleIndex
+{
+public:
+	explicit HandleIndex(uint64_t chunkSize)
+		: m_chunkSize(chunkSize)
+		, m_shift(0)
+		, m_size(0)
+	{
+		if (chunkSize == 0 || (chunkSize & (chunkSize - 1)) != 0)
+		{
+			throw std::runtime_error("handle index chunk size " + std::to_string(chunkSize) + " is not a power of two");
+		}
+		while ((uint64_t{ 1 } << m_shift) < chunkSize)
+		{
+			++m_shift;
+		}
+	}
+
+	HandleIndex(const HandleIndex&) = delete;
+	HandleIndex& operator=(const HandleIndex&) = delete;
+
+	/// <summary> Store the value under the next handle </summary>
+	/// <returns> Handle of the value </returns>
+	uint64_t Add(T value)
+	{
+		if ((m_size & (m_chunkSize - 1)) == 0)
+		{
+			m_chunks.emplace_back(new T[static_cast<size_t>(m_chunkSize)]());
+		}
+		const uint64_t handle = m_size++;
+		At(handle) = value;
+		return handle;
+	}
+
+	/// <summary> Get the value stored under the handle </summary>
+	/// <returns> Default value for the handles not given out yet </returns>
+	T Get(uint64_t handle) const noexcept
+	{
+		return handle < m_size ? At(handle) : T{};
+	}
+
+	/// <summary> Forget the value stored under the handle, the handle is not given out again </summary>
+	/// <returns> true if the handle has been given out </returns>
+	bool Clear(uint64_t handle) noexcept
+	{
+		if (handle >= m_size)
+		{
+			return false;
+		}
+		At(handle) = T{};
+		return true;
+	}
+
+	/// <summary> Get the handle to be given out next </summary>
+	uint64_t GetSize() const noexcept
+	{
+		return m_size;
+	}
+
+private:
+	std::vector<std::unique_ptr<T[]>> m_chunks;
+	const uint64_t m_chunkSize;
+	unsigned int m_shift;
+	uint64_t m_size;
+
+	T& At(uint64_t handle) const noexcept
+	{
+		return m_chunks[static_cast<size_t>(handle >> m_shift)][static_cast<size_t>(handle & (m_chunkSize - 1))];
+	}
+};
+
+#endif // ICENFSD_HANDLEINDEX_H
\ No newline at end of file
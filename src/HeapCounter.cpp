@@ -0,0 +1,99 @@
+/////////////////////////////////////////////////////////////////////
+/// file: HeapCounter.cpp
+///
+/// summary: counts of the heap allocations of the threads
+/////////////////////////////////////////////////////////////////////
+
+#include "HeapCounter.h"
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+
+#ifndef ICENFSD_HEAP_COUNTER
+#error HeapCounter.cpp replaces the global operator new, it is built with ICENFSD_HEAP_COUNTER only
+#endif
+
+static thread_local uint64_t threadAllocations = 0;
+
+/////////////////////////////////////////////////////////////////////
+uint64_t HeapCounter::GetThreadAllocations() noexcept
+{
+	return threadAllocations;
+}
+
+/////////////////////////////////////////////////////////////////////
+void* operator new(size_t size)
+{
+	++threadAllocations;
+	void* data = malloc(size > 0 ? size : 1);
+	if (data == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return data;
+}
+
+/////////////////////////////////////////////////////////////////////
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	++threadAllocations;
+	return malloc(size > 0 ? size : 1);
+}
+
+/////////////////////////////////////////////////////////////////////
+void operator delete(void* data) noexcept
+{
+	free(data);
+}
+
+/////////////////////////////////////////////////////////////////////
+void operator delete(void* data, size_t) noexcept
+{
+	free(data);
+}
+
+/////////////////////////////////////////////////////////////////////
+void operator delete(void* data, const std::nothrow_t&) noexcept
+{
+	free(data);
+}
+
+// The over-aligned allocations, std::pmr::new_delete_resource() takes
+// its memory through these
+
+/////////////////////////////////////////////////////////////////////
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	++threadAllocations;
+	void* data = _aligned_malloc(size > 0 ? size : 1, static_cast<size_t>(alignment));
+	if (data == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return data;
+}
+
+/////////////////////////////////////////////////////////////////////
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	++threadAllocations;
+	return _aligned_malloc(size > 0 ? size : 1, static_cast<size_t>(alignment));
+}
+
+/////////////////////////////////////////////////////////////////////
+void operator delete(void* data, std::align_val_t) noexcept
+{
+	_aligned_free(data);
+}
+
+/////////////////////////////////////////////////////////////////////
+void operator delete(void* data, size_t, std::align_val_t) noexcept
+{
+	_aligned_free(data);
+}
+
+/////////////////////////////////////////////////////////////////////
+void operator delete(void* data, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	_aligned_free(data);
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+/////////////////////////////////////////////////////////////////////
+/// file: HeapCounter.h
+///
+/// summary: counts of the heap allocations of the threads
+/////////////////////////////////////////////////////////////////////
+
+#ifndef ICENFSD_HEAPCOUNTER_H
+#define ICENFSD_HEAPCOUNTER_H
+
+#include <cstdint>
+
+// The global operator new is replaced to count the allocations of the
+// calling thread, so a request may tell how many it has made. It is
+// built only with ICENFSD_HEAP_COUNTER defined, the counts are 0 otherwise.
+class HeapCounter
+{
+public:
+#ifdef ICENFSD_HEAP_COUNTER
+	static constexpr bool ENABLED = true;
+
+	/// <summary> Get amount of the heap allocations made by the calling thread so far </summary>
+	static uint64_t GetThreadAllocations() noexcept;
+#else
+	static constexpr bool ENABLED = false;
+
+	static uint64_t GetThreadAllocations() noexcept
+	{
+		return 0;
+	}
+#endif
+};
+
+#endif // ICENFSD_HEAPCOUNTER_H
\ No newline at end of file
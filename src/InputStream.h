@@ -25,6 +25,11 @@ public:
 	/// <param name="value"> Pointer to the buffer to store data</param>
 	/// <returns> Amount of bytes actually read (have to be 8) </returns>
 	virtual size_t Read8(uint64_t* value) = 0;
+	/// <summary> Read an array of uint32_t values from the stream at once </summary>
+	/// <param name="values"> Pointer to the buffer to store the values </param>
+	/// <param name="count"> Amount of the values to read </param>
+	/// <returns> Amount of the values actually read </returns>
+	virtual size_t ReadWords(uint32_t* values, size_t count) = 0;
 	/// <summary> Skip specified amount of bytes in the stream </summary>
 	/// <param name="size"> Amount of bytes to skip </param>
 	/// <returns> Amount of bytes actually skipped </returns>
@@ -32,6 +37,9 @@ public:
 	/// <summary> Get amount of bytes to read in the stream </summary>
 	/// <returns> Amount of bytes available in the stream to read </returns>
 	virtual size_t GetSize() const noexcept = 0;
+	/// <summary> Get the bytes left to read in the stream, GetSize() of them </summary>
+	/// <returns> Pointer to the data, valid until the stream is changed </returns>
+	virtual const unsigned char* GetData() const noexcept = 0;
 };
 
 #endif // ICENFSD_INPUTSTREAM_H
@@ -6,8 +6,7 @@
 
 #include "MountProg.h"
 #include "FileTable.h"
-#include "InputStream.h"
-#include "OutputStream.h"
+#include "XdrStream.h"
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/replace.hpp>
@@ -51,7 +50,7 @@ MountProg::MountProg(std::shared_ptr<FileTable> fileTable)
 {}
 
 /////////////////////////////////////////////////////////////////////
-void MountProg::Export(const std::string& path, const std::string& alias)
+std::string MountProg::Export(const std::string& path, const std::string& alias)
 {
 	const auto formattedPath = FormatPath(path, FORMAT_PATH);
 	const auto formattedAlias = FormatPath(alias, FORMAT_PATHALIAS);
@@ -63,12 +62,13 @@ void MountProg::Export(const std::string& path, const std::string& alias)
 
 	m_pathMap[alias] = formattedPath;
 	BOOST_LOG_TRIVIAL(debug) << "MOUNT: add export " << alias << '=' << formattedPath;
+	return formattedPath;
 }
 
 /////////////////////////////////////////////////////////////////////
-int MountProg::Process(IInputStream& inStream, IOutputStream& outStream, RPCParam& param)
+int MountProg::Process(XdrReader& inStream, XdrWriter& outStream, RPCParam& param)
 {
-	typedef int (MountProg::* PPROC)(IInputStream&, IOutputStream&, RPCParam&);
+	typedef int (MountProg::* PPROC)(XdrReader&, XdrWriter&, RPCParam&);
 	static PPROC pf[] = { &MountProg::ProcedureNULL, &MountProg::ProcedureMNT, &MountProg::ProcedureNOIMP,
 		&MountProg::ProcedureUMNT, &MountProg::ProcedureUMNTALL, &MountProg::ProcedureEXPORT };
 
@@ -82,14 +82,14 @@ int MountProg::Process(IInputStream& inStream, IOutputStream& outStream, RPCPara
 }
 
 /////////////////////////////////////////////////////////////////////
-int MountProg::ProcedureNULL(IInputStream&, IOutputStream&, RPCParam&) noexcept
+int MountProg::ProcedureNULL(XdrReader&, XdrWriter&, RPCParam&) noexcept
 {
 	BOOST_LOG_TRIVIAL(debug) << "MOUNT: NULL command";
 	return PRC_OK;
 }
 
 /////////////////////////////////////////////////////////////////////
-int MountProg::ProcedureMNT(IInputStream& inStream, IOutputStream& outStream, RPCParam& param) noexcept
+int MountProg::ProcedureMNT(XdrReader& inStream, XdrWriter& outStream, RPCParam& param) noexcept
 {
 	BOOST_LOG_TRIVIAL(debug) << "MOUNT: MNT command, version=" << param.version << ", from " << param.remoteAddr;
 	const auto path = GetPath(inStream);
@@ -114,16 +114,18 @@ int MountProg::ProcedureMNT(IInputStream& inStream, IOutputStream& outStream, RP
 		outStream.Write(0);  //flavor
 	}
 
+	std::scoped_lock<std::mutex> lock(m_clientsLock);
 	m_clients.push_back(param.remoteAddr); //remember the client address
 	return PRC_OK;
 }
 
 /////////////////////////////////////////////////////////////////////
-int MountProg::ProcedureUMNT(IInputStream& inStream, IOutputStream&, RPCParam& param) noexcept
+int MountProg::ProcedureUMNT(XdrReader& inStream, XdrWriter&, RPCParam& param) noexcept
 {
 	BOOST_LOG_TRIVIAL(debug) << "MOUNT: UMNT command, version=" << param.version << ", from " << param.remoteAddr;
 	const auto path = GetPath(inStream);
 
+	std::scoped_lock<std::mutex> lock(m_clientsLock);
 	auto client = std::find(m_clients.begin(), m_clients.end(), param.remoteAddr);
 	if (m_clients.end() != client)
 	{
@@ -133,7 +135,7 @@ int MountProg::ProcedureUMNT(IInputStream& inStream, IOutputStream&, RPCParam& p
 }
 
 /////////////////////////////////////////////////////////////////////
-int MountProg::ProcedureEXPORT(IInputStream&, IOutputStream& outStream, RPCParam& param) noexcept
+int MountProg::ProcedureEXPORT(XdrReader&, XdrWriter& outStream, RPCParam& param) noexcept
 {
 	BOOST_LOG_TRIVIAL(debug) << "MOUNT: EXPORT command, version=" << param.version << ", from " << param.remoteAddr;
 
@@ -165,31 +167,32 @@ int MountProg::ProcedureEXPORT(IInputStream&, IOutputStream& outStream, RPCParam
 }
 
 /////////////////////////////////////////////////////////////////////
-int MountProg::ProcedureUMNTALL(IInputStream&, IOutputStream&, RPCParam&) noexcept
+int MountProg::ProcedureUMNTALL(XdrReader&, XdrWriter&, RPCParam&) noexcept
 {
 	BOOST_LOG_TRIVIAL(debug) << "MOUNT: UMNTALL command (not implemented)";
 	return PRC_NOTIMP;
 }
 
 /////////////////////////////////////////////////////////////////////
-int MountProg::ProcedureNOIMP(IInputStream&, IOutputStream&, RPCParam&) noexcept
+int MountProg::ProcedureNOIMP(XdrReader&, XdrWriter&, RPCParam&) noexcept
 {
 	BOOST_LOG_TRIVIAL(debug) << "MOUNT: NOIMP command (not implemented)";
 	return PRC_NOTIMP;
 }
 
 /////////////////////////////////////////////////////////////////////
-std::string MountProg::GetPath(IInputStream& inStream)
+std::string MountProg::GetPath(XdrReader& inStream)
 {
 	bool foundPath = false;
 	std::string finalPath;
 
-	// Read size of path
+	// Read size of path, it has to be there in full
 	uint32_t pathSize = 0;
 	inStream.Read(&pathSize);
-	if (pathSize > MAXPATHLEN)
+	if (pathSize > MAXPATHLEN || pathSize > inStream.GetSize())
 	{
-		pathSize = MAXPATHLEN;
+		BOOST_LOG_TRIVIAL(warning) << "MOUNT: invalid path length " << pathSize;
+		return finalPath;
 	}
 
 	// Read path
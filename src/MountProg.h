@@ -11,6 +11,7 @@
 #include <vector>
 #include <memory>
 #include <string>
+#include <mutex>
 #include <map>
 
 #define MOUNT_NUM_MAX 100
@@ -30,25 +31,26 @@ public:
 	MountProg(std::shared_ptr<FileTable> fileTable);
 	virtual ~MountProg() = default;
 
-	void Export(const std::string& path, const std::string& alias);
-	int Process(IInputStream& inStream, IOutputStream& outStream, RPCParam& param) override;
+	std::string Export(const std::string& path, const std::string& alias);
+	int Process(XdrReader& inStream, XdrWriter& outStream, RPCParam& param) override;
 
 protected:
 	std::string m_pathFile;
 	std::map<std::string, std::string> m_pathMap;
 	std::vector<std::string> m_clients;
+	std::mutex m_clientsLock;
 
-	int ProcedureNULL(IInputStream& inStream, IOutputStream& outStream, RPCParam& param) noexcept;
-	int ProcedureMNT(IInputStream& inStream, IOutputStream& outStream, RPCParam& param) noexcept;
-	int ProcedureUMNT(IInputStream& inStream, IOutputStream& outStream, RPCParam& param) noexcept;
-	int ProcedureUMNTALL(IInputStream& inStream, IOutputStream& outStream, RPCParam& param) noexcept;
-	int ProcedureEXPORT(IInputStream& inStream, IOutputStream& outStream, RPCParam& param) noexcept;
-	int ProcedureNOIMP(IInputStream& inStream, IOutputStream& outStream, RPCParam& param) noexcept;
+	int ProcedureNULL(XdrReader& inStream, XdrWriter& outStream, RPCParam& param) noexcept;
+	int ProcedureMNT(XdrReader& inStream, XdrWriter& outStream, RPCParam& param) noexcept;
+	int ProcedureUMNT(XdrReader& inStream, XdrWriter& outStream, RPCParam& param) noexcept;
+	int ProcedureUMNTALL(XdrReader& inStream, XdrWriter& outStream, RPCParam& param) noexcept;
+	int ProcedureEXPORT(XdrReader& inStream, XdrWriter& outStream, RPCParam& param) noexcept;
+	int ProcedureNOIMP(XdrReader& inStream, XdrWriter& outStream, RPCParam& param) noexcept;
 
 	std::string FormatPath(const std::string& path, PathFormat format) const;
 
 private:
-	std::string GetPath(IInputStream& inStreams);
+	std::string GetPath(XdrReader& inStreams);
 
 	std::shared_ptr<FileTable> m_fileTable;
 };
@@ -7,8 +7,8 @@
 #pragma comment(lib, "Shlwapi.lib")
 #include "NFS3Prog.h"
 #include "FileTable.h"
-#include "InputStream.h"
-#include "OutputStream.h"
+#include "RequestArena.h"
+#include "XdrStream.h"
 #include <string.h>
 #include <io.h>
 #include <direct.h>
@@ -20,6 +20,7 @@
 #include <share.h>
 #include <shlwapi.h>
 
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/log/trivial.hpp>
 #define BUFFER_SIZE 1000
 
@@ -28,6 +29,7 @@ struct Opaque
 {
 	uint32_t length;
 	unsigned char* contents;
+	bool inArena;  // the contents belong to the arena of the request
 
 	Opaque();
 	Opaque(uint32_t len);
@@ -35,6 +37,14 @@ struct Opaque
 	virtual void SetSize(uint32_t len);
 };
 
+/////////////////////////////////////////////////////////////////////
+// Opaque data left in the received message, e.g. the WRITE payload
+struct OpaqueView
+{
+	uint32_t length;
+	const unsigned char* contents;
+};
+
 /////////////////////////////////////////////////////////////////////
 struct NFSv3FileHandle : public Opaque
 {
@@ -103,6 +113,31 @@ struct FAttr3
 	NFSTime3 ctime;
 };
 
+/////////////////////////////////////////////////////////////////////
+template <>
+struct XdrFields<SpecData3>
+{
+	static constexpr auto members = std::make_tuple(&SpecData3::specdata1, &SpecData3::specdata2);
+};
+
+/////////////////////////////////////////////////////////////////////
+template <>
+struct XdrFields<NFSTime3>
+{
+	static constexpr auto members = std::make_tuple(&NFSTime3::seconds, &NFSTime3::nseconds);
+};
+
+/////////////////////////////////////////////////////////////////////
+template <>
+struct XdrFields<FAttr3>
+{
+	static constexpr auto members = std::make_tuple(&FAttr3::type, &FAttr3::mode, &FAttr3::nlink,
+		&FAttr3::uid, &FAttr3::gid, &FAttr3::size, &FAttr3::used, &FAttr3::rdev, &FAttr3::fsid,
+		&FAttr3::fileid, &FAttr3::atime, &FAttr3::mtime, &FAttr3::ctime);
+};
+
+static_assert(XdrSize<FAttr3> == 84, "fattr3 takes 84 bytes on the wire");
+
 /////////////////////////////////////////////////////////////////////
 struct PostOpAttr
 {
@@ -118,6 +153,15 @@ struct WccAttr
 	NFSTime3 ctime;
 };
 
+/////////////////////////////////////////////////////////////////////
+template <>
+struct XdrFields<WccAttr>
+{
+	static constexpr auto members = std::make_tuple(&WccAttr::size, &WccAttr::mtime, &WccAttr::ctime);
+};
+
+static_assert(XdrSize<WccAttr> == 24, "wcc_attr takes 24 bytes on the wire");
+
 /////////////////////////////////////////////////////////////////////
 struct PreOpAttr
 {
@@ -339,6 +383,12 @@ enum
 	FSF3_CANSETTIME = 0x0010
 };
 
+/////////////////////////////////////////////////////////////////////
+// Transfer sizes told by FSINFO, the READ replies are cut to it and
+// the longer WRITE payloads are refused
+constexpr uint32_t NFS3_RTMAX = 65536;
+constexpr uint32_t NFS3_WTMAX = 65536;
+
 /////////////////////////////////////////////////////////////////////
 enum
 {
@@ -368,27 +418,39 @@ Opaque::Opaque()
 {
 	length = 0;
 	contents = NULL;
+	inArena = false;
 }
 
 /////////////////////////////////////////////////////////////////////
 Opaque::Opaque(uint32_t len)
 {
 	contents = NULL;
+	inArena = false;
 	SetSize(len);
 }
 
 /////////////////////////////////////////////////////////////////////
 Opaque::~Opaque()
 {
-	delete[] contents;
+	if (!inArena)
+	{
+		delete[] contents;
+	}
 }
 
 /////////////////////////////////////////////////////////////////////
 void Opaque::SetSize(uint32_t len)
 {
-	delete[] contents;
+	if (!inArena)
+	{
+		delete[] contents;
+	}
+
+	// handles and names live as long as the procedure, the arena is rewound after it
+	RequestArena* arena = RequestArena::GetCurrent();
+	inArena = arena != nullptr;
 	length = len;
-	contents = new unsigned char[length];
+	contents = inArena ? static_cast<unsigned char*>(arena->allocate(length, 1)) : new unsigned char[length];
 	memset(contents, 0, length);
 }
 
@@ -440,7 +502,7 @@ void NFSv3Path::Set(char* str)
 }
 
 /////////////////////////////////////////////////////////////////////
-void Read(IInputStream& inStream, bool& value)
+void Read(XdrReader& inStream, bool& value)
 {
 	uint32_t b = 0;
 
@@ -453,7 +515,7 @@ void Read(IInputStream& inStream, bool& value)
 }
 
 /////////////////////////////////////////////////////////////////////
-void Read(IInputStream& inStream, uint32_t& value)
+void Read(XdrReader& inStream, uint32_t& value)
 {
 	if (inStream.Read(&value) < sizeof(uint32_t))
 	{
@@ -462,7 +524,7 @@ void Read(IInputStream& inStream, uint32_t& value)
 }
 
 /////////////////////////////////////////////////////////////////////
-void Read(IInputStream& inStream, uint64_t& value)
+void Read(XdrReader& inStream, uint64_t& value)
 {
 	if (inStream.Read8(&value) < sizeof(uint64_t))
 	{
@@ -471,14 +533,14 @@ void Read(IInputStream& inStream, uint64_t& value)
 }
 
 /////////////////////////////////////////////////////////////////////
-void Read(IInputStream& inStream, NFSTime3& value)
+void Read(XdrReader& inStream, NFSTime3& value)
 {
 	Read(inStream, value.seconds);
 	Read(inStream, value.nseconds);
 }
 
 /////////////////////////////////////////////////////////////////////
-void Read(IInputStream& inStream, SAttr3& value)
+void Read(XdrReader& inStream, SAttr3& value)
 {
 	Read(inStream, value.mode.setIt);
 	if (value.mode.setIt)
@@ -518,7 +580,7 @@ void Read(IInputStream& inStream, SAttr3& value)
 }
 
 /////////////////////////////////////////////////////////////////////
-void Read(IInputStream& inStream, SAttrGuard3& value)
+void Read(XdrReader& inStream, SAttrGuard3& value)
 {
 	Read(inStream, value.check);
 
@@ -529,38 +591,77 @@ void Read(IInputStream& inStream, SAttrGuard3& value)
 }
 
 /////////////////////////////////////////////////////////////////////
-void Read(IInputStream& inStream, Opaque& value)
+// The length of the variable-size data is checked against the limit of
+// its type and against the rest of the message before anything is
+// allocated for it, the clients must not make us take gigabytes
+uint32_t ReadLength(XdrReader& inStream, uint32_t maxSize)
 {
 	uint32_t len = 0;
-
 	Read(inStream, len);
-	value.SetSize(len);
 
-	if (inStream.Read(value.contents, len) < len)
+	if (len > maxSize)
 	{
-		throw std::runtime_error("read failed");
+		throw std::runtime_error("opaque data of " + std::to_string(len) + " bytes exceeds the limit of " + std::to_string(maxSize));
 	}
 
-	len = 4 - (len & 3);
-	if (len != 4)
+	const size_t padded = (static_cast<size_t>(len) + 3) & ~static_cast<size_t>(3);
+	if (padded > inStream.GetSize())
 	{
-		uint32_t byte = 0;
-		if (inStream.Read(&byte, len) < len)
-		{
-			throw std::runtime_error("read failed");
-		}
+		throw std::runtime_error("opaque data of " + std::to_string(len) + " bytes is truncated");
 	}
+
+	return len;
+}
+
+/////////////////////////////////////////////////////////////////////
+void Read(XdrReader& inStream, Opaque& value, uint32_t maxSize)
+{
+	const uint32_t len = ReadLength(inStream, maxSize);
+	value.SetSize(len);
+	inStream.Read(value.contents, len);
+	inStream.Skip((4 - (len & 3)) & 3);
+}
+
+/////////////////////////////////////////////////////////////////////
+void Read(XdrReader& inStream, NFSv3FileHandle& value)
+{
+	// the handle has its buffer of the maximal size already
+	const uint32_t len = ReadLength(inStream, NFS3_FHSIZE);
+	memset(value.contents, 0, NFS3_FHSIZE);
+	inStream.Read(value.contents, len);
+	value.length = len;
+	inStream.Skip((4 - (len & 3)) & 3);
+}
+
+/////////////////////////////////////////////////////////////////////
+void Read(XdrReader& inStream, NFSv3Filename& value)
+{
+	Read(inStream, value, MAXNAMELEN);
+}
+
+/////////////////////////////////////////////////////////////////////
+void Read(XdrReader& inStream, NFSv3Path& value)
+{
+	Read(inStream, value, MAXPATHLEN);
 }
 
 /////////////////////////////////////////////////////////////////////
-void Read(IInputStream& inStream, DirOpArgs3& value)
+void Read(XdrReader& inStream, OpaqueView& value, uint32_t maxSize)
+{
+	value.length = ReadLength(inStream, maxSize);
+	value.contents = inStream.View(value.length);  // not copied, the message outlives the procedure
+	inStream.Skip((4 - (value.length & 3)) & 3);
+}
+
+/////////////////////////////////////////////////////////////////////
+void Read(XdrReader& inStream, DirOpArgs3& value)
 {
 	Read(inStream, value.dir);
 	Read(inStream, value.name);
 }
 
 /////////////////////////////////////////////////////////////////////
-void Read(IInputStream& inStream, CreateHow3& value)
+void Read(XdrReader& inStream, CreateHow3& value)
 {
 	Read(inStream, value.mode);
 	if (value.mode == UNCHECKED || value.mode == GUARDED)
@@ -574,65 +675,58 @@ void Read(IInputStream& inStream, CreateHow3& value)
 }
 
 /////////////////////////////////////////////////////////////////////
-void Read(IInputStream& inStream, SymlinkData3& value)
+void Read(XdrReader& inStream, SymlinkData3& value)
 {
 	Read(inStream, value.symlinkAttributes);
 	Read(inStream, value.symlinkData);
 }
 
 /////////////////////////////////////////////////////////////////////
-void Write(IOutputStream& outStream, const bool value)
+void Write(XdrWriter& outStream, const bool value)
 {
 	const uint32_t toWrite = value ? 1 : 0;
 	outStream.Write(toWrite);
 }
 
 /////////////////////////////////////////////////////////////////////
-void Write(IOutputStream& outStream, const uint32_t value)
+void Write(XdrWriter& outStream, const uint32_t value)
 {
 	outStream.Write(value);
 }
 
 /////////////////////////////////////////////////////////////////////
-void Write(IOutputStream& outStream, const uint64_t value)
+void Write(XdrWriter& outStream, const uint64_t value)
 {
 	outStream.Write8(value);
 }
 
 /////////////////////////////////////////////////////////////////////
-void Write(IOutputStream& outStream, const SpecData3& value)
+template <typename T>
+void WriteFixed(XdrWriter& outStream, const T& value)
 {
-	Write(outStream, value.specdata1);
-	Write(outStream, value.specdata2);
+	XdrEncode(outStream.Reserve(XdrSize<T>), value);  // a single bounds check for the whole structure
 }
 
 /////////////////////////////////////////////////////////////////////
-void Write(IOutputStream& outStream, const NFSTime3& value)
+void Write(XdrWriter& outStream, const SpecData3& value)
 {
-	Write(outStream, value.seconds);
-	Write(outStream, value.nseconds);
+	WriteFixed(outStream, value);
 }
 
 /////////////////////////////////////////////////////////////////////
-void Write(IOutputStream& outStream, const FAttr3& value)
+void Write(XdrWriter& outStream, const NFSTime3& value)
 {
-	Write(outStream, value.type);
-	Write(outStream, value.mode);
-	Write(outStream, value.nlink);
-	Write(outStream, value.uid);
-	Write(outStream, value.gid);
-	Write(outStream, value.size);
-	Write(outStream, value.used);
-	Write(outStream, value.rdev);
-	Write(outStream, value.fsid);
-	Write(outStream, value.fileid);
-	Write(outStream, value.atime);
-	Write(outStream, value.mtime);
-	Write(outStream, value.ctime);
+	WriteFixed(outStream, value);
 }
 
 /////////////////////////////////////////////////////////////////////
-void Write(IOutputStream& outStream, const Opaque& value)
+void Write(XdrWriter& outStream, const FAttr3& value)
+{
+	WriteFixed(outStream, value);
+}
+
+/////////////////////////////////////////////////////////////////////
+void Write(XdrWriter& outStream, const Opaque& value)
 {
 	Write(outStream, value.length);
 	outStream.Write(value.contents, value.length);
@@ -646,42 +740,50 @@ void Write(IOutputStream& outStream, const Opaque& value)
 }
 
 /////////////////////////////////////////////////////////////////////
-void Write(IOutputStream& outStream, const WccAttr& value)
+void Write(XdrWriter& outStream, const WccAttr& value)
 {
-	Write(outStream, value.size);
-	Write(outStream, value.mtime);
-	Write(outStream, value.ctime);
+	WriteFixed(outStream, value);
 }
 
 /////////////////////////////////////////////////////////////////////
-void Write(IOutputStream& outStream, const PreOpAttr& value)
+unsigned char* XdrEncode(unsigned char* data, const PreOpAttr& value) noexcept
 {
-	Write(outStream, value.attributesFollow);
-	if (value.attributesFollow)
-	{
-		Write(outStream, value.attributes);
-	}
+	data = XdrEncode(data, value.attributesFollow);
+	return value.attributesFollow ? XdrEncode(data, value.attributes) : data;
 }
 
 /////////////////////////////////////////////////////////////////////
-void Write(IOutputStream& outStream, const PostOpAttr& value)
+unsigned char* XdrEncode(unsigned char* data, const PostOpAttr& value) noexcept
 {
-	Write(outStream, value.attributesFollow);
-	if (value.attributesFollow)
-	{
-		Write(outStream, value.attributes);
-	}
+	data = XdrEncode(data, value.attributesFollow);
+	return value.attributesFollow ? XdrEncode(data, value.attributes) : data;
+}
+
+/////////////////////////////////////////////////////////////////////
+void Write(XdrWriter& outStream, const PreOpAttr& value)
+{
+	unsigned char buffer[XdrSize<bool> + XdrSize<WccAttr>];
+	outStream.Write(buffer, static_cast<size_t>(XdrEncode(buffer, value) - buffer));
+}
+
+/////////////////////////////////////////////////////////////////////
+void Write(XdrWriter& outStream, const PostOpAttr& value)
+{
+	unsigned char buffer[XdrSize<bool> + XdrSize<FAttr3>];
+	outStream.Write(buffer, static_cast<size_t>(XdrEncode(buffer, value) - buffer));
 }
 
 /////////////////////////////////////////////////////////////////////
-void Write(IOutputStream& outStream, const WccData& value)
+void Write(XdrWriter& outStream, const WccData& value)
 {
-	Write(outStream, value.before);
-	Write(outStream, value.after);
+	unsigned char buffer[XdrSize<bool> + XdrSize<WccAttr> + XdrSize<bool> + XdrSize<FAttr3>];
+	unsigned char* end = XdrEncode(buffer, value.before);
+	end = XdrEncode(end, value.after);
+	outStream.Write(buffer, static_cast<size_t>(end - buffer));
 }
 
 /////////////////////////////////////////////////////////////////////
-void Write(IOutputStream& outStream, const PostOpFH3& value)
+void Write(XdrWriter& outStream, const PostOpFH3& value)
 {
 	Write(outStream, value.handleFollows);
 	if (value.handleFollows)
@@ -758,6 +860,15 @@ inline const char* NfsStatToString(NfsStat3 stat)
 	}
 }
 
+/////////////////////////////////////////////////////////////////////
+// The paths of a procedure are taken from the arena of the request, as
+// its handles and names, the heap is used outside of a request only
+static std::pmr::memory_resource* GetPathResource() noexcept
+{
+	RequestArena* arena = RequestArena::GetCurrent();
+	return arena != nullptr ? static_cast<std::pmr::memory_resource*>(arena) : std::pmr::get_default_resource();
+}
+
 /////////////////////////////////////////////////////////////////////
 NFS3Prog::NFS3Prog(std::shared_ptr<FileTable> fileTable, unsigned int uid, unsigned int gid)
 	: RPCProg()
@@ -767,9 +878,9 @@ NFS3Prog::NFS3Prog(std::shared_ptr<FileTable> fileTable, unsigned int uid, unsig
 {}
 
 /////////////////////////////////////////////////////////////////////
-int NFS3Prog::Process(IInputStream& inStream, IOutputStream& outStream, RPCParam& param)
+int NFS3Prog::Process(XdrReader& inStream, XdrWriter& outStream, RPCParam& param)
 {
-	typedef NfsStat3(NFS3Prog::* PPROC)(IInputStream&, IOutputStream&, RPCParam&);
+	typedef NfsStat3(NFS3Prog::* PPROC)(XdrReader&, XdrWriter&, RPCParam&);
 	static PPROC pf[] = {
 		&NFS3Prog::ProcedureNULL, &NFS3Prog::ProcedureGETATTR, &NFS3Prog::ProcedureSETATTR,
 		&NFS3Prog::ProcedureLOOKUP, &NFS3Prog::ProcedureACCESS, &NFS3Prog::ProcedureREADLINK,
@@ -803,17 +914,44 @@ int NFS3Prog::Process(IInputStream& inStream, IOutputStream& outStream, RPCParam
 }
 
 /////////////////////////////////////////////////////////////////////
-NfsStat3 NFS3Prog::ProcedureNULL(IInputStream&, IOutputStream&, RPCParam&)
+bool NFS3Prog::IsIdempotent(const RPCParam& param) const
+{
+	switch (param.procNum)
+	{
+	case NFSPROC3_SETATTR:
+	case NFSPROC3_WRITE:
+	case NFSPROC3_CREATE:
+	case NFSPROC3_MKDIR:
+	case NFSPROC3_SYMLINK:
+	case NFSPROC3_MKNOD:
+	case NFSPROC3_REMOVE:
+	case NFSPROC3_RMDIR:
+	case NFSPROC3_RENAME:
+	case NFSPROC3_LINK:
+		return false;
+	default:
+		return true;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+void NFS3Prog::EnableZeroCopyRead(const std::string& path)
+{
+	m_zeroCopyPaths.push_back(path);
+}
+
+/////////////////////////////////////////////////////////////////////
+NfsStat3 NFS3Prog::ProcedureNULL(XdrReader&, XdrWriter&, RPCParam&)
 {
 	return NFS3_OK;
 }
 
 /////////////////////////////////////////////////////////////////////
-NfsStat3 NFS3Prog::ProcedureGETATTR(IInputStream& inStream, IOutputStream& outStream, RPCParam& param)
+NfsStat3 NFS3Prog::ProcedureGETATTR(XdrReader& inStream, XdrWriter& outStream, RPCParam& param)
 {
 	FAttr3 attributes{};
 	NfsStat3 stat = NFS3_OK;
-	std::string path{};
+	std::pmr::string path(GetPathResource());
 
 	try
 	{
@@ -848,7 +986,7 @@ NfsStat3 NFS3Prog::ProcedureGETATTR(IInputStream& inStream, IOutputStream& outSt
 }
 
 /////////////////////////////////////////////////////////////////////
-NfsStat3 NFS3Prog::ProcedureSETATTR(IInputStream& inStream, IOutputStream& outStream, RPCParam& param)
+NfsStat3 NFS3Prog::ProcedureSETATTR(XdrReader& inStream, XdrWriter& outStream, RPCParam& param)
 {
 	SAttr3 newAttributes;
 	SAttrGuard3 guard;
@@ -860,7 +998,7 @@ NfsStat3 NFS3Prog::ProcedureSETATTR(IInputStream& inStream, IOutputStream& outSt
 	FILETIME fileTime;
 	SYSTEMTIME systemTime;
 
-	const std::string path = GetPath(inStream);
+	const std::pmr::string path = GetPath(inStream);
 	Read(inStream, newAttributes);
 	Read(inStream, guard);
 	stat = CheckFile(path);
@@ -903,7 +1041,7 @@ NfsStat3 NFS3Prog::ProcedureSETATTR(IInputStream& inStream, IOutputStream& outSt
 
 		if (newAttributes.mtime.setIt == SET_TO_SERVER_TIME || newAttributes.atime.setIt == SET_TO_SERVER_TIME)
 		{
-			fileHandle = CreateFile(path.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_WRITE, 0, OPEN_EXISTING, 0, 0);
+			fileHandle = CreateFile(path.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, 0, OPEN_EXISTING, 0, 0);
 			if (fileHandle != INVALID_HANDLE_VALUE)
 			{
 				GetSystemTime(&systemTime);
@@ -922,7 +1060,7 @@ NfsStat3 NFS3Prog::ProcedureSETATTR(IInputStream& inStream, IOutputStream& outSt
 
 		if (newAttributes.size.setIt)
 		{
-			file = _fsopen(path.c_str(), "r+b", _SH_DENYWR);
+			file = _fsopen(path.c_str(), "r+b", _SH_DENYNO);
 			if (file != nullptr)
 			{
 				int filedes = _fileno(file);
@@ -942,18 +1080,18 @@ NfsStat3 NFS3Prog::ProcedureSETATTR(IInputStream& inStream, IOutputStream& outSt
 }
 
 /////////////////////////////////////////////////////////////////////
-NfsStat3 NFS3Prog::ProcedureLOOKUP(IInputStream& inStream, IOutputStream& outStream, RPCParam& param)
+NfsStat3 NFS3Prog::ProcedureLOOKUP(XdrReader& inStream, XdrWriter& outStream, RPCParam& param)
 {
 	NFSv3FileHandle object;
 	PostOpAttr fileAttributes;
 	PostOpAttr dirAttributes;
 	NfsStat3 stat;
 
-	std::string dirName;
-	std::string fileName;
+	std::pmr::string dirName(GetPathResource());
+	std::pmr::string fileName(GetPathResource());
 	ReadDirectory(inStream, dirName, fileName);
 
-	std::string path = GetFullPath(dirName, fileName);
+	std::pmr::string path = GetFullPath(dirName, fileName);
 	stat = CheckFile(dirName, path);
 	if (stat == NFS3_OK)
 	{
@@ -961,7 +1099,7 @@ NfsStat3 NFS3Prog::ProcedureLOOKUP(IInputStream& inStream, IOutputStream& outStr
 		fileAttributes.attributesFollow = GetFileAttributesForNFS(path, &fileAttributes.attributes);
 	}
 
-	dirAttributes.attributesFollow = GetFileAttributesForNFS((char*)dirName.c_str(), &dirAttributes.attributes);
+	dirAttributes.attributesFollow = GetFileAttributesForNFS(dirName, &dirAttributes.attributes);
 
 	Write(outStream, stat);
 
@@ -977,13 +1115,13 @@ NfsStat3 NFS3Prog::ProcedureLOOKUP(IInputStream& inStream, IOutputStream& outStr
 }
 
 /////////////////////////////////////////////////////////////////////
-NfsStat3 NFS3Prog::ProcedureACCESS(IInputStream& inStream, IOutputStream& outStream, RPCParam& param)
+NfsStat3 NFS3Prog::ProcedureACCESS(XdrReader& inStream, XdrWriter& outStream, RPCParam& param)
 {
 	uint32_t access;
 	PostOpAttr objAttributes;
 	NfsStat3 stat;
 
-	const std::string path = GetPath(inStream);
+	const std::pmr::string path = GetPath(inStream);
 	Read(inStream, access);
 	stat = CheckFile(path);
 
@@ -1007,7 +1145,7 @@ NfsStat3 NFS3Prog::ProcedureACCESS(IInputStream& inStream, IOutputStream& outStr
 }
 
 /////////////////////////////////////////////////////////////////////
-NfsStat3 NFS3Prog::ProcedureREADLINK(IInputStream& inStream, IOutputStream& outStream, RPCParam& param)
+NfsStat3 NFS3Prog::ProcedureREADLINK(XdrReader& inStream, XdrWriter& outStream, RPCParam& param)
 {
 	PostOpAttr symlinkAttributes;
 	NFSv3Path data = NFSv3Path();
@@ -1020,7 +1158,7 @@ NfsStat3 NFS3Prog::ProcedureREADLINK(IInputStream& inStream, IOutputStream& outS
 	lpOutBuffer = (REPARSE_DATA_BUFFER*)malloc(MAXIMUM_REPARSE_DATA_BUFFER_SIZE);
 	DWORD bytesReturned;
 
-	std::string path = GetPath(inStream);
+	std::pmr::string path = GetPath(inStream);
 	stat = CheckFile(path);
 	if (stat == NFS3_OK) {
 		hFile = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_REPARSE_POINT | FILE_FLAG_OPEN_REPARSE_POINT | FILE_FLAG_BACKUP_SEMANTICS, NULL);
@@ -1118,30 +1256,57 @@ NfsStat3 NFS3Prog::ProcedureREADLINK(IInputStream& inStream, IOutputStream& outS
 }
 
 /////////////////////////////////////////////////////////////////////
-NfsStat3 NFS3Prog::ProcedureREAD(IInputStream& inStream, IOutputStream& outStream, RPCParam& param)
+NfsStat3 NFS3Prog::ProcedureREAD(XdrReader& inStream, XdrWriter& outStream, RPCParam& param)
 {
 	Offset3 offset = 0;
 	Count3 count = 0;
 	PostOpAttr fileAttributes{};
 	bool eof = false;
-	Opaque data{};
+	unsigned char* data = nullptr;
 	NfsStat3 stat{};
 	FILE* pFile = nullptr;
+	HANDLE fileHandle = INVALID_HANDLE_VALUE;
+	LARGE_INTEGER fileSize{};
 
-	const std::string path = GetPath(inStream);
+	const std::pmr::string path = GetPath(inStream);
 	Read(inStream, offset);
 	Read(inStream, count);
+	count = std::min(count, NFS3_RTMAX);  // a short read is allowed, the buffer must stay bounded
 	stat = CheckFile(path);
 
-	if (stat == NFS3_OK)
+	if (stat == NFS3_OK && outStream.CanAttachFile() && IsZeroCopyRead(path))
+	{
+		// the transport sends the file range by itself, only find out its size; it keeps
+		// the handle until the range is sent, a paused reader may take long, so do not
+		// keep the others from writing, truncating, removing or renaming the file meanwhile
+		fileHandle = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+		if (fileHandle != INVALID_HANDLE_VALUE && GetFileSizeEx(fileHandle, &fileSize))
+		{
+			const uint64_t size = static_cast<uint64_t>(fileSize.QuadPart);
+			count = static_cast<Count3>(offset < size ? std::min<uint64_t>(count, size - offset) : 0);
+			eof = offset + count >= size;
+		}
+		else
+		{
+			stat = GetLastError() == ERROR_ACCESS_DENIED ? NFS3ERR_ACCES : NFS3ERR_IO;
+			if (fileHandle != INVALID_HANDLE_VALUE)
+			{
+				CloseHandle(fileHandle);
+				fileHandle = INVALID_HANDLE_VALUE;
+			}
+		}
+	}
+	else if (stat == NFS3_OK)
 	{
-		data.SetSize(count);
-		pFile = _fsopen(path.c_str(), "rb", _SH_DENYWR);
+		pFile = _fsopen(path.c_str(), "rb", _SH_DENYNO);
 
 		if (pFile != NULL)
 		{
+			// read the file contents straight into the buffer to be sent
+			data = outStream.AcquireSegment(count);
 			_fseeki64(pFile, offset, SEEK_SET);
-			count = static_cast<Count3>(fread(data.contents, sizeof(char), count, pFile));
+			count = static_cast<Count3>(fread(data, sizeof(char), count, pFile));
 			eof = fgetc(pFile) == EOF;
 			fclose(pFile);
 		}
@@ -1171,7 +1336,22 @@ NfsStat3 NFS3Prog::ProcedureREAD(IInputStream& inStream, IOutputStream& outStrea
 	{
 		Write(outStream, count);
 		Write(outStream, eof);
-		Write(outStream, data);
+		Write(outStream, count);  // opaque data length
+		if (fileHandle != INVALID_HANDLE_VALUE)
+		{
+			outStream.AttachFile(fileHandle, offset, count);
+		}
+		else
+		{
+			outStream.CommitSegment(count);
+		}
+
+		const uint32_t len = count & 3;
+		if (len != 0)
+		{
+			uint32_t byte = 0;
+			outStream.Write(&byte, 4 - (size_t)len);
+		}
 	}
 
 	BOOST_LOG_TRIVIAL(debug) << "NFS3 " << param.remoteAddr << " READ '" << path << "': " << NfsStatToString(stat);
@@ -1179,22 +1359,22 @@ NfsStat3 NFS3Prog::ProcedureREAD(IInputStream& inStream, IOutputStream& outStrea
 }
 
 /////////////////////////////////////////////////////////////////////
-NfsStat3 NFS3Prog::ProcedureWRITE(IInputStream& inStream, IOutputStream& outStream, RPCParam& param)
+NfsStat3 NFS3Prog::ProcedureWRITE(XdrReader& inStream, XdrWriter& outStream, RPCParam& param)
 {
 	Offset3 offset = 0;
 	Count3 count = 0;
 	StableHow stable{};
-	Opaque data{};
+	OpaqueView data{};
 	WccData fileWcc{};
 	WriteVerf3 verf{};
 	NfsStat3 stat{};
 	FILE* pFile = nullptr;
 
-	const std::string path = GetPath(inStream);
+	const std::pmr::string path = GetPath(inStream);
 	Read(inStream, offset);
 	Read(inStream, count);
 	Read(inStream, stable);
-	Read(inStream, data);
+	Read(inStream, data, NFS3_WTMAX);
 	stat = CheckFile(path);
 
 	fileWcc.before.attributesFollow = GetFileAttributesForNFS(path, &fileWcc.before.attributes);
@@ -1207,18 +1387,35 @@ NfsStat3 NFS3Prog::ProcedureWRITE(IInputStream& inStream, IOutputStream& outStre
 			GetFileHandle(path, &handle);
 			int handleId = *(unsigned int*)handle.contents;
 
-			if (unstableStorageFile.count(handleId) == 0)
+			// The writes to the other files go on meanwhile. COMMIT may close the
+			// file, so hold its lock until the data is written.
+			std::shared_ptr<UnstableFile> unstable;
+			std::unique_lock<std::mutex> fileLock;
+			do
 			{
-				pFile = _fsopen(path.c_str(), "r+b", _SH_DENYWR);
-				if (pFile != NULL)
 				{
-					unstableStorageFile.insert(std::make_pair(handleId, pFile));
+					std::scoped_lock<std::mutex> lock(m_unstableStorageLock);
+					auto& entry = unstableStorageFile[handleId];
+					if (entry == nullptr)
+					{
+						entry = std::make_shared<UnstableFile>();
+					}
+					unstable = entry;
 				}
-			}
-			else
+				fileLock = std::unique_lock<std::mutex>(unstable->lock);
+			} while (unstable->committed);  // the next write after COMMIT opens the file again
+
+			if (unstable->file == nullptr)
 			{
-				pFile = unstableStorageFile[handleId];
+				unstable->file = _fsopen(path.c_str(), "r+b", _SH_DENYNO);
+				if (unstable->file != NULL)
+				{
+					// READ and the stable WRITE open the file by themselves, so the data must
+					// not wait in the buffer of this handle until COMMIT
+					setvbuf(unstable->file, nullptr, _IONBF, 0);
+				}
 			}
+			pFile = unstable->file;
 
 			if (pFile != NULL)
 			{
@@ -1247,7 +1444,7 @@ NfsStat3 NFS3Prog::ProcedureWRITE(IInputStream& inStream, IOutputStream& outStre
 		}
 		else
 		{
-			pFile = _fsopen(path.c_str(), "r+b", _SH_DENYWR);
+			pFile = _fsopen(path.c_str(), "r+b", _SH_DENYNO);
 
 			if (pFile != NULL)
 			{
@@ -1293,7 +1490,7 @@ NfsStat3 NFS3Prog::ProcedureWRITE(IInputStream& inStream, IOutputStream& outStre
 }
 
 /////////////////////////////////////////////////////////////////////
-NfsStat3 NFS3Prog::ProcedureCREATE(IInputStream& inStream, IOutputStream& outStream, RPCParam& param)
+NfsStat3 NFS3Prog::ProcedureCREATE(XdrReader& inStream, XdrWriter& outStream, RPCParam& param)
 {
 	CreateHow3 how;
 	PostOpFH3 obj;
@@ -1302,15 +1499,15 @@ NfsStat3 NFS3Prog::ProcedureCREATE(IInputStream& inStream, IOutputStream& outStr
 	NfsStat3 stat;
 	FILE* pFile;
 
-	std::string dirName;
-	std::string fileName;
+	std::pmr::string dirName(GetPathResource());
+	std::pmr::string fileName(GetPathResource());
 	ReadDirectory(inStream, dirName, fileName);
-	std::string path = GetFullPath(dirName, fileName);
+	std::pmr::string path = GetFullPath(dirName, fileName);
 	Read(inStream, how);
 
 	dir_wcc.before.attributesFollow = GetFileAttributesForNFS(dirName, &dir_wcc.before.attributes);
 
-	pFile = _fsopen(path.c_str(), "wb", _SH_DENYWR);
+	pFile = _fsopen(path.c_str(), "wb", _SH_DENYNO);
 
 	if (pFile != nullptr)
 	{
@@ -1343,7 +1540,7 @@ NfsStat3 NFS3Prog::ProcedureCREATE(IInputStream& inStream, IOutputStream& outStr
 		objAttributes.attributesFollow = GetFileAttributesForNFS(path, &objAttributes.attributes);
 	}
 
-	dir_wcc.after.attributesFollow = GetFileAttributesForNFS((char*)dirName.c_str(), &dir_wcc.after.attributes);
+	dir_wcc.after.attributesFollow = GetFileAttributesForNFS(dirName, &dir_wcc.after.attributes);
 
 	Write(outStream, stat);
 
@@ -1359,7 +1556,7 @@ NfsStat3 NFS3Prog::ProcedureCREATE(IInputStream& inStream, IOutputStream& outStr
 }
 
 /////////////////////////////////////////////////////////////////////
-NfsStat3 NFS3Prog::ProcedureMKDIR(IInputStream& inStream, IOutputStream& outStream, RPCParam& param)
+NfsStat3 NFS3Prog::ProcedureMKDIR(XdrReader& inStream, XdrWriter& outStream, RPCParam& param)
 {
 	SAttr3 attributes;
 	PostOpFH3 obj;
@@ -1367,13 +1564,13 @@ NfsStat3 NFS3Prog::ProcedureMKDIR(IInputStream& inStream, IOutputStream& outStre
 	WccData dir_wcc;
 	NfsStat3 stat;
 
-	std::string dirName;
-	std::string fileName;
+	std::pmr::string dirName(GetPathResource());
+	std::pmr::string fileName(GetPathResource());
 	ReadDirectory(inStream, dirName, fileName);
-	std::string path = GetFullPath(dirName, fileName);
+	std::pmr::string path = GetFullPath(dirName, fileName);
 	Read(inStream, attributes);
 
-	dir_wcc.before.attributesFollow = GetFileAttributesForNFS((char*)dirName.c_str(), &dir_wcc.before.attributes);
+	dir_wcc.before.attributesFollow = GetFileAttributesForNFS(dirName, &dir_wcc.before.attributes);
 
 	const int result = _mkdir(path.c_str());
 	if (result == 0)
@@ -1400,7 +1597,7 @@ NfsStat3 NFS3Prog::ProcedureMKDIR(IInputStream& inStream, IOutputStream& outStre
 		}
 	}
 
-	dir_wcc.after.attributesFollow = GetFileAttributesForNFS((char*)dirName.c_str(), &dir_wcc.after.attributes);
+	dir_wcc.after.attributesFollow = GetFileAttributesForNFS(dirName, &dir_wcc.after.attributes);
 
 	Write(outStream, stat);
 
@@ -1416,7 +1613,7 @@ NfsStat3 NFS3Prog::ProcedureMKDIR(IInputStream& inStream, IOutputStream& outStre
 }
 
 /////////////////////////////////////////////////////////////////////
-NfsStat3 NFS3Prog::ProcedureSYMLINK(IInputStream& inStream, IOutputStream& outStream, RPCParam& param)
+NfsStat3 NFS3Prog::ProcedureSYMLINK(XdrReader& inStream, XdrWriter& outStream, RPCParam& param)
 {
 	PostOpFH3 obj;
 	PostOpAttr objAttributes;
@@ -1429,10 +1626,10 @@ NfsStat3 NFS3Prog::ProcedureSYMLINK(IInputStream& inStream, IOutputStream& outSt
 	DWORD targetFileAttr;
 	DWORD dwFlags;
 
-	std::string dirName;
-	std::string fileName;
+	std::pmr::string dirName(GetPathResource());
+	std::pmr::string fileName(GetPathResource());
 	ReadDirectory(inStream, dirName, fileName);
-	std::string path = GetFullPath(dirName, fileName);
+	std::pmr::string path = GetFullPath(dirName, fileName);
 
 	Read(inStream, symlink);
 
@@ -1447,7 +1644,7 @@ NfsStat3 NFS3Prog::ProcedureSYMLINK(IInputStream& inStream, IOutputStream& outSt
 	std::replace(strFromChar.begin(), strFromChar.end(), '/', '\\');
 	_In_ LPTSTR lpTargetFileName = const_cast<LPSTR>(strFromChar.c_str());
 
-	std::string fullTargetPath = dirName + std::string("\\") + std::string(lpTargetFileName);
+	std::pmr::string fullTargetPath = dirName + "\\" + lpTargetFileName;
 
 	// Relative path do not work with GetFileAttributes (directory are not recognized)
 	// so we normalize the path before calling GetFileAttributes
@@ -1480,7 +1677,7 @@ NfsStat3 NFS3Prog::ProcedureSYMLINK(IInputStream& inStream, IOutputStream& outSt
 		}
 	}
 
-	dir_wcc.after.attributesFollow = GetFileAttributesForNFS((char*)dirName.c_str(), &dir_wcc.after.attributes);
+	dir_wcc.after.attributesFollow = GetFileAttributesForNFS(dirName, &dir_wcc.after.attributes);
 
 	Write(outStream, stat);
 
@@ -1496,7 +1693,7 @@ NfsStat3 NFS3Prog::ProcedureSYMLINK(IInputStream& inStream, IOutputStream& outSt
 }
 
 /////////////////////////////////////////////////////////////////////
-NfsStat3 NFS3Prog::ProcedureMKNOD(IInputStream&, IOutputStream&, RPCParam& param)
+NfsStat3 NFS3Prog::ProcedureMKNOD(XdrReader&, XdrWriter&, RPCParam& param)
 {
 	//TODO
 	BOOST_LOG_TRIVIAL(debug) << "NFS3 " << param.remoteAddr << " MKNOD not implemented";
@@ -1505,16 +1702,16 @@ NfsStat3 NFS3Prog::ProcedureMKNOD(IInputStream&, IOutputStream&, RPCParam& param
 }
 
 /////////////////////////////////////////////////////////////////////
-NfsStat3 NFS3Prog::ProcedureREMOVE(IInputStream& inStream, IOutputStream& outStream, RPCParam& param)
+NfsStat3 NFS3Prog::ProcedureREMOVE(XdrReader& inStream, XdrWriter& outStream, RPCParam& param)
 {
 	WccData dirWcc{};
 	NfsStat3 stat;
 	unsigned long returnCode;
 
-	std::string dirName;
-	std::string fileName;
+	std::pmr::string dirName(GetPathResource());
+	std::pmr::string fileName(GetPathResource());
 	ReadDirectory(inStream, dirName, fileName);
-	std::string path = GetFullPath(dirName, fileName);
+	std::pmr::string path = GetFullPath(dirName, fileName);
 	stat = CheckFile(dirName, path);
 
 	dirWcc.before.attributesFollow = GetFileAttributesForNFS(dirName, &dirWcc.before.attributes);
@@ -1524,7 +1721,7 @@ NfsStat3 NFS3Prog::ProcedureREMOVE(IInputStream& inStream, IOutputStream& outStr
 		DWORD fileAttr = GetFileAttributes(path.c_str());
 		if ((fileAttr & FILE_ATTRIBUTE_DIRECTORY) && (fileAttr & FILE_ATTRIBUTE_REPARSE_POINT))
 		{
-			returnCode = m_fileTable->RemoveFolder(path);
+			returnCode = m_fileTable->RemoveFolder(std::string(path));
 			if (returnCode != 0)
 			{
 				if (returnCode == ERROR_DIR_NOT_EMPTY)
@@ -1539,14 +1736,14 @@ NfsStat3 NFS3Prog::ProcedureREMOVE(IInputStream& inStream, IOutputStream& outStr
 		}
 		else
 		{
-			if (!m_fileTable->RemoveFile(path))
+			if (!m_fileTable->RemoveFile(std::string(path)))
 			{
 				stat = NFS3ERR_IO;
 			}
 		}
 	}
 
-	dirWcc.after.attributesFollow = GetFileAttributesForNFS((char*)dirName.c_str(), &dirWcc.after.attributes);
+	dirWcc.after.attributesFollow = GetFileAttributesForNFS(dirName, &dirWcc.after.attributes);
 
 	Write(outStream, stat);
 	Write(outStream, dirWcc);
@@ -1556,23 +1753,23 @@ NfsStat3 NFS3Prog::ProcedureREMOVE(IInputStream& inStream, IOutputStream& outStr
 }
 
 /////////////////////////////////////////////////////////////////////
-NfsStat3 NFS3Prog::ProcedureRMDIR(IInputStream& inStream, IOutputStream& outStream, RPCParam& param)
+NfsStat3 NFS3Prog::ProcedureRMDIR(XdrReader& inStream, XdrWriter& outStream, RPCParam& param)
 {
 	WccData dir_wcc;
 	NfsStat3 stat;
 	unsigned long returnCode;
 
-	std::string dirName;
-	std::string fileName;
+	std::pmr::string dirName(GetPathResource());
+	std::pmr::string fileName(GetPathResource());
 	ReadDirectory(inStream, dirName, fileName);
-	std::string path = GetFullPath(dirName, fileName);
+	std::pmr::string path = GetFullPath(dirName, fileName);
 	stat = CheckFile(dirName, path);
 
 	dir_wcc.before.attributesFollow = GetFileAttributesForNFS(dirName, &dir_wcc.before.attributes);
 
 	if (stat == NFS3_OK)
 	{
-		returnCode = m_fileTable->RemoveFolder(path);
+		returnCode = m_fileTable->RemoveFolder(std::string(path));
 		if (returnCode != 0)
 		{
 			if (returnCode == ERROR_DIR_NOT_EMPTY)
@@ -1596,33 +1793,33 @@ NfsStat3 NFS3Prog::ProcedureRMDIR(IInputStream& inStream, IOutputStream& outStre
 }
 
 /////////////////////////////////////////////////////////////////////
-NfsStat3 NFS3Prog::ProcedureRENAME(IInputStream& inStream, IOutputStream& outStream, RPCParam& param)
+NfsStat3 NFS3Prog::ProcedureRENAME(XdrReader& inStream, XdrWriter& outStream, RPCParam& param)
 {
 	WccData fromdir_wcc, todir_wcc;
 	NfsStat3 stat;
 	unsigned long returnCode;
 
-	std::string dirFromName;
-	std::string fileFromName;
+	std::pmr::string dirFromName(GetPathResource());
+	std::pmr::string fileFromName(GetPathResource());
 	ReadDirectory(inStream, dirFromName, fileFromName);
-	std::string pathFrom = GetFullPath(dirFromName, fileFromName);
+	std::pmr::string pathFrom = GetFullPath(dirFromName, fileFromName);
 
-	std::string dirToName;
-	std::string fileToName;
+	std::pmr::string dirToName(GetPathResource());
+	std::pmr::string fileToName(GetPathResource());
 	ReadDirectory(inStream, dirToName, fileToName);
-	std::string pathTo = GetFullPath(dirToName, fileToName);
+	std::pmr::string pathTo = GetFullPath(dirToName, fileToName);
 
 	stat = CheckFile(dirFromName, pathFrom);
 
 	fromdir_wcc.before.attributesFollow = GetFileAttributesForNFS(dirFromName, &fromdir_wcc.before.attributes);
 	todir_wcc.before.attributesFollow = GetFileAttributesForNFS(dirToName, &todir_wcc.before.attributes);
 
-	if (m_fileTable->FileExists(pathTo))
+	if (m_fileTable->FileExists(pathTo.c_str()))
 	{
 		DWORD fileAttr = GetFileAttributes(pathTo.c_str());
 		if ((fileAttr & FILE_ATTRIBUTE_DIRECTORY) && (fileAttr & FILE_ATTRIBUTE_REPARSE_POINT))
 		{
-			returnCode = m_fileTable->RemoveFolder(pathTo);
+			returnCode = m_fileTable->RemoveFolder(std::string(pathTo));
 			if (returnCode != 0)
 			{
 				if (returnCode == ERROR_DIR_NOT_EMPTY)
@@ -1637,7 +1834,7 @@ NfsStat3 NFS3Prog::ProcedureRENAME(IInputStream& inStream, IOutputStream& outStr
 		}
 		else
 		{
-			if (!m_fileTable->RemoveFile(pathTo))
+			if (!m_fileTable->RemoveFile(std::string(pathTo)))
 			{
 				stat = NFS3ERR_IO;
 			}
@@ -1646,7 +1843,7 @@ NfsStat3 NFS3Prog::ProcedureRENAME(IInputStream& inStream, IOutputStream& outStr
 
 	if (stat == NFS3_OK)
 	{
-		errno_t errorNumber = m_fileTable->RenameDirectory(pathFrom, pathTo);
+		errno_t errorNumber = m_fileTable->RenameDirectory(std::string(pathFrom), std::string(pathTo));
 
 		if (errorNumber != 0)
 		{
@@ -1677,19 +1874,19 @@ NfsStat3 NFS3Prog::ProcedureRENAME(IInputStream& inStream, IOutputStream& outStr
 }
 
 /////////////////////////////////////////////////////////////////////
-NfsStat3 NFS3Prog::ProcedureLINK(IInputStream& inStream, IOutputStream& outStream, RPCParam& param)
+NfsStat3 NFS3Prog::ProcedureLINK(XdrReader& inStream, XdrWriter& outStream, RPCParam& param)
 {
 	DirOpArgs3 link;
-	std::string dirName;
-	std::string fileName;
+	std::pmr::string dirName(GetPathResource());
+	std::pmr::string fileName(GetPathResource());
 	NfsStat3 stat;
 	PostOpAttr objAttributes;
 	WccData dirWcc;
 
-	std::string path = GetPath(inStream);
+	std::pmr::string path = GetPath(inStream);
 	ReadDirectory(inStream, dirName, fileName);
 
-	std::string linkFullPath = GetFullPath(dirName, fileName);
+	std::pmr::string linkFullPath = GetFullPath(dirName, fileName);
 
 	if (CreateHardLink(linkFullPath.c_str(), path.c_str(), NULL) == 0)
 	{
@@ -1717,7 +1914,7 @@ NfsStat3 NFS3Prog::ProcedureLINK(IInputStream& inStream, IOutputStream& outStrea
 }
 
 /////////////////////////////////////////////////////////////////////
-NfsStat3 NFS3Prog::ProcedureREADDIR(IInputStream& inStream, IOutputStream& outStream, RPCParam& param)
+NfsStat3 NFS3Prog::ProcedureREADDIR(XdrReader& inStream, XdrWriter& outStream, RPCParam& param)
 {
 	Cookie3 cookie;
 	CookieVerf3 cookieverf;
@@ -1734,7 +1931,7 @@ NfsStat3 NFS3Prog::ProcedureREADDIR(IInputStream& inStream, IOutputStream& outSt
 	struct _finddata_t fileinfo;
 	unsigned int i, j;
 
-	std::string path = GetPath(inStream);
+	std::pmr::string path = GetPath(inStream);
 	Read(inStream, cookie);
 	Read(inStream, cookieverf);
 	Read(inStream, count);
@@ -1807,7 +2004,7 @@ NfsStat3 NFS3Prog::ProcedureREADDIR(IInputStream& inStream, IOutputStream& outSt
 }
 
 /////////////////////////////////////////////////////////////////////
-NfsStat3 NFS3Prog::ProcedureREADDIRPLUS(IInputStream& inStream, IOutputStream& outStream, RPCParam& param)
+NfsStat3 NFS3Prog::ProcedureREADDIRPLUS(XdrReader& inStream, XdrWriter& outStream, RPCParam& param)
 {
 	Cookie3 cookie;
 	CookieVerf3 cookieverf;
@@ -1826,7 +2023,7 @@ NfsStat3 NFS3Prog::ProcedureREADDIRPLUS(IInputStream& inStream, IOutputStream& o
 	unsigned int i, j;
 	bool bFollows;
 
-	std::string path = GetPath(inStream);
+	std::pmr::string path = GetPath(inStream);
 	Read(inStream, cookie);
 	Read(inStream, cookieverf);
 	Read(inStream, dircount);
@@ -1903,7 +2100,7 @@ NfsStat3 NFS3Prog::ProcedureREADDIRPLUS(IInputStream& inStream, IOutputStream& o
 }
 
 /////////////////////////////////////////////////////////////////////
-NfsStat3 NFS3Prog::ProcedureFSSTAT(IInputStream& inStream, IOutputStream& outStream, RPCParam& param)
+NfsStat3 NFS3Prog::ProcedureFSSTAT(XdrReader& inStream, XdrWriter& outStream, RPCParam& param)
 {
 	PostOpAttr objAttributes{};
 	Size3 tbytes = 0, fbytes = 0, abytes = 0, tfiles = 0, ffiles = 0, afiles = 0;
@@ -1911,7 +2108,7 @@ NfsStat3 NFS3Prog::ProcedureFSSTAT(IInputStream& inStream, IOutputStream& outStr
 
 	NfsStat3 stat;
 
-	std::string path = GetPath(inStream);
+	std::pmr::string path = GetPath(inStream);
 	stat = CheckFile(path);
 
 	if (stat == NFS3_OK)
@@ -1950,7 +2147,7 @@ NfsStat3 NFS3Prog::ProcedureFSSTAT(IInputStream& inStream, IOutputStream& outStr
 }
 
 /////////////////////////////////////////////////////////////////////
-NfsStat3 NFS3Prog::ProcedureFSINFO(IInputStream& inStream, IOutputStream& outStream, RPCParam& param)
+NfsStat3 NFS3Prog::ProcedureFSINFO(XdrReader& inStream, XdrWriter& outStream, RPCParam& param)
 {
 	PostOpAttr objAttributes{};
 	uint32_t rtmax = 0, rtpref = 0, rtmult = 0, wtmax = 0, wtpref = 0, wtmult = 0, dtpref = 0;
@@ -1959,7 +2156,7 @@ NfsStat3 NFS3Prog::ProcedureFSINFO(IInputStream& inStream, IOutputStream& outStr
 	uint32_t properties = 0;
 	NfsStat3 stat{};
 
-	std::string path = GetPath(inStream);
+	std::pmr::string path = GetPath(inStream);
 	stat = CheckFile(path);
 
 	if (stat == NFS3_OK)
@@ -1968,10 +2165,10 @@ NfsStat3 NFS3Prog::ProcedureFSINFO(IInputStream& inStream, IOutputStream& outStr
 
 		if (objAttributes.attributesFollow)
 		{
-			rtmax = 65536;
+			rtmax = NFS3_RTMAX;
 			rtpref = 32768;
 			rtmult = 4096;
-			wtmax = 65536;
+			wtmax = NFS3_WTMAX;
 			wtpref = 32768;
 			wtmult = 4096;
 			dtpref = 8192;
@@ -2008,14 +2205,14 @@ NfsStat3 NFS3Prog::ProcedureFSINFO(IInputStream& inStream, IOutputStream& outStr
 }
 
 /////////////////////////////////////////////////////////////////////
-NfsStat3 NFS3Prog::ProcedurePATHCONF(IInputStream& inStream, IOutputStream& outStream, RPCParam& param)
+NfsStat3 NFS3Prog::ProcedurePATHCONF(XdrReader& inStream, XdrWriter& outStream, RPCParam& param)
 {
 	PostOpAttr objAttributes{};
 	NfsStat3 stat{};
 	uint32_t linkMax = 0, nameMax = 0;
 	bool noTrunc = false, chownRestricted = false, caseInsensitive = false, casePreserving = false;
 
-	std::string path = GetPath(inStream);
+	std::pmr::string path = GetPath(inStream);
 	stat = CheckFile(path);
 
 	if (stat == NFS3_OK)
@@ -2055,9 +2252,9 @@ NfsStat3 NFS3Prog::ProcedurePATHCONF(IInputStream& inStream, IOutputStream& outS
 }
 
 /////////////////////////////////////////////////////////////////////
-NfsStat3 NFS3Prog::ProcedureCOMMIT(IInputStream& inStream, IOutputStream& outStream, RPCParam& param)
+NfsStat3 NFS3Prog::ProcedureCOMMIT(XdrReader& inStream, XdrWriter& outStream, RPCParam& param)
 {
-	std::string path;
+	std::pmr::string path(GetPathResource());
 	int handleId;
 	Offset3 offset;
 	Count3 count;
@@ -2080,22 +2277,28 @@ NfsStat3 NFS3Prog::ProcedureCOMMIT(IInputStream& inStream, IOutputStream& outStr
 
 	handleId = *(unsigned int*)file.contents;
 
-	if (unstableStorageFile.count(handleId) != 0)
+	std::shared_ptr<UnstableFile> unstable;
 	{
-		if (unstableStorageFile[handleId] != NULL)
-		{
-			fclose(unstableStorageFile[handleId]);
-			unstableStorageFile.erase(handleId);
-			stat = NFS3_OK;
-		}
-		else
+		std::scoped_lock<std::mutex> lock(m_unstableStorageLock);
+		const auto it = unstableStorageFile.find(handleId);
+		if (it != unstableStorageFile.end())
 		{
-			stat = NFS3ERR_IO;
+			unstable = std::move(it->second);
+			unstableStorageFile.erase(it);
 		}
 	}
-	else
+
+	stat = NFS3_OK;
+	if (unstable != nullptr)
 	{
-		stat = NFS3_OK;
+		// the writes in progress end first
+		std::scoped_lock<std::mutex> lock(unstable->lock);
+		unstable->committed = true;
+		if (unstable->file != NULL)
+		{
+			fclose(unstable->file);
+			unstable->file = nullptr;
+		}
 	}
 
 	fileWcc.after.attributesFollow = GetFileAttributesForNFS(path, &fileWcc.after.attributes);
@@ -2111,19 +2314,19 @@ NfsStat3 NFS3Prog::ProcedureCOMMIT(IInputStream& inStream, IOutputStream& outStr
 }
 
 /////////////////////////////////////////////////////////////////////
-NfsStat3 NFS3Prog::ProcedureNOIMP(IInputStream&, IOutputStream&, RPCParam& param)
+NfsStat3 NFS3Prog::ProcedureNOIMP(XdrReader&, XdrWriter&, RPCParam& param)
 {
 	BOOST_LOG_TRIVIAL(debug) << "NFS3 " << param.remoteAddr << " NOIMP";
 	return NFS3_OK;
 }
 
 /////////////////////////////////////////////////////////////////////
-std::string NFS3Prog::GetPath(IInputStream& inStream)
+std::pmr::string NFS3Prog::GetPath(XdrReader& inStream)
 {
 	NFSv3FileHandle object{};
 	Read(inStream, object);
 
-	std::string path;
+	std::pmr::string path(GetPathResource());
 	if (!m_fileTable->GetFilePath(*(reinterpret_cast<uint64_t*>(object.contents)), path))
 	{
 		throw std::runtime_error("file handle is invalid");
@@ -2132,14 +2335,14 @@ std::string NFS3Prog::GetPath(IInputStream& inStream)
 }
 
 /////////////////////////////////////////////////////////////////////
-bool NFS3Prog::ReadDirectory(IInputStream& inStream, std::string& dirName, std::string& fileName)
+bool NFS3Prog::ReadDirectory(XdrReader& inStream, std::pmr::string& dirName, std::pmr::string& fileName)
 {
 	DirOpArgs3 fileRequest{};
 	Read(inStream, fileRequest);
 
 	if (m_fileTable->GetFilePath(*(reinterpret_cast<uint64_t*>(fileRequest.dir.contents)), dirName))
 	{
-		fileName = std::string(fileRequest.name.name);
+		fileName.assign(fileRequest.name.name);
 		return true;
 	}
 
@@ -2147,13 +2350,16 @@ bool NFS3Prog::ReadDirectory(IInputStream& inStream, std::string& dirName, std::
 }
 
 /////////////////////////////////////////////////////////////////////
-std::string NFS3Prog::GetFullPath(const std::string& dirName, const std::string& fileName)
+std::pmr::string NFS3Prog::GetFullPath(const std::pmr::string& dirName, const std::pmr::string& fileName)
 {
-	return dirName + "\\" + fileName;
+	std::pmr::string path(GetPathResource());
+	path.reserve(dirName.size() + 1 + fileName.size());
+	path.append(dirName).append(1, '\\').append(fileName);
+	return path;
 }
 
 /////////////////////////////////////////////////////////////////////
-NfsStat3 NFS3Prog::CheckFile(const std::string& fullPath)
+NfsStat3 NFS3Prog::CheckFile(const std::pmr::string& fullPath)
 {
 	if (_access(fullPath.c_str(), 0) != 0)
 	{
@@ -2164,15 +2370,15 @@ NfsStat3 NFS3Prog::CheckFile(const std::string& fullPath)
 }
 
 /////////////////////////////////////////////////////////////////////
-NfsStat3 NFS3Prog::CheckFile(const std::string& directory, const std::string& fullPath)
+NfsStat3 NFS3Prog::CheckFile(const std::pmr::string& directory, const std::pmr::string& fullPath)
 {
 	// FileExists will not work for the root of a drive, e.g. \\?\D:\, therefore check if it is a drive root with GetDriveType
-	if (!m_fileTable->FileExists(directory) && GetDriveType(directory.c_str()) < 2)
+	if (!m_fileTable->FileExists(directory.c_str()) && GetDriveType(directory.c_str()) < 2)
 	{
 		return NFS3ERR_STALE;
 	}
 
-	if (!m_fileTable->FileExists(fullPath))
+	if (!m_fileTable->FileExists(fullPath.c_str()))
 	{
 		return NFS3ERR_NOENT;
 	}
@@ -2181,7 +2387,7 @@ NfsStat3 NFS3Prog::CheckFile(const std::string& directory, const std::string& fu
 }
 
 /////////////////////////////////////////////////////////////////////
-bool NFS3Prog::GetFileHandle(const std::string& path, NFSv3FileHandle* pObject)
+bool NFS3Prog::GetFileHandle(std::string_view path, NFSv3FileHandle* pObject)
 {
 	const auto handle = m_fileTable->GetFileHandle(path);
 	if (!handle)
@@ -2200,7 +2406,7 @@ bool NFS3Prog::GetFileHandle(const std::string& path, NFSv3FileHandle* pObject)
 }
 
 /////////////////////////////////////////////////////////////////////
-bool NFS3Prog::GetFileAttributesForNFS(const std::string& path, WccAttr* pAttr)
+bool NFS3Prog::GetFileAttributesForNFS(const std::pmr::string& path, WccAttr* pAttr)
 {
 	struct stat data;
 
@@ -2222,7 +2428,7 @@ bool NFS3Prog::GetFileAttributesForNFS(const std::string& path, WccAttr* pAttr)
 }
 
 /////////////////////////////////////////////////////////////////////
-bool NFS3Prog::GetFileAttributesForNFS(const std::string& path, FAttr3* pAttr)
+bool NFS3Prog::GetFileAttributesForNFS(const std::pmr::string& path, FAttr3* pAttr)
 {
 	const DWORD fileAttr = GetFileAttributes(path.c_str());
 	if (fileAttr == INVALID_FILE_ATTRIBUTES)
@@ -2302,6 +2508,21 @@ bool NFS3Prog::GetFileAttributesForNFS(const std::string& path, FAttr3* pAttr)
 	return true;
 }
 
+/////////////////////////////////////////////////////////////////////
+bool NFS3Prog::IsZeroCopyRead(std::string_view path) const
+{
+	for (const auto& exportedPath : m_zeroCopyPaths)
+	{
+		if (boost::algorithm::istarts_with(path, exportedPath)
+			&& (path.size() == exportedPath.size() || path[exportedPath.size()] == '\\'))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
 /////////////////////////////////////////////////////////////////////
 UINT32 NFS3Prog::FileTimeToPOSIX(FILETIME ft)
 {
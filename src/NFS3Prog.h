@@ -10,9 +10,13 @@
 #include "RPCProg.h"
 
 #include <string>
+#include <string_view>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <windows.h>
 #include <unordered_map>
+#include <vector>
 
 using FileId3 = uint64_t;
 using Cookie3 = uint64_t;
@@ -55,48 +59,65 @@ public:
 	NFS3Prog(std::shared_ptr<FileTable> fileTable, unsigned int uid, unsigned int gid);
 	~NFS3Prog() = default;
 
-	int Process(IInputStream& inStream, IOutputStream& outStream, RPCParam& param) override;
+	int Process(XdrReader& inStream, XdrWriter& outStream, RPCParam& param) override;
+	bool IsIdempotent(const RPCParam& param) const override;
+	/// <summary> Let the transport send READ data of the files under the path by itself </summary>
+	/// <param name="path"> Exported path as formatted by the mount program </param>
+	void EnableZeroCopyRead(const std::string& path);
 
 protected:
 	unsigned int m_uid, m_gid;
 
-	NfsStat3 ProcedureNULL(IInputStream& inStream, IOutputStream& outStream, RPCParam& param);
-	NfsStat3 ProcedureGETATTR(IInputStream& inStream, IOutputStream& outStream, RPCParam& param);
-	NfsStat3 ProcedureSETATTR(IInputStream& inStream, IOutputStream& outStream, RPCParam& param);
-	NfsStat3 ProcedureLOOKUP(IInputStream& inStream, IOutputStream& outStream, RPCParam& param);
-	NfsStat3 ProcedureACCESS(IInputStream& inStream, IOutputStream& outStream, RPCParam& param);
-	NfsStat3 ProcedureREADLINK(IInputStream& inStream, IOutputStream& outStream, RPCParam& param);
-	NfsStat3 ProcedureREAD(IInputStream& inStream, IOutputStream& outStream, RPCParam& param);
-	NfsStat3 ProcedureWRITE(IInputStream& inStream, IOutputStream& outStream, RPCParam& param);
-	NfsStat3 ProcedureCREATE(IInputStream& inStream, IOutputStream& outStream, RPCParam& param);
-	NfsStat3 ProcedureMKDIR(IInputStream& inStream, IOutputStream& outStream, RPCParam& param);
-	NfsStat3 ProcedureSYMLINK(IInputStream& inStream, IOutputStream& outStream, RPCParam& param);
-	NfsStat3 ProcedureMKNOD(IInputStream& inStream, IOutputStream& outStream, RPCParam& param);
-	NfsStat3 ProcedureREMOVE(IInputStream& inStream, IOutputStream& outStream, RPCParam& param);
-	NfsStat3 ProcedureRMDIR(IInputStream& inStream, IOutputStream& outStream, RPCParam& param);
-	NfsStat3 ProcedureRENAME(IInputStream& inStream, IOutputStream& outStream, RPCParam& param);
-	NfsStat3 ProcedureLINK(IInputStream& inStream, IOutputStream& outStream, RPCParam& param);
-	NfsStat3 ProcedureREADDIR(IInputStream& inStream, IOutputStream& outStream, RPCParam& param);
-	NfsStat3 ProcedureREADDIRPLUS(IInputStream& inStream, IOutputStream& outStream, RPCParam& param);
-	NfsStat3 ProcedureFSSTAT(IInputStream& inStream, IOutputStream& outStream, RPCParam& param);
-	NfsStat3 ProcedureFSINFO(IInputStream& inStream, IOutputStream& outStream, RPCParam& param);
-	NfsStat3 ProcedurePATHCONF(IInputStream& inStream, IOutputStream& outStream, RPCParam& param);
-	NfsStat3 ProcedureCOMMIT(IInputStream& inStream, IOutputStream& outStream, RPCParam& param);
-	NfsStat3 ProcedureNOIMP(IInputStream& inStream, IOutputStream& outStream, RPCParam& param);
+	NfsStat3 ProcedureNULL(XdrReader& inStream, XdrWriter& outStream, RPCParam& param);
+	NfsStat3 ProcedureGETATTR(XdrReader& inStream, XdrWriter& outStream, RPCParam& param);
+	NfsStat3 ProcedureSETATTR(XdrReader& inStream, XdrWriter& outStream, RPCParam& param);
+	NfsStat3 ProcedureLOOKUP(XdrReader& inStream, XdrWriter& outStream, RPCParam& param);
+	NfsStat3 ProcedureACCESS(XdrReader& inStream, XdrWriter& outStream, RPCParam& param);
+	NfsStat3 ProcedureREADLINK(XdrReader& inStream, XdrWriter& outStream, RPCParam& param);
+	NfsStat3 ProcedureREAD(XdrReader& inStream, XdrWriter& outStream, RPCParam& param);
+	NfsStat3 ProcedureWRITE(XdrReader& inStream, XdrWriter& outStream, RPCParam& param);
+	NfsStat3 ProcedureCREATE(XdrReader& inStream, XdrWriter& outStream, RPCParam& param);
+	NfsStat3 ProcedureMKDIR(XdrReader& inStream, XdrWriter& outStream, RPCParam& param);
+	NfsStat3 ProcedureSYMLINK(XdrReader& inStream, XdrWriter& outStream, RPCParam& param);
+	NfsStat3 ProcedureMKNOD(XdrReader& inStream, XdrWriter& outStream, RPCParam& param);
+	NfsStat3 ProcedureREMOVE(XdrReader& inStream, XdrWriter& outStream, RPCParam& param);
+	NfsStat3 ProcedureRMDIR(XdrReader& inStream, XdrWriter& outStream, RPCParam& param);
+	NfsStat3 ProcedureRENAME(XdrReader& inStream, XdrWriter& outStream, RPCParam& param);
+	NfsStat3 ProcedureLINK(XdrReader& inStream, XdrWriter& outStream, RPCParam& param);
+	NfsStat3 ProcedureREADDIR(XdrReader& inStream, XdrWriter& outStream, RPCParam& param);
+	NfsStat3 ProcedureREADDIRPLUS(XdrReader& inStream, XdrWriter& outStream, RPCParam& param);
+	NfsStat3 ProcedureFSSTAT(XdrReader& inStream, XdrWriter& outStream, RPCParam& param);
+	NfsStat3 ProcedureFSINFO(XdrReader& inStream, XdrWriter& outStream, RPCParam& param);
+	NfsStat3 ProcedurePATHCONF(XdrReader& inStream, XdrWriter& outStream, RPCParam& param);
+	NfsStat3 ProcedureCOMMIT(XdrReader& inStream, XdrWriter& outStream, RPCParam& param);
+	NfsStat3 ProcedureNOIMP(XdrReader& inStream, XdrWriter& outStream, RPCParam& param);
 
 private:
-	std::string GetPath(IInputStream& inStream);
-	bool ReadDirectory(IInputStream& inStream, std::string& dirName, std::string& fileName);
-	std::string GetFullPath(const std::string& dirName, const std::string& fileName);
-	NfsStat3 CheckFile(const std::string& fullPath);
-	NfsStat3 CheckFile(const std::string&, const std::string& fullPath);
-	bool GetFileHandle(const std::string& path, NFSv3FileHandle* pObject);
-	bool GetFileAttributesForNFS(const std::string& path, WccAttr* pAttr);
-	bool GetFileAttributesForNFS(const std::string& path, FAttr3* pAttr);
+	// The paths live as long as the procedure, they are built in the arena of the request
+	std::pmr::string GetPath(XdrReader& inStream);
+	bool ReadDirectory(XdrReader& inStream, std::pmr::string& dirName, std::pmr::string& fileName);
+	std::pmr::string GetFullPath(const std::pmr::string& dirName, const std::pmr::string& fileName);
+	NfsStat3 CheckFile(const std::pmr::string& fullPath);
+	NfsStat3 CheckFile(const std::pmr::string&, const std::pmr::string& fullPath);
+	bool GetFileHandle(std::string_view path, NFSv3FileHandle* pObject);
+	bool GetFileAttributesForNFS(const std::pmr::string& path, WccAttr* pAttr);
+	bool GetFileAttributesForNFS(const std::pmr::string& path, FAttr3* pAttr);
 	UINT32 FileTimeToPOSIX(FILETIME ft);
-	std::unordered_map<int, FILE*> unstableStorageFile;
+	bool IsZeroCopyRead(std::string_view path) const;
+
+	// File kept open for the UNSTABLE writes until COMMIT
+	struct UnstableFile
+	{
+		std::mutex lock;         // guards the file and its position
+		FILE* file = nullptr;
+		bool committed = false;  // closed by COMMIT and left out of the map
+	};
+
+	std::unordered_map<int, std::shared_ptr<UnstableFile>> unstableStorageFile;
+	std::mutex m_unstableStorageLock; // guards the map only, the writes lock their own file
 
 	std::shared_ptr<FileTable> m_fileTable;
+	std::vector<std::string> m_zeroCopyPaths; // set up before serving, read only afterwards
 };
 
 #endif // ICENFSD_NFS3PROG_H
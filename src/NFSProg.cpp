@@ -20,7 +20,7 @@ NFSProg::~NFSProg()
 {}
 
 /////////////////////////////////////////////////////////////////////
-int NFSProg::Process(IInputStream& inStream, IOutputStream& outStream, RPCParam& param)
+int NFSProg::Process(XdrReader& inStream, XdrWriter& outStream, RPCParam& param)
 {
 	if (param.version == 3)
 	{
@@ -32,4 +32,16 @@ int NFSProg::Process(IInputStream& inStream, IOutputStream& outStream, RPCParam&
 			<< param.version << " which is not supported";
 		return PRC_NOTIMP;
 	}
+}
+
+/////////////////////////////////////////////////////////////////////
+bool NFSProg::IsIdempotent(const RPCParam& param) const
+{
+	return param.version != 3 || m_nfs3->IsIdempotent(param);
+}
+
+/////////////////////////////////////////////////////////////////////
+void NFSProg::EnableZeroCopyRead(const std::string& path)
+{
+	m_nfs3->EnableZeroCopyRead(path);
 }
\ No newline at end of file
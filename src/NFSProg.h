@@ -10,6 +10,7 @@
 #include "RPCProg.h"
 
 #include <memory>
+#include <string>
 
 class FileTable;
 class NFS3Prog;
@@ -20,7 +21,9 @@ public:
 	NFSProg(std::shared_ptr<FileTable> fileTable, unsigned int uid, unsigned int gid);
 	~NFSProg();
 
-	int Process(IInputStream& inStream, IOutputStream& outStream, RPCParam& param) override;
+	int Process(XdrReader& inStream, XdrWriter& outStream, RPCParam& param) override;
+	bool IsIdempotent(const RPCParam& param) const override;
+	void EnableZeroCopyRead(const std::string& path);
 
 private:
 	std::unique_ptr<NFS3Prog> m_nfs3;
@@ -23,6 +23,10 @@ public:
 	/// <summary> Write uint64_t value to the stream </summary>
 	/// <param name="value"> A value to write </param>
 	virtual void Write8(uint64_t value) = 0;
+	/// <summary> Write an array of uint32_t values to the stream at once </summary>
+	/// <param name="values"> Pointer to the values </param>
+	/// <param name="count"> Amount of the values to write </param>
+	virtual void WriteWords(const uint32_t* values, size_t count) = 0;
 	/// <summary> Set writing position in the stream </summary>
 	/// <param name="offset"> Offset to set </param>
 	/// <param name="from"> Direction to count from </param>
@@ -30,6 +34,29 @@ public:
 	/// <summary> Get current position in the stream </summary>
 	/// <returns> Offset in stream </returns>
 	virtual size_t GetPosition() const noexcept = 0;
+	/// <summary> Get the buffer at the current position to store the data in place </summary>
+	/// <param name="size"> Amount of bytes to be stored at least </param>
+	/// <param name="capacity"> Receives amount of bytes which may be stored </param>
+	/// <returns> Pointer to the buffer, valid until the stream is changed otherwise </returns>
+	virtual unsigned char* GetWindow(size_t size, size_t& capacity) = 0;
+	/// <summary> Move the current position past the bytes stored into the buffer got from GetWindow() </summary>
+	/// <param name="size"> Amount of bytes stored </param>
+	virtual void Advance(size_t size) = 0;
+	/// <summary> Get a buffer for the bulk data to be sent without copying it into the stream </summary>
+	/// <param name="size"> Maximal amount of bytes to store in the buffer </param>
+	/// <returns> Pointer to the buffer, valid until CommitSegment() is called </returns>
+	virtual unsigned char* AcquireSegment(size_t size) = 0;
+	/// <summary> Append the buffer got from AcquireSegment() at the current position of the stream </summary>
+	/// <param name="size"> Amount of bytes actually stored in the buffer, zero drops the buffer </param>
+	virtual void CommitSegment(size_t size) = 0;
+	/// <summary> Check whether the stream is able to send a file range by itself </summary>
+	/// <returns> True if AttachFile() may be used </returns>
+	virtual bool CanAttachFile() const noexcept = 0;
+	/// <summary> Append a file range at the current position of the stream, it is sent without reading it here </summary>
+	/// <param name="file"> Handle of the file opened for reading, the stream closes it after sending </param>
+	/// <param name="offset"> Offset of the range in the file </param>
+	/// <param name="size"> Size of the range </param>
+	virtual void AttachFile(void* file, uint64_t offset, uint32_t size) = 0;
 };
 
 #endif
@@ -0,0 +1,75 @@
+/////////////////////////////////////////////////////////////////////
+/// file: PathIndex.cpp
+///
+/// summary: hash index of the file handles by their full paths
+/////////////////////////////////////////////////////////////////////
+
+#include "PathIndex.h"
+#include <functional>
+#include <mutex>
+
+/////////////////////////////////////////////////////////////////////
+bool PathIndex::Find(std::string_view path, uint64_t& handle) const
+{
+	const Shard& shard = GetShard(path);
+	std::shared_lock<std::shared_mutex> lock(shard.lock);
+	auto it = shard.handles.find(path);
+	if (it == shard.handles.end())
+	{
+		return false;
+	}
+
+	handle = it->second.handle;
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////
+void PathIndex::Insert(std::string_view path, uint64_t handle)
+{
+	Shard& shard = GetShard(path);
+	std::unique_lock<std::shared_mutex> lock(shard.lock);
+	auto it = shard.handles.find(path);
+	if (it != shard.handles.end())
+	{
+		it->second.handle = handle;
+		return;
+	}
+
+	auto key = std::make_unique<const std::string>(path);
+	const std::string_view keyView(*key);
+	shard.handles.emplace(keyView, Entry{ std::move(key), handle });
+}
+
+/////////////////////////////////////////////////////////////////////
+void PathIndex::Erase(std::string_view path)
+{
+	Shard& shard = GetShard(path);
+	std::unique_lock<std::shared_mutex> lock(shard.lock);
+	shard.handles.erase(path);
+}
+
+/////////////////////////////////////////////////////////////////////
+size_t PathIndex::GetSize() const
+{
+	size_t size = 0;
+	for (const auto& shard : m_shards)
+	{
+		std::shared_lock<std::shared_mutex> lock(shard.lock);
+		size += shard.handles.size();
+	}
+	return size;
+}
+
+/////////////////////////////////////////////////////////////////////
+PathIndex::Shard& PathIndex::GetShard(std::string_view path) noexcept
+{
+	// the low bits pick the bucket inside the shard, take the high ones
+	const size_t hash = std::hash<std::string_view>{}(path);
+	return m_shards[(hash >> (sizeof(size_t) * 8 - 8)) % SHARD_COUNT];
+}
+
+/////////////////////////////////////////////////////////////////////
+const PathIndex::Shard& PathIndex::GetShard(std::string_view path) const noexcept
+{
+	return const_cast<PathIndex*>(this)->GetShard(path);
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+/////////////////////////////////////////////////////////////////////
+/// file: PathIndex.h
+///
+/// summary: hash index of the file handles by their full paths
+/////////////////////////////////////////////////////////////////////
+
+#ifndef ICENFSD_PATHINDEX_H
+#define ICENFSD_PATHINDEX_H
+
+#include <unordered_map>
+#include <shared_mutex>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <array>
+
+// LOOKUP, CREATE and every READDIR entry resolve a full path to its
+// handle, so the file table probes this index first and walks the tree
+// only for the paths it has not seen. The paths are spread over shards
+// by their hash, each with its own readers-writer lock, so the workers
+// looking paths up do not wait for each other nor for the file table.
+// The paths are looked up by view, whatever string the request has
+// built them in, without a copy to the heap.
+class PathIndex
+{
+public:
+	PathIndex() = default;
+
+	PathIndex(const PathIndex&) = delete;
+	PathIndex& operator=(const PathIndex&) = delete;
+
+	/// <summary> Look the handle of the path up </summary>
+	/// <param name="path"> Full path, as given to the file table </param>
+	/// <param name="handle"> Receives the handle if the path is known </param>
+	/// <returns> true if the path is known </returns>
+	bool Find(std::string_view path, uint64_t& handle) const;
+	/// <summary> Remember the handle of the path, replacing the one it had </summary>
+	void Insert(std::string_view path, uint64_t handle);
+	/// <summary> Forget the path </summary>
+	void Erase(std::string_view path);
+	/// <summary> Get amount of the known paths </summary>
+	size_t GetSize() const;
+
+	static constexpr size_t SHARD_COUNT = 16;
+
+private:
+	struct Entry
+	{
+		std::unique_ptr<const std::string> path; // the key views it, it does not move with the entry
+		uint64_t handle;
+	};
+	struct Shard
+	{
+		mutable std::shared_mutex lock;
+		std::unordered_map<std::string_view, Entry> handles;
+	};
+
+	std::array<Shard, SHARD_COUNT> m_shards;
+
+	Shard& GetShard(std::string_view path) noexcept;
+	const Shard& GetShard(std::string_view path) const noexcept;
+};
+
+#endif // ICENFSD_PATHINDEX_H
\ No newline at end of file
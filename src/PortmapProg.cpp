@@ -5,8 +5,7 @@
 /////////////////////////////////////////////////////////////////////
 
 #include "PortmapProg.h"
-#include "InputStream.h"
-#include "OutputStream.h"
+#include "XdrStream.h"
 
 #include <boost/log/trivial.hpp>
 #include <cstring>
@@ -57,9 +56,9 @@ void PortmapProg::Set(uint32_t prog, uint32_t port)
 }
 
 /////////////////////////////////////////////////////////////////////
-int PortmapProg::Process(IInputStream& inStream, IOutputStream& outStream, RPCParam& param)
+int PortmapProg::Process(XdrReader& inStream, XdrWriter& outStream, RPCParam& param)
 {
-	typedef int (PortmapProg::* PPROC)(IInputStream&, IOutputStream&);
+	typedef int (PortmapProg::* PPROC)(XdrReader&, XdrWriter&);
 	static PPROC pf[] = {
 		&PortmapProg::ProcedureNULL, &PortmapProg::ProcedureSET, &PortmapProg::ProcedureUNSET,
 		&PortmapProg::ProcedureGETPORT, &PortmapProg::ProcedureDUMP, &PortmapProg::ProcedureCALLIT
@@ -75,42 +74,46 @@ int PortmapProg::Process(IInputStream& inStream, IOutputStream& outStream, RPCPa
 }
 
 /////////////////////////////////////////////////////////////////////
-int PortmapProg::ProcedureNULL(IInputStream&, IOutputStream&) noexcept
+int PortmapProg::ProcedureNULL(XdrReader&, XdrWriter&) noexcept
 {
 	BOOST_LOG_TRIVIAL(debug) << "PORTMAP: NULL command";
 	return PRC_OK;
 }
 
 /////////////////////////////////////////////////////////////////////
-int PortmapProg::ProcedureSET(IInputStream&, IOutputStream&) noexcept
+int PortmapProg::ProcedureSET(XdrReader&, XdrWriter&) noexcept
 {
 	BOOST_LOG_TRIVIAL(debug) << "PORTMAP: SET command (not implemented)";
 	return PRC_NOTIMP;
 }
 
 /////////////////////////////////////////////////////////////////////
-int PortmapProg::ProcedureUNSET(IInputStream&, IOutputStream&) noexcept
+int PortmapProg::ProcedureUNSET(XdrReader&, XdrWriter&) noexcept
 {
 	BOOST_LOG_TRIVIAL(debug) << "PORTMAP: UNSET command (not implemented)";
 	return PRC_NOTIMP;
 }
 
 /////////////////////////////////////////////////////////////////////
-int PortmapProg::ProcedureGETPORT(IInputStream& input, IOutputStream& output) noexcept
+int PortmapProg::ProcedureGETPORT(XdrReader& input, XdrWriter& output) noexcept
 {
 	PortmapHeader header{};
 	unsigned long port = 0;
 
 	input.Read(&header.prog);  //program
 	input.Skip(12);
-	port = m_portTable[header.prog];
+	const auto mapping = m_portTable.find(header.prog);  // do not modify the table, it is shared by the workers
+	if (m_portTable.cend() != mapping)
+	{
+		port = mapping->second;
+	}
 	BOOST_LOG_TRIVIAL(debug) << "PORTMAP: GETPORT command: program " << header.prog << " listens port " << port;
 	output.Write(port);  //port
 	return PRC_OK;
 }
 
 /////////////////////////////////////////////////////////////////////
-int PortmapProg::ProcedureDUMP(IInputStream&, IOutputStream& outStream) noexcept
+int PortmapProg::ProcedureDUMP(XdrReader&, XdrWriter& outStream) noexcept
 {
 	BOOST_LOG_TRIVIAL(debug) << "PORTMAP: DUMP command";
 
@@ -134,7 +137,7 @@ int PortmapProg::ProcedureDUMP(IInputStream&, IOutputStream& outStream) noexcept
 }
 
 /////////////////////////////////////////////////////////////////////
-int PortmapProg::ProcedureCALLIT(IInputStream&, IOutputStream&) noexcept
+int PortmapProg::ProcedureCALLIT(XdrReader&, XdrWriter&) noexcept
 {
 	BOOST_LOG_TRIVIAL(debug) << "PORTMAP: CALLIT command (not implemented)";
 	return PRC_NOTIMP;
@@ -16,17 +16,17 @@ public:
 	virtual ~PortmapProg() = default;
 
 	void Set(uint32_t prog, uint32_t port);
-	int Process(IInputStream& inStream, IOutputStream& outStream, RPCParam& param);
+	int Process(XdrReader& inStream, XdrWriter& outStream, RPCParam& param);
 
 private:
 	std::map<uint32_t, uint32_t> m_portTable;
 
-	int ProcedureNULL(IInputStream& inStream, IOutputStream& outStream) noexcept;
-	int ProcedureSET(IInputStream& inStream, IOutputStream& outStream) noexcept;
-	int ProcedureUNSET(IInputStream& inStream, IOutputStream& outStream) noexcept;
-	int ProcedureGETPORT(IInputStream& inStream, IOutputStream& outStream) noexcept;
-	int ProcedureDUMP(IInputStream& inStream, IOutputStream& outStream) noexcept;
-	int ProcedureCALLIT(IInputStream& inStream, IOutputStream& outStream) noexcept;
+	int ProcedureNULL(XdrReader& inStream, XdrWriter& outStream) noexcept;
+	int ProcedureSET(XdrReader& inStream, XdrWriter& outStream) noexcept;
+	int ProcedureUNSET(XdrReader& inStream, XdrWriter& outStream) noexcept;
+	int ProcedureGETPORT(XdrReader& inStream, XdrWriter& outStream) noexcept;
+	int ProcedureDUMP(XdrReader& inStream, XdrWriter& outStream) noexcept;
+	int ProcedureCALLIT(XdrReader& inStream, XdrWriter& outStream) noexcept;
 };
 
 #endif // ICENFSD_PORTMAPPROG_H
@@ -33,14 +33,18 @@ struct RPCParam
 	std::string remoteAddr;
 };
 
-class IInputStream;
-class IOutputStream;
+class XdrReader;
+class XdrWriter;
 
 class RPCProg
 {
 public:
 	virtual ~RPCProg() = default;
-	virtual int Process(IInputStream& inStream, IOutputStream& outStream, RPCParam& param) = 0;
+	virtual int Process(XdrReader& inStream, XdrWriter& outStream, RPCParam& param) = 0;
+	/// <summary> Tell whether executing the procedure again gives the same result </summary>
+	/// <param name="param"> Version and procedure of the request </param>
+	/// <returns> false if the reply of a retransmission must be taken from the cache </returns>
+	virtual bool IsIdempotent(const RPCParam& /*param*/) const { return true; }
 };
 
 #endif // ICENFSD_RPCPROG_H
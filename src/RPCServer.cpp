@@ -7,10 +7,19 @@
 #include "RPCServer.h"
 #include "ServerSocket.h"
 #include "RPCProg.h"
+#include "RequestArena.h"
+#include "HeapCounter.h"
 #include "Socket.h"
+#include "InputStream.h"
+#include "OutputStream.h"
+#include "XdrStream.h"
 
+#include <WS2tcpip.h>
 #include <boost/log/trivial.hpp>
+#include <algorithm>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 #define MIN_PROG_NUM 100000
 enum
@@ -42,7 +51,7 @@ struct OpaqueAuth
 
 struct RpcHeader
 {
-	uint32_t header;
+	uint32_t header;  // record marking of the TCP reply
 	uint32_t xid;
 	uint32_t msg;
 	uint32_t rpcvers;
@@ -53,6 +62,128 @@ struct RpcHeader
 	OpaqueAuth verf;
 };
 
+/////////////////////////////////////////////////////////////////////
+// Passes the reply through to the socket stream and keeps a copy of
+// its bytes for the duplicate request cache
+class ReplyRecorder : public IOutputStream
+{
+public:
+	ReplyRecorder(IOutputStream& target, DuplicateRequestCache::Reply& reply)
+		: m_target(target)
+		, m_reply(reply)
+		, m_start(target.GetPosition())
+		, m_segment(nullptr)
+		, m_window(nullptr)
+	{}
+
+	void Write(const void* data, size_t size) override
+	{
+		const size_t position = m_target.GetPosition();
+		m_target.Write(data, size);
+		Record(position, data, size);
+	}
+
+	void Write(uint32_t value) override
+	{
+		const size_t position = m_target.GetPosition();
+		unsigned char bytes[sizeof(value)];
+		XdrEncode(bytes, value);
+		m_target.Write(value);
+		Record(position, bytes, sizeof(bytes));
+	}
+
+	void Write8(uint64_t value) override
+	{
+		Write(static_cast<uint32_t>(value >> 32));
+		Write(static_cast<uint32_t>(value));
+	}
+
+	void WriteWords(const uint32_t* values, size_t count) override
+	{
+		// encoded a chunk at a time on the stack, the recording must not allocate per call
+		unsigned char bytes[WORD_CHUNK * sizeof(uint32_t)];
+		while (count > 0)
+		{
+			const size_t words = std::min(count, WORD_CHUNK);
+			XdrEncodeWords(bytes, values, words);
+			Write(bytes, words * sizeof(uint32_t));
+			values += words;
+			count -= words;
+		}
+	}
+
+	void Seek(off_t offset, int from) override
+	{
+		m_target.Seek(offset, from);
+	}
+
+	size_t GetPosition() const noexcept override
+	{
+		return m_target.GetPosition();
+	}
+
+	unsigned char* GetWindow(size_t size, size_t& capacity) override
+	{
+		m_window = m_target.GetWindow(size, capacity);
+		return m_window;
+	}
+
+	void Advance(size_t size) override
+	{
+		const size_t position = m_target.GetPosition();
+		m_target.Advance(size);
+		Record(position, m_window, size);
+		m_window += size;
+	}
+
+	unsigned char* AcquireSegment(size_t size) override
+	{
+		m_segment = m_target.AcquireSegment(size);
+		return m_segment;
+	}
+
+	void CommitSegment(size_t size) override
+	{
+		const size_t position = m_target.GetPosition();
+		if (size > 0)
+		{
+			Record(position, m_segment, size);
+		}
+		m_target.CommitSegment(size);
+		m_segment = nullptr;
+	}
+
+	bool CanAttachFile() const noexcept override
+	{
+		return false;  // the file may change before the reply is sent again
+	}
+
+	void AttachFile(void*, uint64_t, uint32_t) override
+	{
+		throw std::runtime_error("files cannot be attached to the cached replies");
+	}
+
+private:
+	static constexpr size_t WORD_CHUNK = 64;
+
+	IOutputStream& m_target;
+	DuplicateRequestCache::Reply& m_reply;
+	const size_t m_start;
+	unsigned char* m_segment;
+	unsigned char* m_window;  // the bytes stored in place are recorded as they are passed
+
+	void Record(size_t position, const void* data, size_t size)
+	{
+		const size_t offset = position - m_start;
+		if (m_reply.size() < offset + size)
+		{
+			m_reply.resize(offset + size);
+		}
+		const auto bytes = static_cast<const unsigned char*>(data);
+		std::copy(bytes, bytes + size, m_reply.begin() + offset);
+	}
+};
+
 /////////////////////////////////////////////////////////////////////
 RPCServer::~RPCServer()
 {}
@@ -79,50 +210,46 @@ RPCProg& RPCServer::Get(uint32_t progNum)
 }
 
 /////////////////////////////////////////////////////////////////////
-void RPCServer::SocketReceived(Socket* socket)
+void RPCServer::SocketReceived(Socket* socket, const sockaddr_in& remoteAddr, IInputStream& inStream, IOutputStream& outStream)
 {
-	std::scoped_lock<std::mutex> lock(m_lock);
-	auto& inStream = socket->GetInputStream();
-
-	while (inStream.GetSize() > 0)
-	{
-		const int result = Process(socket);  //process input data
-		socket->Send();  //send response
-
-		if (result != PRC_OK || socket->GetType() == SOCK_DGRAM)
-		{
-			break;
-		}
-	}
+	// Called concurrently by the workers, also for the requests pipelined
+	// on the same connection. The program table is filled before the
+	// server starts, the programs protect their own state.
+	// The input stream holds exactly one RPC message: a datagram or
+	// a TCP record without its record marking. The socket sends the
+	// reply written to the output stream when we return.
+	Process(socket, remoteAddr, inStream, outStream);  //process input data
 }
 
 /////////////////////////////////////////////////////////////////////
-int RPCServer::Process(Socket* socket)
+int RPCServer::Process(Socket* socket, const sockaddr_in& remoteEndpoint, IInputStream& inStream, IOutputStream& outStream)
 {
+	// The temporaries of the procedures come from the arena of the worker,
+	// it is rewound when the reply is written
+	thread_local RequestArena arena;
+	RequestArena::Scope scope(arena);
+
 	const int type = socket->GetType();
-	auto& inStream = socket->GetInputStream();
-	auto& outStream = socket->GetOutputStream();
-	const auto remoteAddr = socket->GetRemoteAddress();
+	char remoteAddr[INET_ADDRSTRLEN] = {};
+	inet_ntop(AF_INET, &remoteEndpoint.sin_addr, remoteAddr, sizeof(remoteAddr));
 	RpcHeader header{};
 	RPCParam param{};
 	size_t pos = 0, size = 0;
 	int result = PRC_OK;
 
-	if (type == SOCK_STREAM)
-	{
-		inStream.Read(&header.header);
-	}
-
-	inStream.Read(&header.xid);
-	inStream.Read(&header.msg);
-	inStream.Read(&header.rpcvers);    // rpc version
-	inStream.Read(&header.prog);       // program
-	inStream.Read(&header.vers);       // program version
-	inStream.Read(&header.proc);       // procedure
-	inStream.Read(&header.cred.flavor);
-	inStream.Read(&header.cred.length);
-	inStream.Skip(header.cred.length);
-	inStream.Read(&header.verf.flavor); // verifier
+	XdrReader reader(inStream.GetData(), inStream.GetSize());
+	uint32_t call[8] = {};
+	reader.ReadWords(call, 8);           // the fixed part of the call header at once
+	header.xid = call[0];
+	header.msg = call[1];
+	header.rpcvers = call[2];            // rpc version
+	header.prog = call[3];               // program
+	header.vers = call[4];               // program version
+	header.proc = call[5];               // procedure
+	header.cred.flavor = call[6];
+	header.cred.length = call[7];
+	reader.Skip(header.cred.length);
+	reader.Read(&header.verf.flavor);    // verifier
 
 	BOOST_LOG_TRIVIAL(debug) << "RPC from " << remoteAddr
 		<< ": xid:" << std::hex << header.xid
@@ -132,58 +259,98 @@ int RPCServer::Process(Socket* socket)
 		<< ", progVers: " << std::dec << header.vers
 		<< ", proc: " << header.proc;
 
-	if (inStream.Read(&header.verf.length) < sizeof(header.verf.length))
+	if (reader.Read(&header.verf.length) < sizeof(header.verf.length))
 	{
 		BOOST_LOG_TRIVIAL(error) << "failed to read verf length";
 		result = PRC_FAIL;
 	}
 
-	if (inStream.Skip(header.verf.length) < header.verf.length)
+	if (reader.Skip(header.verf.length) < header.verf.length)
 	{
 		BOOST_LOG_TRIVIAL(error) << "failed to skip " << header.verf.length << " verf bytes";
 		result = PRC_FAIL;
 	}
 
+	const auto prog = m_progTable.find(header.prog);
+	param.version = header.vers;
+	param.procNum = header.proc;
+	param.remoteAddr = remoteAddr;
+
+	// A retransmitted non-idempotent request is not executed again
+	// keyed by the arguments too, a client may reuse the xid for another call after a reboot or a wraparound
+	const bool cached = result != PRC_FAIL && m_progTable.cend() != prog && !prog->second->IsIdempotent(param);
+	const unsigned char* arguments = inStream.GetData() + (inStream.GetSize() - reader.GetSize());
+	const DuplicateRequestCache::Key key{ remoteEndpoint.sin_addr.s_addr, header.xid, header.prog, header.vers, header.proc,
+		static_cast<uint32_t>(reader.GetSize()), cached ? DuplicateRequestCache::GetChecksum(arguments, reader.GetSize()) : 0 };
+	DuplicateRequestCache::Reply reply;
+	const auto status = cached ? m_requestCache.Begin(key, reply) : DuplicateRequestCache::Status::New;
+
+	if (status == DuplicateRequestCache::Status::InProgress)
+	{
+		BOOST_LOG_TRIVIAL(debug) << "RPC xid:" << std::hex << header.xid << " from " << remoteAddr << " is in progress, retransmission dropped";
+		return PRC_OK;  // nothing is sent, the client retransmits again if needed
+	}
+
 	if (type == SOCK_STREAM)
 	{
 		pos = outStream.GetPosition();   // remember current position
 		outStream.Write(header.header);  // this value will be updated later
 	}
 
-	outStream.Write(header.xid);
-	outStream.Write(REPLY);
-	outStream.Write(MSG_ACCEPTED);
-	outStream.Write(header.verf.flavor);
-	outStream.Write(header.verf.length);
-
-	const auto prog = m_progTable.find(header.prog);
-
-	if (result == PRC_FAIL) // input data is truncated
-	{
-		outStream.Write(GARBAGE_ARGS);
-	}
-	else if (m_progTable.cend() == prog) // program is unavailable
+	if (status == DuplicateRequestCache::Status::Completed)
 	{
-		BOOST_LOG_TRIVIAL(error) << "RPC program " << header.prog << " not found";
-		outStream.Write(PROG_UNAVAIL);
+		BOOST_LOG_TRIVIAL(debug) << "RPC xid:" << std::hex << header.xid << " from " << remoteAddr << " is replied from the cache";
+		outStream.Write(reply.data(), reply.size());
 	}
 	else
 	{
-		outStream.Write(SUCCESS);  // this value may be modified later if process failed
-		param.version = header.vers;
-		param.procNum = header.proc;
-		param.remoteAddr = remoteAddr;
-		result = prog->second->Process(inStream, outStream, param);  //process rest input data by program
+		ReplyRecorder recorder(outStream, reply);
+		XdrWriter replyStream(cached ? static_cast<IOutputStream&>(recorder) : outStream);
 
-		if (result == PRC_NOTIMP)   // procedure is not implemented
+		try
 		{
-			outStream.Seek(-4, SEEK_CUR);
-			outStream.Write(PROC_UNAVAIL);
+			const uint32_t accepted[] = { header.xid, REPLY, MSG_ACCEPTED, header.verf.flavor, header.verf.length };
+			replyStream.WriteWords(accepted, sizeof(accepted) / sizeof(accepted[0]));
+
+			if (result == PRC_FAIL) // input data is truncated
+			{
+				replyStream.Write(GARBAGE_ARGS);
+			}
+			else if (m_progTable.cend() == prog) // program is unavailable
+			{
+				BOOST_LOG_TRIVIAL(error) << "RPC program " << header.prog << " not found";
+				replyStream.Write(PROG_UNAVAIL);
+			}
+			else
+			{
+				replyStream.Write(SUCCESS);  // this value may be modified later if process failed
+				result = prog->second->Process(reader, replyStream, param);  //process rest input data by program
+
+				if (result == PRC_NOTIMP)   // procedure is not implemented
+				{
+					replyStream.Seek(-4, SEEK_CUR);
+					replyStream.Write(PROC_UNAVAIL);
+				}
+				else if (result == PRC_FAIL) // input data is truncated
+				{
+					replyStream.Seek(-4, SEEK_CUR);
+					replyStream.Write(GARBAGE_ARGS);
+				}
+			}
+			replyStream.Flush();
 		}
-		else if (result == PRC_FAIL) // input data is truncated
+		catch (...)
+		{
+			if (cached)
+			{
+				m_requestCache.Abandon(key);  // let the retransmission try again
+			}
+			throw;
+		}
+
+		if (cached)
 		{
-			outStream.Seek(-4, SEEK_CUR);
-			outStream.Write(GARBAGE_ARGS);
+			m_requestCache.Complete(key, std::move(reply));
 		}
 	}
 
@@ -195,5 +362,17 @@ int RPCServer::Process(Socket* socket)
 		outStream.Write(header.header);                    // update header
 	}
 
+	if constexpr (HeapCounter::ENABLED)
+	{
+		// Logging allocates as well, so the debug output of a steady state shows only its own allocations
+		const uint64_t heapAllocations = scope.GetHeapAllocations();
+		BOOST_LOG_TRIVIAL(debug) << "RPC xid:" << std::hex << header.xid << std::dec << " took "
+			<< arena.GetUsedSize() << " arena bytes, " << heapAllocations << " heap allocations";
+	}
+	else
+	{
+		BOOST_LOG_TRIVIAL(debug) << "RPC xid:" << std::hex << header.xid << std::dec << " took "
+			<< arena.GetUsedSize() << " arena bytes";
+	}
 	return result;
 }
\ No newline at end of file
@@ -8,12 +8,14 @@
 #define ICENFSD_RPCSERVER_H
 
 #include "SocketListener.h"
+#include "DuplicateRequestCache.h"
 #include <memory>
-#include <mutex>
 #include <map>
 
 class RPCProg;
 class Socket;
+class IInputStream;
+class IOutputStream;
 
 class RPCServer : public ISocketListener
 {
@@ -25,13 +27,13 @@ public:
 
 	void Set(uint32_t progNumber, RPCProgPtr progHandle);
 	RPCProg& Get(uint32_t progNumber);
-	void SocketReceived(Socket* socket) override;
+	void SocketReceived(Socket* socket, const sockaddr_in& remoteAddr, IInputStream& inStream, IOutputStream& outStream) override;
 
 protected:
 	std::map<uint32_t, RPCProgPtr> m_progTable;
-	std::mutex m_lock;
+	DuplicateRequestCache m_requestCache;  // replies of the non-idempotent procedures
 
-	int Process(Socket* socket);
+	int Process(Socket* socket, const sockaddr_in& remoteEndpoint, IInputStream& inStream, IOutputStream& outStream);
 };
 
 #endif // ICENFSD_RPCSERVER_H
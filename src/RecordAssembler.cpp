@@ -0,0 +1,92 @@
+/////////////////////////////////////////////////////////////////////
+/// file: RecordAssembler.cpp
+///
+/// summary: RPC record marking decoder for the stream transport
+/////////////////////////////////////////////////////////////////////
+
+#include "RecordAssembler.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+constexpr uint32_t LAST_FRAGMENT = 0x80000000;
+
+/////////////////////////////////////////////////////////////////////
+RecordAssembler::RecordAssembler(size_t maxRecordSize)
+	: m_maxRecordSize(maxRecordSize)
+	, m_header{}
+	, m_headerSize(0)
+	, m_fragmentLeft(0)
+	, m_lastFragment(false)
+{}
+
+/////////////////////////////////////////////////////////////////////
+void RecordAssembler::Append(const unsigned char* data, size_t size)
+{
+	while (size > 0)
+	{
+		if (m_headerSize < sizeof(m_header))
+		{
+			const size_t chunk = std::min(sizeof(m_header) - m_headerSize, size);
+			std::copy(data, data + chunk, m_header + m_headerSize);
+			m_headerSize += chunk;
+			data += chunk;
+			size -= chunk;
+
+			if (m_headerSize < sizeof(m_header))
+			{
+				return; // wait for the rest of the header
+			}
+
+			const uint32_t header = (static_cast<uint32_t>(m_header[0]) << 24) | (static_cast<uint32_t>(m_header[1]) << 16)
+				| (static_cast<uint32_t>(m_header[2]) << 8) | static_cast<uint32_t>(m_header[3]);
+			m_lastFragment = (header & LAST_FRAGMENT) != 0;
+			m_fragmentLeft = header & ~LAST_FRAGMENT;
+
+			if (m_record.size() + m_fragmentLeft > m_maxRecordSize)
+			{
+				throw std::runtime_error("RPC record exceeds " + std::to_string(m_maxRecordSize) + " bytes");
+			}
+		}
+
+		// an empty fragment falls through here right after its header
+		const size_t chunk = std::min(m_fragmentLeft, size);
+		m_record.insert(m_record.end(), data, data + chunk);
+		m_fragmentLeft -= chunk;
+		data += chunk;
+		size -= chunk;
+
+		if (0 == m_fragmentLeft)
+		{
+			m_headerSize = 0; // next fragment begins
+			if (m_lastFragment)
+			{
+				m_completed.emplace_back(std::move(m_record));
+				m_record = Record{};
+			}
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+bool RecordAssembler::NextRecord(Record& record)
+{
+	if (m_completed.empty())
+	{
+		return false;
+	}
+
+	record = std::move(m_completed.front());
+	m_completed.pop_front();
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////
+void RecordAssembler::Reset()
+{
+	m_headerSize = 0;
+	m_fragmentLeft = 0;
+	m_lastFragment = false;
+	m_record.clear();
+	m_completed.clear();
+}
\ No newline at end of file
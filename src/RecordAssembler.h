@@ -0,0 +1,48 @@
+/////////////////////////////////////////////////////////////////////
+/// file: RecordAssembler.h
+///
+/// summary: RPC record marking decoder for the stream transport
+/////////////////////////////////////////////////////////////////////
+
+#ifndef ICENFSD_RECORDASSEMBLER_H
+#define ICENFSD_RECORDASSEMBLER_H
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+
+// RFC 5531, section 11: over TCP each RPC message is sent as a record of
+// one or more fragments. Every fragment is preceded by a 4-byte header: the
+// highest bit marks the last fragment, the remaining bits hold its length.
+class RecordAssembler
+{
+public:
+	using Record = std::vector<unsigned char>;
+
+	RecordAssembler(size_t maxRecordSize = DEFAULT_MAX_RECORD_SIZE);
+
+	/// <summary> Consume the bytes received from the stream </summary>
+	/// <param name="data"> Pointer to the received bytes </param>
+	/// <param name="size"> Amount of received bytes </param>
+	/// <exception cref="std::runtime_error"> The record exceeds the size limit </exception>
+	void Append(const unsigned char* data, size_t size);
+	/// <summary> Take the oldest complete record, fragment headers are stripped </summary>
+	/// <param name="record"> Receives the record payload </param>
+	/// <returns> false if there is no complete record yet </returns>
+	bool NextRecord(Record& record);
+	/// <summary> Drop all the buffered data </summary>
+	void Reset();
+
+	static constexpr size_t DEFAULT_MAX_RECORD_SIZE = 64 * 1024 * 1024;
+
+private:
+	const size_t m_maxRecordSize;
+	unsigned char m_header[4];
+	size_t m_headerSize;       // header bytes received so far
+	size_t m_fragmentLeft;     // payload bytes of the current fragment not received yet
+	bool m_lastFragment;
+	Record m_record;           // record being assembled
+	std::deque<Record> m_completed;
+};
+
+#endif // ICENFSD_RECORDASSEMBLER_H
\ No newline at end of file
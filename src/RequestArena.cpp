@@ -0,0 +1,140 @@
+/////////////////////////////////////////////////////////////////////
+/// file: RequestArena.cpp
+///
+/// summary: bump allocator of the temporaries of a request
+/////////////////////////////////////////////////////////////////////
+
+#include "RequestArena.h"
+#include "HeapCounter.h"
+#include <algorithm>
+#include <atomic>
+
+static thread_local RequestArena* currentArena = nullptr;
+
+static std::atomic<uint64_t> totalRequests(0);
+static std::atomic<uint64_t> totalAllocations(0);
+static std::atomic<uint64_t> totalBytes(0);
+static std::atomic<uint64_t> totalOwnAllocations(0);
+static std::atomic<uint64_t> totalHeapAllocations(0);
+
+/////////////////////////////////////////////////////////////////////
+RequestArena::Scope::Scope(RequestArena& arena) noexcept
+	: m_arena(arena)
+	, m_previous(currentArena)
+	, m_heapAllocations(HeapCounter::GetThreadAllocations())
+{
+	currentArena = &arena;
+}
+
+/////////////////////////////////////////////////////////////////////
+RequestArena::Scope::~Scope()
+{
+	totalRequests.fetch_add(1, std::memory_order_relaxed);
+	totalAllocations.fetch_add(m_arena.m_allocations, std::memory_order_relaxed);
+	totalBytes.fetch_add(m_arena.m_used, std::memory_order_relaxed);
+	totalOwnAllocations.fetch_add(m_arena.m_ownAllocations, std::memory_order_relaxed);
+	totalHeapAllocations.fetch_add(GetHeapAllocations(), std::memory_order_relaxed);
+
+	m_arena.Reset();
+	currentArena = m_previous;
+}
+
+/////////////////////////////////////////////////////////////////////
+uint64_t RequestArena::Scope::GetHeapAllocations() const noexcept
+{
+	// the blocks of the arena are not the request's own allocations
+	return HeapCounter::GetThreadAllocations() - m_heapAllocations - m_arena.m_ownAllocations;
+}
+
+/////////////////////////////////////////////////////////////////////
+RequestArena::RequestArena(size_t blockSize)
+	: m_blockSize(blockSize)
+	, m_block(0)
+	, m_offset(0)
+	, m_used(0)
+	, m_allocations(0)
+	, m_ownAllocations(0)
+{}
+
+/////////////////////////////////////////////////////////////////////
+RequestArena* RequestArena::GetCurrent() noexcept
+{
+	return currentArena;
+}
+
+/////////////////////////////////////////////////////////////////////
+RequestArena::Statistics RequestArena::GetStatistics() noexcept
+{
+	Statistics result{};
+	result.requests = totalRequests.load(std::memory_order_relaxed);
+	result.allocations = totalAllocations.load(std::memory_order_relaxed);
+	result.bytes = totalBytes.load(std::memory_order_relaxed);
+	result.ownAllocations = totalOwnAllocations.load(std::memory_order_relaxed);
+	result.heapAllocations = totalHeapAllocations.load(std::memory_order_relaxed);
+	return result;
+}
+
+/////////////////////////////////////////////////////////////////////
+void RequestArena::Reset() noexcept
+{
+	m_block = 0;
+	m_offset = 0;
+	m_used = 0;
+	m_allocations = 0;
+	m_ownAllocations = 0;
+}
+
+/////////////////////////////////////////////////////////////////////
+size_t RequestArena::GetUsedSize() const noexcept
+{
+	return m_used;
+}
+
+/////////////////////////////////////////////////////////////////////
+void* RequestArena::do_allocate(size_t bytes, size_t alignment)
+{
+	for (;;)
+	{
+		if (m_block < m_blocks.size())
+		{
+			Block& block = m_blocks[m_block];
+			const auto base = reinterpret_cast<uintptr_t>(block.data.get());
+			const size_t offset = static_cast<size_t>(((base + m_offset + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1)) - base);
+			if (offset <= block.size && bytes <= block.size - offset)
+			{
+				m_offset = offset + bytes;
+				m_used += bytes;
+				++m_allocations;
+				return block.data.get() + offset;
+			}
+
+			if (m_block + 1 < m_blocks.size())
+			{
+				++m_block;  // the blocks kept from the previous requests
+				m_offset = 0;
+				continue;
+			}
+		}
+
+		// The block of an oversized allocation is kept as well, the
+		// requests of a client tend to be alike
+		const uint64_t heapAllocations = HeapCounter::GetThreadAllocations();
+		const size_t size = std::max(m_blockSize, bytes + alignment);
+		m_blocks.push_back({ std::unique_ptr<unsigned char[]>(new unsigned char[size]), size });
+		m_ownAllocations += HeapCounter::GetThreadAllocations() - heapAllocations;
+		m_block = m_blocks.size() - 1;
+		m_offset = 0;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+void RequestArena::do_deallocate(void* /*data*/, size_t /*bytes*/, size_t /*alignment*/)
+{
+	// released as a whole by Reset()
+}
+
+/////////////////////////////////////////////////////////////////////
+bool RequestArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+	return this == &other;
+}
\ No newline at end of file
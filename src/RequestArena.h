@@ -0,0 +1,90 @@
+/////////////////////////////////////////////////////////////////////
+/// file: RequestArena.h
+///
+/// summary: bump allocator of the temporaries of a request
+/////////////////////////////////////////////////////////////////////
+
+#ifndef ICENFSD_REQUESTARENA_H
+#define ICENFSD_REQUESTARENA_H
+
+#include <memory_resource>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// A worker executes one request at a time, so its arena is current for
+// the request and the buffers of the procedures (file handles, names,
+// paths) are taken from it instead of the heap. Nothing is freed one by
+// one: the arena is rewound as a whole when the reply is written, and
+// its blocks are kept for the next request.
+class RequestArena : public std::pmr::memory_resource
+{
+public:
+	struct Statistics
+	{
+		uint64_t requests;        // requests executed with an arena
+		uint64_t allocations;     // allocations served by the arenas
+		uint64_t bytes;           // bytes served by the arenas
+		uint64_t ownAllocations;  // heap allocations of the arenas themselves for their blocks, with the heap counter only
+		uint64_t heapAllocations; // heap allocations made by the requests besides the arenas, with the heap counter only
+	};
+
+	// Makes the arena current for the calling thread and rewinds it at the end of the request
+	class Scope
+	{
+	public:
+		explicit Scope(RequestArena& arena) noexcept;
+		~Scope();
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+		/// <summary> Get amount of the heap allocations made by the thread since the scope has begun </summary>
+		uint64_t GetHeapAllocations() const noexcept;
+
+	private:
+		RequestArena& m_arena;
+		RequestArena* m_previous;
+		const uint64_t m_heapAllocations; // of the thread when the scope has begun
+	};
+
+	explicit RequestArena(size_t blockSize = DEFAULT_BLOCK_SIZE);
+	~RequestArena() override = default;
+
+	RequestArena(const RequestArena&) = delete;
+	RequestArena& operator=(const RequestArena&) = delete;
+
+	/// <summary> Get the arena of the request executed by the calling thread </summary>
+	/// <returns> nullptr outside of a request, the heap is to be used then </returns>
+	static RequestArena* GetCurrent() noexcept;
+	/// <summary> Get the counters summed over all the arenas </summary>
+	static Statistics GetStatistics() noexcept;
+
+	/// <summary> Forget all the allocations, the memory is reused by the next ones </summary>
+	void Reset() noexcept;
+	/// <summary> Get amount of bytes allocated since the last reset </summary>
+	size_t GetUsedSize() const noexcept;
+
+	static constexpr size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+private:
+	struct Block
+	{
+		std::unique_ptr<unsigned char[]> data;
+		size_t size;
+	};
+
+	const size_t m_blockSize;
+	std::vector<Block> m_blocks;
+	size_t m_block;   // block the allocations are taken from
+	size_t m_offset;  // first free byte of the block
+	size_t m_used;
+	uint64_t m_allocations;    // since the last reset
+	uint64_t m_ownAllocations; // since the last reset
+
+	void* do_allocate(size_t bytes, size_t alignment) override;
+	void do_deallocate(void* data, size_t bytes, size_t alignment) override;
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
+
+#endif // ICENFSD_REQUESTARENA_H
\ No newline at end of file
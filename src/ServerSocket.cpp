@@ -7,17 +7,261 @@
 #include "ServerSocket.h"
 #include <process.h>
 #include <WS2tcpip.h>
+#include <mstcpip.h>
 #include <boost/algorithm/string/trim.hpp>
+#include <boost/log/trivial.hpp>
 
+#include <algorithm>
 #include <stdexcept>
 #include <cassert>
+#include <vector>
+#include <deque>
+#include <mutex>
+
+// How often the connections are checked for being idle
+constexpr std::chrono::seconds REAP_INTERVAL(5);
+
+/////////////////////////////////////////////////////////////////////
+// The client connections of the listening socket. The sockets report
+// their closing from the reactor workers, possibly after the listening
+// socket is gone, so they refer to this object weakly.
+class ServerSocket::Connections : public std::enable_shared_from_this<ServerSocket::Connections>
+{
+public:
+	Connections(const ConnectionLimits& limits, const ConnectionTimeouts& timeouts, ISocketListener* listener,
+		SocketReactor& reactor, WorkerPool& workers, BufferPool& bufferPool)
+		: m_limits(limits)
+		, m_timeouts(timeouts)
+		, m_listener(listener)
+		, m_reactor(reactor)
+		, m_workers(workers)
+		, m_bufferPool(bufferPool)
+		, m_closed(false)
+		, m_statistics{}
+	{}
+
+	void Admit(SOCKET endpoint, const sockaddr_in& remoteAddr);
+	void Release(Socket* socket);
+	void Reap();
+	void Close();
+	ConnectionStatistics GetStatistics();
+
+private:
+	struct Pending
+	{
+		SOCKET endpoint;
+		sockaddr_in remoteAddr;
+	};
+
+	const ConnectionLimits m_limits;
+	const ConnectionTimeouts m_timeouts;
+	ISocketListener* m_listener;
+	SocketReactor& m_reactor;
+	WorkerPool& m_workers;
+	BufferPool& m_bufferPool;
+	std::mutex m_lock;
+	bool m_closed;
+	std::vector<std::shared_ptr<Socket>> m_active;
+	std::deque<Pending> m_queued;  // accepted, but not served until an active one is closed
+	ConnectionStatistics m_statistics;
+
+	std::shared_ptr<Socket> CreateSocket();
+	void Start(std::shared_ptr<Socket> socket, const Pending& connection);
+};
+
+/////////////////////////////////////////////////////////////////////
+void ServerSocket::Connections::Admit(SOCKET endpoint, const sockaddr_in& remoteAddr)
+{
+	std::shared_ptr<Socket> socket;
+	{
+		std::scoped_lock<std::mutex> lock(m_lock);
+		if (!m_closed && m_active.size() < m_limits.soft)
+		{
+			socket = CreateSocket();
+			++m_statistics.accepted;
+		}
+		else if (!m_closed && m_active.size() + m_queued.size() < m_limits.hard)
+		{
+			// The client waits for the replies, the requests pile up in the kernel
+			m_queued.push_back({ endpoint, remoteAddr });
+			++m_statistics.accepted;
+			BOOST_LOG_TRIVIAL(debug) << "Connection queued, " << m_queued.size() << " waiting";
+			return;
+		}
+		else
+		{
+			++m_statistics.rejected;
+		}
+	}
+
+	if (!socket)
+	{
+		closesocket(endpoint);
+		BOOST_LOG_TRIVIAL(warning) << "Connection rejected: the limit of " << m_limits.hard << " connections is reached";
+		return;
+	}
+
+	// The reactor must not be called under our lock, it closes the sockets under its own
+	Start(std::move(socket), { endpoint, remoteAddr });
+}
 
 /////////////////////////////////////////////////////////////////////
-ServerSocket::ServerSocket(const sockaddr_in& endpoint, int maxClients, ISocketListener* listener)
+void ServerSocket::Connections::Release(Socket* socket)
+{
+	std::vector<std::pair<std::shared_ptr<Socket>, Pending>> started;
+	std::shared_ptr<Socket> released;  // destroy it after unlocking
+	{
+		std::scoped_lock<std::mutex> lock(m_lock);
+		if (m_closed)
+		{
+			return;
+		}
+
+		const auto it = std::find_if(m_active.begin(), m_active.end(),
+			[socket](const std::shared_ptr<Socket>& item) { return item.get() == socket; });
+		if (m_active.end() != it)
+		{
+			released = std::move(*it);
+			m_active.erase(it);
+			m_statistics.sends += released->GetSends();
+			m_statistics.replies += released->GetReplies();
+		}
+
+		while (m_active.size() < m_limits.soft && !m_queued.empty())
+		{
+			started.emplace_back(CreateSocket(), m_queued.front());
+			m_queued.pop_front();
+		}
+	}
+
+	for (auto& connection : started)
+	{
+		Start(std::move(connection.first), connection.second);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+void ServerSocket::Connections::Reap()
+{
+	// Peers that went away without closing (e.g. suspended laptops) keep
+	// their slots and buffers, the keepalive probes find only some of them
+	std::vector<std::shared_ptr<Socket>> idle;
+	{
+		std::scoped_lock<std::mutex> lock(m_lock);
+		if (m_closed)
+		{
+			return;
+		}
+
+		for (const auto& socket : m_active)
+		{
+			if (socket->GetIdleTime() >= m_timeouts.idle)
+			{
+				idle.push_back(socket);
+			}
+		}
+	}
+
+	uint64_t reclaimedBytes = 0;
+	for (const auto& socket : idle)
+	{
+		reclaimedBytes += socket->GetBufferedSize();
+		m_reactor.Unregister(socket.get());
+		socket->Close();  // released by its close handler
+	}
+
+	if (!idle.empty())
+	{
+		std::scoped_lock<std::mutex> lock(m_lock);
+		m_statistics.reaped += idle.size();
+		m_statistics.reclaimedBytes += reclaimedBytes;
+		BOOST_LOG_TRIVIAL(debug) << "Closed " << idle.size() << " idle connections, reclaimed " << reclaimedBytes << " bytes";
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+void ServerSocket::Connections::Close()
+{
+	std::vector<std::shared_ptr<Socket>> active;
+	std::deque<Pending> queued;
+	{
+		std::scoped_lock<std::mutex> lock(m_lock);
+		m_closed = true;
+		active.swap(m_active);
+		queued.swap(m_queued);
+	}
+
+	for (auto& socket : active)
+	{
+		m_reactor.Unregister(socket.get());
+		socket->Close();
+	}
+
+	for (const auto& connection : queued)
+	{
+		closesocket(connection.endpoint);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+ConnectionStatistics ServerSocket::Connections::GetStatistics()
+{
+	std::scoped_lock<std::mutex> lock(m_lock);
+	auto result = m_statistics;
+	result.active = m_active.size();
+	result.queued = m_queued.size();
+	for (const auto& socket : m_active)
+	{
+		result.sends += socket->GetSends();
+		result.replies += socket->GetReplies();
+	}
+	return result;
+}
+
+/////////////////////////////////////////////////////////////////////
+std::shared_ptr<Socket> ServerSocket::Connections::CreateSocket()
+{
+	auto socket = std::make_shared<Socket>(SOCK_STREAM, m_bufferPool, m_workers);
+	socket->SetCloseHandler([connections = weak_from_this()](Socket* closed) {
+		if (auto self = connections.lock())
+		{
+			self->Release(closed);
+		}
+	});
+
+	m_active.push_back(socket);
+	return socket;
+}
+
+/////////////////////////////////////////////////////////////////////
+void ServerSocket::Connections::Start(std::shared_ptr<Socket> socket, const Pending& connection)
+{
+	if (m_timeouts.keepAliveTime.count() > 0)
+	{
+		// Probe the silent peers sooner than the system default of two hours
+		tcp_keepalive keepAlive{};
+		keepAlive.onoff = 1;
+		keepAlive.keepalivetime = static_cast<ULONG>(std::chrono::milliseconds(m_timeouts.keepAliveTime).count());
+		keepAlive.keepaliveinterval = static_cast<ULONG>(std::chrono::milliseconds(m_timeouts.keepAliveInterval).count());
+		DWORD bytes = 0;
+		if (WSAIoctl(connection.endpoint, SIO_KEEPALIVE_VALS, &keepAlive, sizeof(keepAlive), nullptr, 0, &bytes, nullptr, nullptr) == SOCKET_ERROR)
+		{
+			BOOST_LOG_TRIVIAL(warning) << "failed to set up keepalive: " << WSAGetLastError();
+		}
+	}
+
+	sockaddr_in remoteAddr = connection.remoteAddr;
+	socket->Open(connection.endpoint, m_listener, &remoteAddr);
+	m_reactor.Register(std::move(socket));  //receive input data
+}
+
+/////////////////////////////////////////////////////////////////////
+ServerSocket::ServerSocket(const sockaddr_in& endpoint, const ConnectionLimits& limits, const ConnectionTimeouts& timeouts,
+	ISocketListener* listener, SocketReactor& reactor, WorkerPool& workers, BufferPool& bufferPool)
 	: m_closed(false)
 	, m_address(16, ' ')
 	, m_serverSocket(socket(AF_INET, SOCK_STREAM, 0))
-	, m_listener(listener)
+	, m_connections(std::make_shared<Connections>(limits, timeouts, listener, reactor, workers, bufferPool))
 {
 	inet_ntop(AF_INET, &endpoint.sin_addr, m_address.data(), 16);
 	boost::algorithm::trim_right(m_address);
@@ -28,25 +272,35 @@ ServerSocket::ServerSocket(const sockaddr_in& endpoint, int maxClients, ISocketL
 		throw std::runtime_error("failed to create TCP socket");
 	}
 
+	if (0 == limits.soft || limits.hard < limits.soft)
+	{
+		closesocket(m_serverSocket);
+		throw std::runtime_error("invalid connection limits for " + m_address);
+	}
+
+	if (timeouts.keepAliveTime.count() > 0 && 0 == timeouts.keepAliveInterval.count())
+	{
+		closesocket(m_serverSocket);
+		throw std::runtime_error("invalid keepalive interval for " + m_address);
+	}
+
 	if (bind(m_serverSocket, (struct sockaddr*)&endpoint, sizeof(endpoint)) == SOCKET_ERROR)
 	{
 		closesocket(m_serverSocket);
 		throw std::runtime_error("failed to bind TCP socket at " + m_address);
 	}
 
-	if (listen(m_serverSocket, maxClients) == SOCKET_ERROR)
+	if (listen(m_serverSocket, SOMAXCONN) == SOCKET_ERROR)
 	{
 		closesocket(m_serverSocket);
 		throw std::runtime_error("failed to listen TCP socket at " + m_address);
 	}
 
-	m_sockets.reserve(maxClients);
-	for (int i = 0; i < maxClients; i++)
+	m_thread = std::thread(&ServerSocket::Run, this);
+	if (timeouts.idle.count() > 0)
 	{
-		m_sockets.emplace_back(std::make_unique<Socket>(SOCK_STREAM));
+		m_reaper = std::thread(&ServerSocket::Reap, this);
 	}
-
-	m_thread = std::thread(&ServerSocket::Run, this);
 }
 
 /////////////////////////////////////////////////////////////////////
@@ -63,14 +317,23 @@ void ServerSocket::Close(void)
 		return;
 	}
 
-	m_closed = true;
+	{
+		std::scoped_lock<std::mutex> lock(m_reaperLock);
+		m_closed = true;
+	}
+	m_reaperWakeup.notify_all();
 
 	closesocket(m_serverSocket);
 	if (m_thread.joinable())
 	{
 		m_thread.join();
 	}
-	m_sockets.clear();
+	if (m_reaper.joinable())
+	{
+		m_reaper.join();
+	}
+
+	m_connections->Close();
 }
 
 /////////////////////////////////////////////////////////////////////
@@ -80,25 +343,35 @@ const std::string& ServerSocket::GetAddress() const noexcept
 }
 
 /////////////////////////////////////////////////////////////////////
-void ServerSocket::Run()
+ConnectionStatistics ServerSocket::GetStatistics() const
 {
-	struct sockaddr_in remoteAddr {};
-	int size = sizeof(remoteAddr);
+	return m_connections->GetStatistics();
+}
 
+/////////////////////////////////////////////////////////////////////
+void ServerSocket::Run()
+{
 	while (!m_closed)
 	{
+		struct sockaddr_in remoteAddr {};
+		int size = sizeof(remoteAddr);
 		SOCKET endpoint = accept(m_serverSocket, (struct sockaddr*)&remoteAddr, &size);  //accept connection
 
 		if (endpoint != INVALID_SOCKET)
 		{
-			for (auto& socket : m_sockets)
-			{
-				if (!socket->Active()) //find an inactive Socket
-				{
-					socket->Open(endpoint, m_listener, &remoteAddr);  //receive input data
-					break;
-				}
-			}
+			m_connections->Admit(endpoint, remoteAddr);
 		}
 	}
+}
+
+/////////////////////////////////////////////////////////////////////
+void ServerSocket::Reap()
+{
+	std::unique_lock<std::mutex> lock(m_reaperLock);
+	while (!m_reaperWakeup.wait_for(lock, REAP_INTERVAL, [this] { return m_closed; }))
+	{
+		lock.unlock();
+		m_connections->Reap();
+		lock.lock();
+	}
 }
\ No newline at end of file
@@ -8,31 +8,67 @@
 #define ICENFSD_SERVERSOCKET_H
 
 #include "SocketListener.h"
+#include "SocketReactor.h"
 #include "Socket.h"
 #include <winsock.h>
+#include <condition_variable>
 #include <cstdint>
+#include <chrono>
 #include <memory>
 #include <string>
-#include <vector>
 #include <thread>
+#include <mutex>
+
+struct ConnectionLimits
+{
+	size_t soft;  // connections served at once, the next ones wait in the queue
+	size_t hard;  // connections served and queued, the next ones are rejected
+};
+
+struct ConnectionTimeouts
+{
+	std::chrono::seconds idle;              // connections idle for this long are closed, zero keeps them
+	std::chrono::seconds keepAliveTime;     // silence before the first keepalive probe, zero disables them
+	std::chrono::seconds keepAliveInterval; // between the unanswered probes
+};
+
+struct ConnectionStatistics
+{
+	uint64_t accepted;
+	uint64_t rejected;
+	size_t active;
+	size_t queued;
+	uint64_t sends;    // system calls sending the replies
+	uint64_t replies;  // replies sent, the pipelined ones share the sends
+	uint64_t reaped;   // closed for being idle
+	uint64_t reclaimedBytes; // buffer memory released by the reaped connections
+};
 
 class ServerSocket
 {
 public:
-	ServerSocket(const sockaddr_in& endpoint, int maxClients, ISocketListener* listener);
+	ServerSocket(const sockaddr_in& endpoint, const ConnectionLimits& limits, const ConnectionTimeouts& timeouts,
+		ISocketListener* listener, SocketReactor& reactor, WorkerPool& workers, BufferPool& bufferPool);
 	~ServerSocket();
 
 	const std::string& GetAddress() const noexcept;
+	ConnectionStatistics GetStatistics() const;
 	void Close();
 	void Run();
 
 private:
+	class Connections;  // shared with the close handlers of the client sockets
+
 	bool m_closed;
 	std::string m_address;
 	SOCKET m_serverSocket;
-	ISocketListener* m_listener;
 	std::thread m_thread;
-	std::vector<std::unique_ptr<Socket>> m_sockets;
+	std::shared_ptr<Connections> m_connections;
+	std::thread m_reaper;
+	std::mutex m_reaperLock;
+	std::condition_variable m_reaperWakeup;
+
+	void Reap();
 };
 
 #endif // ICENFSD_SERVERSOCKET_H
@@ -9,6 +9,7 @@
 #include <winsock.h>
 #include <iostream>
 #include <fstream>
+#include <thread>
 
 #include <boost/log/utility/setup/common_attributes.hpp>
 #include <boost/log/utility/setup/console.hpp>
@@ -26,11 +27,33 @@ enum class Port : unsigned int
 	Nfs = 2049
 };
 
+constexpr unsigned int DEFAULT_IO_THREADS = 2;
+constexpr unsigned int DEFAULT_SOFT_CONNECTION_LIMIT = 64;
+constexpr unsigned int DEFAULT_HARD_CONNECTION_LIMIT = 256;
+constexpr unsigned int DEFAULT_IDLE_TIMEOUT = 600;
+constexpr unsigned int DEFAULT_KEEPALIVE_TIME = 60;
+constexpr unsigned int DEFAULT_KEEPALIVE_INTERVAL = 10;
+
+/////////////////////////////////////////////////////////////////////
+static unsigned int DefaultWorkerThreads()
+{
+	const unsigned int cores = std::thread::hardware_concurrency();
+	return cores > 0 ? cores : 1;
+}
+
 /////////////////////////////////////////////////////////////////////
 struct SettingsData
 {
 	unsigned int uid = 0;
 	unsigned int gid = 0;
+	unsigned int ioThreads = DEFAULT_IO_THREADS;
+	IoEngine ioEngine = IoEngine::Poll;
+	unsigned int workerThreads = DefaultWorkerThreads();
+	unsigned int softConnectionLimit = DEFAULT_SOFT_CONNECTION_LIMIT;
+	unsigned int hardConnectionLimit = DEFAULT_HARD_CONNECTION_LIMIT;
+	unsigned int idleTimeout = DEFAULT_IDLE_TIMEOUT;
+	unsigned int keepAliveTime = DEFAULT_KEEPALIVE_TIME;
+	unsigned int keepAliveInterval = DEFAULT_KEEPALIVE_INTERVAL;
 	sockaddr_in rpcEndpoint{};
 	sockaddr_in nfsEndpoint{};
 	sockaddr_in mountEndpoint{};
@@ -59,17 +82,39 @@ Exports ParseExportsFile(const std::string& exportsPath)
 		}
 
 		auto path = line.substr(0, delimiter);
-		auto alias = line.substr(delimiter + 1);
+		Export item{ line.substr(delimiter + 1) };
+
+		// options may follow the alias in parentheses: "C:\Media > /media (zerocopy)"
+		const auto options = item.alias.find('(');
+		if (std::string::npos != options)
+		{
+			const auto end = item.alias.find(')', options);
+			if (std::string::npos == end || !boost::algorithm::trim_copy(item.alias.substr(end + 1)).empty())
+			{
+				throw std::runtime_error("Invalid options in exports: " + line);
+			}
+
+			const auto option = boost::algorithm::trim_copy(item.alias.substr(options + 1, end - options - 1));
+			if (option == "zerocopy")
+			{
+				item.zeroCopyRead = true;
+			}
+			else if (!option.empty())
+			{
+				throw std::runtime_error("Unknown export option: " + option);
+			}
+			item.alias.erase(options);
+		}
 
 		// clean path, trim spaces and slashes (except drive letter)
-		boost::algorithm::trim(alias);
+		boost::algorithm::trim(item.alias);
 		boost::algorithm::trim(path);
 		if (path.substr(path.size() - 2) != ":\\")
 		{
 			path.erase(path.find_last_not_of("/\\ ") + 1);
 		}
 
-		result.emplace(path, alias);
+		result.emplace(path, std::move(item));
 	}
 
 	return result;
@@ -99,9 +144,11 @@ Settings::Settings(int argc, char* argv[])
 	: m_data{ std::make_unique<SettingsData>() }
 {
 	bool verboseMode = false;
-	unsigned int uid = 0, gid = 0;
+	unsigned int uid = 0, gid = 0, ioThreads = 0, workerThreads = 0;
+	unsigned int softConnectionLimit = 0, hardConnectionLimit = 0;
+	unsigned int idleTimeout = 0, keepAliveTime = 0, keepAliveInterval = 0;
 	unsigned int nfsPort = 0, rpcPort = 0, mountPort = 0;
-	std::string address, exports;
+	std::string address, exports, ioEngine;
 
 	namespace po = boost::program_options;
 	po::options_description cmdLine("Available options");
@@ -114,6 +161,14 @@ Settings::Settings(int argc, char* argv[])
 		("nfs-port", po::value<unsigned>(&nfsPort)->default_value((unsigned)Port::Nfs), "port for NFS service")
 		("portmap-port", po::value<unsigned>(&rpcPort)->default_value((unsigned)Port::Portmap), "port for Portmap service")
 		("mount-port", po::value<unsigned>(&mountPort)->default_value((unsigned)Port::Mount), "port for Mount service")
+		("io-threads", po::value<unsigned>(&ioThreads)->default_value(DEFAULT_IO_THREADS), "number of threads serving the client sockets")
+		("io-engine", po::value<std::string>(&ioEngine)->default_value("poll"), "how the client sockets are served: poll or iocp")
+		("worker-threads", po::value<unsigned>(&workerThreads)->default_value(DefaultWorkerThreads()), "number of threads executing RPC requests")
+		("soft-connection-limit", po::value<unsigned>(&softConnectionLimit)->default_value(DEFAULT_SOFT_CONNECTION_LIMIT), "TCP connections served at once by each service, the next ones are queued")
+		("hard-connection-limit", po::value<unsigned>(&hardConnectionLimit)->default_value(DEFAULT_HARD_CONNECTION_LIMIT), "TCP connections served and queued by each service, the next ones are rejected")
+		("idle-timeout", po::value<unsigned>(&idleTimeout)->default_value(DEFAULT_IDLE_TIMEOUT), "seconds a TCP connection may stay idle before it is closed, 0 keeps it open")
+		("keepalive-time", po::value<unsigned>(&keepAliveTime)->default_value(DEFAULT_KEEPALIVE_TIME), "seconds of silence before a TCP connection is probed, 0 disables the probes")
+		("keepalive-interval", po::value<unsigned>(&keepAliveInterval)->default_value(DEFAULT_KEEPALIVE_INTERVAL), "seconds between the unanswered keepalive probes")
 		("help,h", "show this message");
 
 	po::variables_map map;
@@ -144,6 +199,33 @@ Settings::Settings(int argc, char* argv[])
 	}
 
 	SetupLogger(verboseMode);
+	if (0 == ioThreads || 0 == workerThreads)
+	{
+		throw std::runtime_error("at least one I/O and one worker thread are required");
+	}
+	m_data->ioThreads = ioThreads;
+	if (ioEngine == "iocp")
+	{
+		m_data->ioEngine = IoEngine::CompletionPort;
+	}
+	else if (ioEngine != "poll")
+	{
+		throw std::runtime_error("unknown I/O engine " + ioEngine);
+	}
+	m_data->workerThreads = workerThreads;
+	if (0 == softConnectionLimit || hardConnectionLimit < softConnectionLimit)
+	{
+		throw std::runtime_error("the hard connection limit must not be less than the soft one, which must not be zero");
+	}
+	m_data->softConnectionLimit = softConnectionLimit;
+	m_data->hardConnectionLimit = hardConnectionLimit;
+	if (keepAliveTime > 0 && 0 == keepAliveInterval)
+	{
+		throw std::runtime_error("the keepalive interval must not be zero");
+	}
+	m_data->idleTimeout = idleTimeout;
+	m_data->keepAliveTime = keepAliveTime;
+	m_data->keepAliveInterval = keepAliveInterval;
 	if (!exports.empty())
 	{
 		m_data->exports = std::move(ParseExportsFile(exports));
@@ -202,4 +284,52 @@ unsigned int Settings::GetUid() const noexcept
 unsigned int Settings::GetGid() const noexcept
 {
 	return m_data->gid;
+}
+
+/////////////////////////////////////////////////////////////////////
+unsigned int Settings::GetIoThreads() const noexcept
+{
+	return m_data->ioThreads;
+}
+
+/////////////////////////////////////////////////////////////////////
+IoEngine Settings::GetIoEngine() const noexcept
+{
+	return m_data->ioEngine;
+}
+
+/////////////////////////////////////////////////////////////////////
+unsigned int Settings::GetWorkerThreads() const noexcept
+{
+	return m_data->workerThreads;
+}
+
+/////////////////////////////////////////////////////////////////////
+unsigned int Settings::GetSoftConnectionLimit() const noexcept
+{
+	return m_data->softConnectionLimit;
+}
+
+/////////////////////////////////////////////////////////////////////
+unsigned int Settings::GetHardConnectionLimit() const noexcept
+{
+	return m_data->hardConnectionLimit;
+}
+
+/////////////////////////////////////////////////////////////////////
+unsigned int Settings::GetIdleTimeout() const noexcept
+{
+	return m_data->idleTimeout;
+}
+
+/////////////////////////////////////////////////////////////////////
+unsigned int Settings::GetKeepAliveTime() const noexcept
+{
+	return m_data->keepAliveTime;
+}
+
+/////////////////////////////////////////////////////////////////////
+unsigned int Settings::GetKeepAliveInterval() const noexcept
+{
+	return m_data->keepAliveInterval;
 }
\ No newline at end of file
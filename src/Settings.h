@@ -14,7 +14,19 @@
 struct sockaddr_in;
 struct SettingsData;
 
-using Exports = std::map<std::string, std::string>;
+struct Export
+{
+	std::string alias;
+	bool zeroCopyRead = false;  // send READ data over TCP with TransmitFile
+};
+
+using Exports = std::map<std::string, Export>;
+
+enum class IoEngine
+{
+	Poll,           // "poll": readiness polling, the default
+	CompletionPort  // "iocp": overlapped receives on an I/O completion port
+};
 
 class Settings
 {
@@ -30,6 +42,14 @@ public:
 	const sockaddr_in& GetMountEndpoint() const noexcept;
 	unsigned int GetUid() const noexcept;
 	unsigned int GetGid() const noexcept;
+	unsigned int GetIoThreads() const noexcept;
+	IoEngine GetIoEngine() const noexcept;
+	unsigned int GetWorkerThreads() const noexcept;
+	unsigned int GetSoftConnectionLimit() const noexcept;
+	unsigned int GetHardConnectionLimit() const noexcept;
+	unsigned int GetIdleTimeout() const noexcept;
+	unsigned int GetKeepAliveTime() const noexcept;
+	unsigned int GetKeepAliveInterval() const noexcept;
 
 private:
 	void SetupLogger(bool verbose) const;
@@ -4,18 +4,53 @@
 /// summary: base class for the network socket
 /////////////////////////////////////////////////////////////////////
 
-#define _WINSOCK_DEPRECATED_NO_WARNINGS
 #include "Socket.h"
+#include "WorkerPool.h"
+#include <mswsock.h>
 #include <boost/log/trivial.hpp>
 
+// Enough for the largest UDP datagram; TCP records may be received in several chunks
+constexpr size_t RECEIVE_BUFFER_SIZE = 64 * 1024;
+// Datagrams received at once, so a busy UDP socket does not starve the others
+constexpr size_t UDP_RECEIVE_BATCH = 32;
+// Reply bytes queued for a TCP connection before it is not read anymore
+constexpr size_t SEND_QUEUE_LIMIT = 4 * 1024 * 1024;
+// Requests of a TCP connection executed or waiting for their replies before it is not read anymore
+constexpr size_t REQUEST_QUEUE_LIMIT = 64;
+
 /////////////////////////////////////////////////////////////////////
-Socket::Socket(int type)
+Socket::Request::Request(Socket& socket, RecordAssembler::Record&& data, const sockaddr_in& remote)
+	: record(std::move(data))
+	, stream(socket.m_bufferPool, socket.m_type == SOCK_STREAM)  // only TCP can send files
+	, remoteAddr(remote)
+{
+	stream.SetInput(record.data(), record.size());
+}
+
+/////////////////////////////////////////////////////////////////////
+Socket::Socket(int type, BufferPool& bufferPool, WorkerPool& workers)
 	: m_type(type)
 	, m_socket(INVALID_SOCKET)
 	, m_listener(nullptr)
+	, m_bufferPool(bufferPool)
+	, m_workers(workers)
 	, m_active(false)
+	, m_sending(false)
+	, m_queuedBytes(0)
+	, m_pendingRequests(0)
+	, m_batchBytes(0)
+	, m_lastActivity(0)
+	, m_sends(0)
+	, m_replyCount(0)
+	, m_receiveBuffer(RECEIVE_BUFFER_SIZE)
+	, m_sourceSize(0)
+	, m_receiveFlags(0)
 {
 	memset(&m_remoteAddr, 0, sizeof(m_remoteAddr));
+	memset(&m_overlapped, 0, sizeof(m_overlapped));
+	memset(&m_sendOverlapped, 0, sizeof(m_sendOverlapped));
+	memset(&m_transmitBuffers, 0, sizeof(m_transmitBuffers));
+	memset(&m_sourceAddr, 0, sizeof(m_sourceAddr));
 }
 
 /////////////////////////////////////////////////////////////////////
@@ -30,6 +65,12 @@ int Socket::GetType() const noexcept
 	return m_type;
 }
 
+/////////////////////////////////////////////////////////////////////
+SOCKET Socket::GetHandle() const noexcept
+{
+	return m_socket;
+}
+
 /////////////////////////////////////////////////////////////////////
 void Socket::Open(SOCKET socket, ISocketListener* listener, struct sockaddr_in* remoteAddr)
 {
@@ -43,138 +84,513 @@ void Socket::Open(SOCKET socket, ISocketListener* listener, struct sockaddr_in*
 		m_remoteAddr = *remoteAddr;
 	}
 
-	if (m_socket != INVALID_SOCKET)
+	m_recordAssembler.Reset();
+	Touch();
+
+	m_active = (m_socket != INVALID_SOCKET);
+}
+
+/////////////////////////////////////////////////////////////////////
+void Socket::Close()
+{
+	// the reactor worker and the owner may close the socket simultaneously
+	const SOCKET socket = m_socket.exchange(INVALID_SOCKET);
+	m_active = false;
+
+	if (socket != INVALID_SOCKET)
 	{
-		m_active = true;
-		m_thread = std::thread(&Socket::Run, this);
+		closesocket(socket);
+		if (m_closeHandler)
+		{
+			m_closeHandler(this);  // only the one who actually closed it gets here
+		}
 	}
 }
 
 /////////////////////////////////////////////////////////////////////
-void Socket::Close()
+void Socket::SetCloseHandler(CloseHandler handler)
+{
+	m_closeHandler = std::move(handler);
+}
+
+/////////////////////////////////////////////////////////////////////
+void Socket::Send(std::vector<std::shared_ptr<Request>>& replies)
+{
+	// Every reply is a datagram of its own. The system drops it if the
+	// socket buffer is full, the client retransmits the request then.
+	std::scoped_lock<std::mutex> lock(m_sendLock);
+	for (const auto& request : replies)
+	{
+		auto& stream = request->stream;
+		// nothing is written for a retransmission whose original is still in progress
+		if (m_socket != INVALID_SOCKET && stream.GetOutputSize() > 0)
+		{
+			stream.GetOutputSegments(m_segments);
+			m_sendBuffers.resize(m_segments.size());
+			for (size_t i = 0; i < m_segments.size(); i++)
+			{
+				m_sendBuffers[i].buf = (char*)m_segments[i].data;
+				m_sendBuffers[i].len = static_cast<ULONG>(m_segments[i].size);
+			}
+
+			DWORD bytesSent = 0;
+			WSASendTo(m_socket, m_sendBuffers.data(), static_cast<DWORD>(m_sendBuffers.size()), &bytesSent, 0,
+				(struct sockaddr*)&request->remoteAddr, sizeof(struct sockaddr), nullptr, nullptr);
+			++m_sends;
+			++m_replyCount;
+		}
+
+		stream.Reset();  // clear output buffer and return it to the pool
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+void Socket::StartSend()
 {
-	if (m_socket != INVALID_SOCKET)
+	// The replies queued while the previous send was in progress go out
+	// together, so a pipelining client gets many of them per system call
+	// and packet. The send is overlapped: the worker does not wait for a
+	// slow client, the completion port reports the end of the send.
+	m_sendBatch.clear();
+	m_sendBuffers.clear();
+	m_batchBytes = 0;
+	m_sending = false;
+
+	while (!m_replies.empty())
 	{
-		closesocket(m_socket);
-		m_socket = INVALID_SOCKET;
+		auto& request = m_replies.front();
+		auto& stream = request->stream;
+		const size_t size = stream.GetOutputSize();
+		// nothing is written for a retransmission whose original is still in progress
+		if (m_socket == INVALID_SOCKET || 0 == size)
+		{
+			stream.Reset();
+			m_queuedBytes -= size;
+			--m_pendingRequests;
+			m_replies.pop_front();
+			continue;
+		}
+
+		SocketStream::FileRange file{};
+		SocketStream::Segment head{}, tail{};
+		if (stream.GetOutputFile(file, head, tail))
+		{
+			if (!m_sendBatch.empty())
+			{
+				break;  // the file goes in a send of its own after the replies gathered so far
+			}
+
+			// Let the system send the file range straight from its cache
+			m_transmitBuffers.Head = (void*)head.data;
+			m_transmitBuffers.HeadLength = static_cast<DWORD>(head.size);
+			m_transmitBuffers.Tail = (void*)tail.data;
+			m_transmitBuffers.TailLength = static_cast<DWORD>(tail.size);
+			memset(&m_sendOverlapped, 0, sizeof(m_sendOverlapped));
+			m_sendOverlapped.Offset = static_cast<DWORD>(file.offset);
+			m_sendOverlapped.OffsetHigh = static_cast<DWORD>(file.offset >> 32);
+
+			m_batchBytes = size;
+			m_sendBatch.push_back(std::move(request));
+			m_replies.pop_front();
+			const bool started = TransmitFile(m_socket, file.file, file.size, 0, &m_sendOverlapped, &m_transmitBuffers, 0)
+				|| WSAGetLastError() == WSA_IO_PENDING;
+			SendStarted(started);
+			return;
+		}
+
+		// The reply may refer to the bulk data (e.g. file contents) in
+		// separate buffers, send them all at once without joining them
+		stream.GetOutputSegments(m_segments);
+		for (const auto& segment : m_segments)
+		{
+			WSABUF buffer{};
+			buffer.buf = (char*)segment.data;
+			buffer.len = static_cast<ULONG>(segment.size);
+			m_sendBuffers.push_back(buffer);
+		}
+
+		m_batchBytes += size;
+		m_sendBatch.push_back(std::move(request));
+		m_replies.pop_front();
 	}
 
-	if (m_thread.joinable())
+	if (!m_sendBatch.empty())
 	{
-		m_thread.join();
+		SendStarted(SendBuffers());
 	}
 }
 
 /////////////////////////////////////////////////////////////////////
-void Socket::Send()
+bool Socket::SendBuffers()
 {
-	if (m_socket == INVALID_SOCKET)
+	memset(&m_sendOverlapped, 0, sizeof(m_sendOverlapped));
+	return WSASend(m_socket, m_sendBuffers.data(), static_cast<DWORD>(m_sendBuffers.size()), nullptr, 0, &m_sendOverlapped, nullptr) == 0
+		|| WSAGetLastError() == WSA_IO_PENDING;
+}
+
+/////////////////////////////////////////////////////////////////////
+void Socket::SendStarted(bool started)
+{
+	if (started)
 	{
+		// the system refers to the socket until the send completes
+		m_sending = true;
+		m_sendOwner = shared_from_this();
 		return;
 	}
 
-	const int outputSize = static_cast<int>(m_socketStream.GetOutputSize());
-	if (m_type == SOCK_STREAM)
+	BOOST_LOG_TRIVIAL(error) << "send failed: " << WSAGetLastError();
+	DropReplies();
+}
+
+/////////////////////////////////////////////////////////////////////
+std::shared_ptr<Socket> Socket::SendCompleted()
+{
+	std::shared_ptr<Socket> owner;  // released by the caller after unlocking, it may be the last reference
+	std::scoped_lock<std::mutex> lock(m_queueLock);
+	owner = std::move(m_sendOwner);
+	m_sending = false;
+
+	DWORD bytes = 0, flags = 0;
+	const SOCKET socket = m_socket;
+	if (socket == INVALID_SOCKET || !WSAGetOverlappedResult(socket, &m_sendOverlapped, &bytes, FALSE, &flags))
 	{
-		send(m_socket, (const char*)m_socketStream.GetOutput(), outputSize, 0);
+		DropReplies();  // the connection is reset or closed, the replies cannot be delivered
+		return owner;
 	}
-	else if (m_type == SOCK_DGRAM)
+
+	// A partial write leaves the rest of the gathered buffers to send
+	size_t sent = bytes;
+	auto buffer = m_sendBuffers.begin();
+	while (m_sendBuffers.end() != buffer && sent >= buffer->len)
 	{
-		sendto(m_socket, (const char*)m_socketStream.GetOutput(), outputSize, 0, (struct sockaddr*)&m_remoteAddr, sizeof(struct sockaddr));
+		sent -= buffer->len;
+		++buffer;
 	}
+	m_sendBuffers.erase(m_sendBuffers.begin(), buffer);
+	if (!m_sendBuffers.empty())
+	{
+		m_sendBuffers.front().buf += sent;
+		m_sendBuffers.front().len -= static_cast<ULONG>(sent);
+		SendStarted(SendBuffers());
+		return owner;
+	}
+
+	Touch();
+	++m_sends;
+	m_replyCount += m_sendBatch.size();
+	for (const auto& request : m_sendBatch)
+	{
+		request->stream.Reset();  // clear output buffer, close the file and return the buffers to the pool
+	}
+	m_queuedBytes -= m_batchBytes;
+	m_pendingRequests -= m_sendBatch.size();
 
-	m_socketStream.Reset();  // clear output buffer
+	StartSend();
+	return owner;
 }
 
 /////////////////////////////////////////////////////////////////////
-bool Socket::Active() const noexcept
+bool Socket::IsSendPending()
 {
-	return m_active;  // thread is active or not
+	std::scoped_lock<std::mutex> lock(m_queueLock);
+	return m_type == SOCK_STREAM && m_sending;
 }
 
 /////////////////////////////////////////////////////////////////////
-char* Socket::GetRemoteAddress() const noexcept
+void Socket::CancelSend()
 {
-	return inet_ntoa(m_remoteAddr.sin_addr);
+	std::scoped_lock<std::mutex> lock(m_queueLock);
+	const SOCKET socket = m_socket;
+	if (m_type == SOCK_STREAM && m_sending && socket != INVALID_SOCKET)
+	{
+		CancelIoEx((HANDLE)socket, &m_sendOverlapped);
+	}
 }
 
 /////////////////////////////////////////////////////////////////////
-int Socket::GetRemotePort() const noexcept
+void Socket::DropReplies()
 {
-	return htons(m_remoteAddr.sin_port);
+	for (const auto& request : m_sendBatch)
+	{
+		request->stream.Reset();
+	}
+	for (const auto& request : m_replies)
+	{
+		request->stream.Reset();
+	}
+
+	m_pendingRequests -= m_sendBatch.size() + m_replies.size();
+	m_sendBatch.clear();
+	m_sendBuffers.clear();
+	m_replies.clear();
+	m_queuedBytes = 0;
+	m_batchBytes = 0;
+	m_sending = false;
+}
+
+/////////////////////////////////////////////////////////////////////
+bool Socket::IsSend(const WSAOVERLAPPED* overlapped) const noexcept
+{
+	return overlapped == &m_sendOverlapped;
 }
 
 /////////////////////////////////////////////////////////////////////
-IInputStream& Socket::GetInputStream() noexcept
+bool Socket::IsBacklogFull() const noexcept
 {
-	return m_socketStream;
+	return m_queuedBytes >= SEND_QUEUE_LIMIT || m_pendingRequests >= REQUEST_QUEUE_LIMIT;
 }
 
 /////////////////////////////////////////////////////////////////////
-IOutputStream& Socket::GetOutputStream() noexcept
+bool Socket::Active() const noexcept
 {
-	return m_socketStream;
+	return m_active;  // connection is open or not
 }
 
 /////////////////////////////////////////////////////////////////////
-void Socket::Run()
+bool Socket::Receive()
 try
 {
-	int size = sizeof(m_remoteAddr);
-	int bytes = 0;
+	if (m_type == SOCK_STREAM)
+	{
+		// When using RPC over TCP the messages are split into records
+		// (see RecordAssembler), so take whatever is available now and
+		// process the records completed by these bytes, if any
+		const int bytes = recv(m_socket, (char*)m_receiveBuffer.data(), static_cast<int>(m_receiveBuffer.size()), 0);
+		if (bytes <= 0)
+		{
+			return false; // connection is closed
+		}
 
-	for (;;)
+		Assemble(bytes);
+	}
+	else if (m_type == SOCK_DGRAM)
 	{
-		if (m_type == SOCK_STREAM)
+		// The socket is non-blocking: take the datagrams queued so far and
+		// spread them over the workers, each one remembers its sender
+		for (size_t i = 0; i < UDP_RECEIVE_BATCH; i++)
 		{
-			// When using tcp we cannot ensure that everything we need is already
-			// received. When using RCP over TCP a fragment header is added to
-			// work around this. The MSB of the fragment header determines if the
-			// fragment is complete (not used here) and the remaining bits define the
-			// length of the rpc call (this is what we want)
-			bytes = recv(m_socket, (char*)m_socketStream.GetInput(), 4, MSG_PEEK);
-
-			// only if at least 4 bytes are availabe (the fragment header) we can continue
-			if (bytes == 4)
+			struct sockaddr_in remoteAddr {};
+			int size = sizeof(remoteAddr);
+			const int bytes = recvfrom(m_socket, (char*)m_receiveBuffer.data(), static_cast<int>(m_receiveBuffer.size()), 0, (struct sockaddr*)&remoteAddr, &size);
+			if (bytes == SOCKET_ERROR)
 			{
-				uint32_t fragmentHeader = 0;
-				m_socketStream.SetInputSize(4);
-				m_socketStream.Read(&fragmentHeader);
-				const int fragmentHeaderLengthBytes = (int)(fragmentHeader ^ 0x80000000) + 4;
-				while (bytes != fragmentHeaderLengthBytes)
+				const int error = WSAGetLastError();
+				if (error == WSAEWOULDBLOCK)
 				{
-					bytes = recv(m_socket, (char*)m_socketStream.GetInput(), fragmentHeaderLengthBytes, MSG_PEEK);
+					break;
 				}
-				bytes = recv(m_socket, (char*)m_socketStream.GetInput(), fragmentHeaderLengthBytes, 0);
+				if (error == WSAECONNRESET || error == WSAEMSGSIZE)
+				{
+					continue;  // an earlier reply was not delivered or the datagram is too big, not fatal for UDP
+				}
+				return false;
 			}
-			else
+
+			if (bytes > 0)
 			{
-				bytes = 0;
+				Post(RecordAssembler::Record(m_receiveBuffer.data(), m_receiveBuffer.data() + bytes), remoteAddr);
 			}
 		}
-		else if (m_type == SOCK_DGRAM)
+	}
+
+	return true;
+}
+catch (const std::exception& e)
+{
+	BOOST_LOG_TRIVIAL(error) << "socket operation failed: " << e.what();
+	return false;
+}
+
+/////////////////////////////////////////////////////////////////////
+bool Socket::ReceiveAsync()
+{
+	// The data lands in the receive buffer without waiting for the readiness
+	// and issuing a separate recv(): one system call per received chunk
+	WSABUF buffer{ static_cast<ULONG>(m_receiveBuffer.size()), (char*)m_receiveBuffer.data() };
+	memset(&m_overlapped, 0, sizeof(m_overlapped));
+	m_receiveFlags = 0;
+
+	int result = SOCKET_ERROR;
+	if (m_type == SOCK_STREAM)
+	{
+		result = WSARecv(m_socket, &buffer, 1, nullptr, &m_receiveFlags, &m_overlapped, nullptr);
+	}
+	else if (m_type == SOCK_DGRAM)
+	{
+		m_sourceSize = sizeof(m_sourceAddr);
+		result = WSARecvFrom(m_socket, &buffer, 1, nullptr, &m_receiveFlags, (struct sockaddr*)&m_sourceAddr, &m_sourceSize, &m_overlapped, nullptr);
+	}
+
+	// the completion is queued to the port even if the data was there already
+	return result == 0 || WSAGetLastError() == WSA_IO_PENDING;
+}
+
+/////////////////////////////////////////////////////////////////////
+bool Socket::ReceiveCompleted(DWORD bytes)
+try
+{
+	DWORD flags = 0;
+	if (m_socket == INVALID_SOCKET)
+	{
+		return false;
+	}
+
+	if (!WSAGetOverlappedResult(m_socket, &m_overlapped, &bytes, FALSE, &flags))
+	{
+		const int error = WSAGetLastError();
+		// an earlier reply was not delivered or the datagram is too big, not fatal for UDP
+		return m_type == SOCK_DGRAM && (error == WSAECONNRESET || error == WSAEMSGSIZE);
+	}
+
+	if (m_type == SOCK_STREAM)
+	{
+		if (0 == bytes)
+		{
+			return false; // connection is closed
+		}
+
+		Assemble(bytes);
+	}
+	else if (m_type == SOCK_DGRAM && bytes > 0)
+	{
+		Post(RecordAssembler::Record(m_receiveBuffer.data(), m_receiveBuffer.data() + bytes), m_sourceAddr);
+	}
+
+	return true;
+}
+catch (const std::exception& e)
+{
+	BOOST_LOG_TRIVIAL(error) << "socket operation failed: " << e.what();
+	return false;
+}
+
+/////////////////////////////////////////////////////////////////////
+void Socket::CancelReceive()
+{
+	const SOCKET socket = m_socket;
+	if (socket != INVALID_SOCKET)
+	{
+		CancelIoEx((HANDLE)socket, &m_overlapped);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+void Socket::Assemble(size_t bytes)
+{
+	Touch();
+
+	// A client pipelines many requests on the connection, execute them
+	// concurrently so a slow one does not hold back the ones behind it.
+	// The replies carry the xid and are sent as the requests complete.
+	m_recordAssembler.Append(m_receiveBuffer.data(), bytes);
+	while (m_recordAssembler.NextRecord(m_record))
+	{
+		Post(std::move(m_record), m_remoteAddr);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+void Socket::Post(RecordAssembler::Record&& data, const sockaddr_in& remoteAddr)
+{
+	if (m_type == SOCK_STREAM)
+	{
+		++m_pendingRequests;  // until its reply is sent, the reads pause when there are too many
+	}
+
+	auto request = std::make_shared<Request>(*this, std::move(data), remoteAddr);
+	m_workers.Post([self = shared_from_this(), request]() {
+		self->Process(request);
+	});
+}
+
+/////////////////////////////////////////////////////////////////////
+void Socket::Process(std::shared_ptr<Request> request)
+{
+	try
+	{
+		if (m_listener != nullptr)
 		{
-			bytes = recvfrom(m_socket, (char*)m_socketStream.GetInput(), static_cast<int>(m_socketStream.GetBufferSize()), 0, (struct sockaddr*)&m_remoteAddr, &size);
+			m_listener->SocketReceived(this, request->remoteAddr, request->stream, request->stream);  // notify listener
 		}
+	}
+	catch (const std::exception& e)
+	{
+		// no reply is sent, but the request is done with and must leave the queue
+		BOOST_LOG_TRIVIAL(error) << "request failed: " << e.what();
+		request->stream.Reset();
+	}
 
-		if (bytes > 0)
+	if (m_type == SOCK_STREAM)
+	{
+		std::scoped_lock<std::mutex> lock(m_queueLock);
+		m_queuedBytes += request->stream.GetOutputSize();
+		m_replies.push_back(std::move(request));
+		if (!m_sending)
 		{
-			m_socketStream.SetInputSize(bytes);  // bytes received
+			StartSend();  // otherwise the send completion picks it up
+		}
+		return;
+	}
 
-			if (m_listener != nullptr)
-			{
-				m_listener->SocketReceived(this);  // notify listener
-			}
+	// The datagrams completed while a worker is sending are sent by it
+	// as well, so the others do not wait for the lock
+	{
+		std::scoped_lock<std::mutex> lock(m_queueLock);
+		m_replies.push_back(std::move(request));
+		if (m_sending)
+		{
+			return;  // the sending worker picks it up
 		}
-		else
+		m_sending = true;
+	}
+
+	std::vector<std::shared_ptr<Request>> replies;
+	while (true)
+	{
 		{
-			break;
+			std::scoped_lock<std::mutex> lock(m_queueLock);
+			if (m_replies.empty())
+			{
+				m_sending = false;
+				return;
+			}
+			replies.assign(std::make_move_iterator(m_replies.begin()), std::make_move_iterator(m_replies.end()));
+			m_replies.clear();
 		}
+
+		Send(replies);  // send response
+		replies.clear();
 	}
+}
 
-	m_active = false;
+/////////////////////////////////////////////////////////////////////
+void Socket::Touch() noexcept
+{
+	m_lastActivity = std::chrono::steady_clock::now().time_since_epoch().count();
 }
-catch (const std::exception& e)
+
+/////////////////////////////////////////////////////////////////////
+std::chrono::steady_clock::duration Socket::GetIdleTime() const noexcept
 {
-	BOOST_LOG_TRIVIAL(error) << "socket operation failed: " << e.what();
+	const std::chrono::steady_clock::time_point lastActivity(std::chrono::steady_clock::duration(m_lastActivity.load()));
+	return std::chrono::steady_clock::now() - lastActivity;
+}
+
+/////////////////////////////////////////////////////////////////////
+size_t Socket::GetBufferedSize() const noexcept
+{
+	return m_receiveBuffer.size() + m_queuedBytes;
+}
+
+/////////////////////////////////////////////////////////////////////
+uint64_t Socket::GetSends() const noexcept
+{
+	return m_sends;
+}
+
+/////////////////////////////////////////////////////////////////////
+uint64_t Socket::GetReplies() const noexcept
+{
+	return m_replyCount;
 }
\ No newline at end of file
@@ -9,34 +9,116 @@
 
 #include "SocketListener.h"
 #include "SocketStream.h"
+#include "RecordAssembler.h"
 #include <winsock2.h>
-#include <thread>
+#include <mswsock.h>
+#include <functional>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <mutex>
 
-class Socket
+class WorkerPool;
+
+class Socket : public std::enable_shared_from_this<Socket>
 {
 public:
-	Socket(int type);
+	using CloseHandler = std::function<void(Socket*)>;
+
+	Socket(int type, BufferPool& bufferPool, WorkerPool& workers);
 	virtual ~Socket();
 
 	int GetType() const noexcept;
+	SOCKET GetHandle() const noexcept;
 	void Open(SOCKET socket, ISocketListener* listener, struct sockaddr_in* remoteAddr = nullptr);
 	void Close();
-	void Send();
+	void SetCloseHandler(CloseHandler handler);
 	bool Active() const noexcept;
-	char* GetRemoteAddress() const noexcept;
-	int GetRemotePort() const noexcept;
-	IInputStream& GetInputStream() noexcept;
-	IOutputStream& GetOutputStream() noexcept;
-	void Run();
+	bool Receive();
+	/// <summary> Start an overlapped receive, its end is reported to the completion port of the socket </summary>
+	/// <returns> False if the receive failed to start </returns>
+	bool ReceiveAsync();
+	/// <summary> Process the data of the overlapped receive which has completed </summary>
+	/// <param name="bytes"> Amount of the received bytes </param>
+	/// <returns> False if the socket is to be closed </returns>
+	bool ReceiveCompleted(DWORD bytes);
+	/// <summary> Abort the overlapped receive, it completes with an error </summary>
+	void CancelReceive();
+	/// <summary> Tell whether the overlapped operation is the send of the replies </summary>
+	/// <param name="overlapped"> Operation reported by the completion port </param>
+	bool IsSend(const WSAOVERLAPPED* overlapped) const noexcept;
+	/// <summary> Send the next replies after the overlapped send has completed </summary>
+	/// <returns> Reference which kept the socket alive during the send, it may be the last one </returns>
+	std::shared_ptr<Socket> SendCompleted();
+	/// <summary> Tell whether an overlapped send is in progress, it keeps the socket alive until it completes </summary>
+	bool IsSendPending();
+	/// <summary> Abort the overlapped send, it completes with an error and the queued replies are dropped </summary>
+	void CancelSend();
+	/// <summary> Check whether the client has too many requests in progress or is too slow to take the replies, it should not be read then </summary>
+	bool IsBacklogFull() const noexcept;
+	/// <summary> Get the time since the last data was received or sent </summary>
+	std::chrono::steady_clock::duration GetIdleTime() const noexcept;
+	/// <summary> Get amount of the buffer memory held by the socket and its pending replies </summary>
+	size_t GetBufferedSize() const noexcept;
+	/// <summary> Get amount of the system calls sending the replies </summary>
+	uint64_t GetSends() const noexcept;
+	/// <summary> Get amount of the replies sent, several of them may go in one send </summary>
+	uint64_t GetReplies() const noexcept;
 
 private:
+	// Request executed by a worker, it may complete out of order
+	struct Request
+	{
+		RecordAssembler::Record record;
+		SocketStream stream;
+		struct sockaddr_in remoteAddr; // where to send the reply to
+
+		Request(Socket& socket, RecordAssembler::Record&& data, const sockaddr_in& remote);
+	};
+
 	int m_type;
-	SOCKET m_socket;
-	struct sockaddr_in m_remoteAddr;
+	std::atomic<SOCKET> m_socket;
+	struct sockaddr_in m_remoteAddr;    // TCP only, the datagrams have their own
 	ISocketListener* m_listener;
-	SocketStream m_socketStream;
-	bool m_active;
-	std::thread m_thread;
+	CloseHandler m_closeHandler;        // called when the open socket gets closed
+	BufferPool& m_bufferPool;
+	WorkerPool& m_workers;
+	std::atomic<bool> m_active;
+	std::mutex m_sendLock;              // replies of the concurrent requests must not interleave
+	std::mutex m_queueLock;
+	std::deque<std::shared_ptr<Request>> m_replies; // completed requests waiting to be sent
+	bool m_sending;                     // TCP: an overlapped send is in progress, UDP: a worker is sending
+	std::atomic<size_t> m_queuedBytes;  // TCP: reply bytes not sent yet
+	std::atomic<size_t> m_pendingRequests; // TCP: requests posted whose replies are not sent yet
+	std::vector<std::shared_ptr<Request>> m_sendBatch; // TCP: replies of the overlapped send
+	size_t m_batchBytes;
+	WSAOVERLAPPED m_sendOverlapped;
+	TRANSMIT_FILE_BUFFERS m_transmitBuffers;
+	std::shared_ptr<Socket> m_sendOwner; // keeps the socket alive until the overlapped send completes
+	std::atomic<std::chrono::steady_clock::rep> m_lastActivity; // TCP only
+	std::atomic<uint64_t> m_sends;
+	std::atomic<uint64_t> m_replyCount;
+	std::vector<unsigned char> m_receiveBuffer;
+	RecordAssembler m_recordAssembler;  // TCP only
+	RecordAssembler::Record m_record;   // record taken from the assembler
+	std::vector<SocketStream::Segment> m_segments;
+	std::vector<WSABUF> m_sendBuffers;
+	WSAOVERLAPPED m_overlapped;         // overlapped receive, one at a time
+	struct sockaddr_in m_sourceAddr;    // sender of the overlapped datagram
+	INT m_sourceSize;
+	DWORD m_receiveFlags;
+
+	void Assemble(size_t bytes);
+	void Touch() noexcept;
+	void Post(RecordAssembler::Record&& data, const sockaddr_in& remoteAddr);
+	void Process(std::shared_ptr<Request> request);
+	void Send(std::vector<std::shared_ptr<Request>>& replies);
+	void StartSend();
+	bool SendBuffers();
+	void SendStarted(bool started);
+	void DropReplies();
 };
 
-#endif // ICENFSD_SOCKET_H
+#endif // ICENFSD_SOCKET_H
\ No newline at end of file
@@ -8,11 +8,14 @@
 #define ICENFSD_SOCKETLISTENER_H
 
 class Socket;
+struct sockaddr_in;
+class IInputStream;
+class IOutputStream;
 
 class ISocketListener
 {
 public:
-    virtual void SocketReceived(Socket *socket) = 0;
+    virtual void SocketReceived(Socket *socket, const sockaddr_in& remoteAddr, IInputStream& inStream, IOutputStream& outStream) = 0;
 };
 
 #endif // ICENFSD_SOCKETLISTENER_H
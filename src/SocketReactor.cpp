@@ -0,0 +1,632 @@
+/////////////////////////////////////////////////////////////////////
+/// file: SocketReactor.cpp
+///
+/// summary: readiness-based multiplexer for the client sockets
+/////////////////////////////////////////////////////////////////////
+
+#include "SocketReactor.h"
+#include "WorkerPool.h"
+#include "Socket.h"
+
+#include <boost/log/trivial.hpp>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+// Completions taken from the port at once
+constexpr ULONG COMPLETION_BATCH = 64;
+// How long to wait for the cancelled receives when stopping
+constexpr DWORD CANCEL_TIMEOUT_MS = 5000;
+// How often the sockets not read because of their backlog are checked
+constexpr int PAUSED_POLL_MS = 50;
+// Sockets remembered for stopping before the closed ones are forgotten
+constexpr size_t ASSOCIATED_PRUNE_SIZE = 256;
+
+/////////////////////////////////////////////////////////////////////
+// WSAPoll cannot be interrupted from another thread, so each I/O thread
+// also polls a loopback UDP socket connected to itself: sending a byte
+// to it wakes the thread up to pick up new or re-armed sockets.
+static SOCKET CreateWakeupSocket()
+{
+	SOCKET result = socket(AF_INET, SOCK_DGRAM, 0);
+	if (INVALID_SOCKET == result)
+	{
+		throw std::runtime_error("failed to create wakeup socket");
+	}
+
+	sockaddr_in loopback{};
+	int size = sizeof(loopback);
+	loopback.sin_family = AF_INET;
+	loopback.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	u_long nonBlocking = 1;
+
+	if (bind(result, (struct sockaddr*)&loopback, sizeof(loopback)) == SOCKET_ERROR
+		|| getsockname(result, (struct sockaddr*)&loopback, &size) == SOCKET_ERROR
+		|| connect(result, (struct sockaddr*)&loopback, sizeof(loopback)) == SOCKET_ERROR
+		|| ioctlsocket(result, FIONBIO, &nonBlocking) == SOCKET_ERROR)
+	{
+		closesocket(result);
+		throw std::runtime_error("failed to setup wakeup socket");
+	}
+
+	return result;
+}
+
+/////////////////////////////////////////////////////////////////////
+SocketReactor::SocketReactor(size_t threadCount, WorkerPool& workers, Engine engine)
+	: m_engine(engine)
+	, m_completionPort(nullptr)
+	, m_associatedLimit(ASSOCIATED_PRUNE_SIZE)
+	, m_paused(0)
+	, m_stopped(false)
+	, m_nextThread(0)
+	, m_workers(workers)
+	, m_dispatched(0)
+{
+	if (0 == threadCount)
+	{
+		throw std::runtime_error("at least one I/O thread is required");
+	}
+
+	// The overlapped sends of the TCP replies complete to the port with either engine
+	const size_t completionThreads = m_engine == Engine::CompletionPort ? threadCount : 1;
+	m_completionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, static_cast<DWORD>(completionThreads));
+	if (nullptr == m_completionPort)
+	{
+		throw std::runtime_error("failed to create I/O completion port");
+	}
+
+	for (size_t i = 0; i < completionThreads; i++)
+	{
+		m_completionThreads.emplace_back(&SocketReactor::RunCompletions, this);
+	}
+
+	if (m_engine == Engine::CompletionPort)
+	{
+		return;
+	}
+
+	m_threads.reserve(threadCount);
+
+	for (size_t i = 0; i < threadCount; i++)
+	{
+		m_threads.emplace_back(std::make_unique<IoThread>());
+		try
+		{
+			m_threads.back()->wakeupSocket = CreateWakeupSocket();
+		}
+		catch (const std::exception&)
+		{
+			for (auto& ioThread : m_threads)
+			{
+				closesocket(ioThread->wakeupSocket);
+			}
+			StopCompletions();
+			throw;
+		}
+	}
+
+	for (auto& ioThread : m_threads)
+	{
+		ioThread->thread = std::thread(&SocketReactor::Run, this, std::ref(*ioThread));
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+SocketReactor::~SocketReactor()
+{
+	Stop();
+}
+
+/////////////////////////////////////////////////////////////////////
+void SocketReactor::Register(std::shared_ptr<Socket> socket)
+{
+	if (m_engine == Engine::CompletionPort)
+	{
+		// The socket is kept until its receive ends, the system writes into it
+		std::shared_ptr<Socket> failed;
+		{
+			const Socket* key = socket.get();
+			std::scoped_lock<std::mutex> lock(m_completionLock);
+			if (nullptr == CreateIoCompletionPort((HANDLE)socket->GetHandle(), m_completionPort, reinterpret_cast<ULONG_PTR>(key), 0)
+				|| !socket->ReceiveAsync())
+			{
+				BOOST_LOG_TRIVIAL(error) << "failed to start receiving: " << WSAGetLastError();
+				failed = std::move(socket);
+			}
+			else
+			{
+				Associate(socket);
+				m_completions[key] = { std::move(socket), true, false };
+			}
+		}
+
+		if (failed)
+		{
+			failed->Close();
+		}
+		return;
+	}
+
+	if (nullptr == CreateIoCompletionPort((HANDLE)socket->GetHandle(), m_completionPort, reinterpret_cast<ULONG_PTR>(socket.get()), 0))
+	{
+		BOOST_LOG_TRIVIAL(error) << "failed to associate socket with the completion port: " << GetLastError();
+		socket->Close();
+		return;
+	}
+	{
+		std::scoped_lock<std::mutex> lock(m_completionLock);
+		Associate(socket);
+	}
+
+	// Spread the sockets over the I/O threads in round-robin manner
+	auto& ioThread = *m_threads[m_nextThread++ % m_threads.size()];
+	{
+		std::scoped_lock<std::mutex> lock(ioThread.lock);
+		ioThread.entries.push_back({ std::move(socket), true });
+	}
+	Wakeup(ioThread);
+}
+
+/////////////////////////////////////////////////////////////////////
+void SocketReactor::Unregister(const Socket* socket)
+{
+	if (m_engine == Engine::CompletionPort)
+	{
+		std::scoped_lock<std::mutex> lock(m_completionLock);
+		const auto it = m_completions.find(socket);
+		if (m_completions.end() != it && it->second.paused)
+		{
+			m_completions.erase(it);  // no receive is pending
+			--m_paused;
+		}
+		else if (m_completions.end() != it)
+		{
+			it->second.registered = false;
+			it->second.socket->CancelReceive();  // forgotten when the aborted receive completes
+		}
+		return;
+	}
+
+	for (auto& ioThread : m_threads)
+	{
+		std::scoped_lock<std::mutex> lock(ioThread->lock);
+		auto& entries = ioThread->entries;
+		const auto it = std::find_if(entries.begin(), entries.end(),
+			[socket](const Entry& entry) { return entry.socket.get() == socket; });
+		if (entries.end() != it)
+		{
+			entries.erase(it);
+			return;
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+void SocketReactor::Stop()
+{
+	if (m_stopped.exchange(true))
+	{
+		return;
+	}
+
+	if (m_engine == Engine::CompletionPort)
+	{
+		StopCompletions();
+		return;
+	}
+
+	for (auto& ioThread : m_threads)
+	{
+		Wakeup(*ioThread);
+		if (ioThread->thread.joinable())
+		{
+			ioThread->thread.join();
+		}
+	}
+
+	// The workers refer to the I/O threads, wait for them to finish
+	{
+		std::unique_lock<std::mutex> lock(m_dispatchLock);
+		m_dispatchDone.wait(lock, [this] { return 0 == m_dispatched; });
+	}
+
+	for (auto& ioThread : m_threads)
+	{
+		closesocket(ioThread->wakeupSocket);
+		ioThread->entries.clear();
+	}
+
+	StopCompletions();
+}
+
+/////////////////////////////////////////////////////////////////////
+void SocketReactor::Wakeup(IoThread& ioThread)
+{
+	const char signal = 0;
+	send(ioThread.wakeupSocket, &signal, sizeof(signal), 0);
+}
+
+/////////////////////////////////////////////////////////////////////
+void SocketReactor::Run(IoThread& ioThread)
+{
+	std::vector<std::shared_ptr<Socket>> polled;
+	std::vector<WSAPOLLFD> fds;
+
+	while (!m_stopped)
+	{
+		// the wakeup socket always goes first
+		polled.clear();
+		fds.clear();
+		fds.push_back({ ioThread.wakeupSocket, POLLRDNORM, 0 });
+		bool paused = false;
+		{
+			std::scoped_lock<std::mutex> lock(ioThread.lock);
+			for (const auto& entry : ioThread.entries)
+			{
+				if (entry.armed && entry.socket->IsBacklogFull())
+				{
+					paused = true;  // the client has too many requests in progress or does not take its replies, do not read more
+				}
+				else if (entry.armed)
+				{
+					polled.push_back(entry.socket);
+					fds.push_back({ entry.socket->GetHandle(), POLLRDNORM, 0 });
+				}
+			}
+		}
+
+		const int ready = WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), paused ? PAUSED_POLL_MS : -1);
+		if (SOCKET_ERROR == ready)
+		{
+			BOOST_LOG_TRIVIAL(error) << "WSAPoll failed: " << WSAGetLastError();
+			continue;
+		}
+
+		if (fds[0].revents != 0)
+		{
+			char drain[16];
+			while (recv(ioThread.wakeupSocket, drain, sizeof(drain), 0) > 0);
+		}
+
+		for (size_t i = 1; i < fds.size(); i++)
+		{
+			if (0 == fds[i].revents)
+			{
+				continue;
+			}
+
+			const auto& socket = polled[i - 1];
+			std::scoped_lock<std::mutex> lock(ioThread.lock);
+			auto& entries = ioThread.entries;
+			const auto it = std::find_if(entries.begin(), entries.end(),
+				[&socket](const Entry& entry) { return entry.socket == socket; });
+			if (entries.end() == it)
+			{
+				continue; // unregistered while we were polling
+			}
+
+			if ((fds[i].revents & (POLLERR | POLLNVAL)) != 0)
+			{
+				entries.erase(it);
+				socket->Close();
+				continue;
+			}
+
+			// Do not poll the socket until the worker is done receiving,
+			// so two workers never read from the same socket at once
+			it->armed = false;
+			Dispatch(ioThread, socket);
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+void SocketReactor::Dispatch(IoThread& ioThread, std::shared_ptr<Socket> socket)
+{
+	{
+		std::scoped_lock<std::mutex> lock(m_dispatchLock);
+		++m_dispatched;
+	}
+
+	m_workers.Post([this, &ioThread, socket]() {
+		// POLLHUP is reported together with the pending data, so let
+		// Receive() drain it and detect the end of stream by itself
+		const bool keep = socket->Receive();
+		{
+			std::scoped_lock<std::mutex> lock(ioThread.lock);
+			auto& entries = ioThread.entries;
+			const auto it = std::find_if(entries.begin(), entries.end(),
+				[&socket](const Entry& entry) { return entry.socket == socket; });
+			if (entries.end() != it)
+			{
+				if (keep)
+				{
+					it->armed = true;
+				}
+				else
+				{
+					entries.erase(it);
+				}
+			}
+		}
+
+		if (keep)
+		{
+			Wakeup(ioThread);
+		}
+		else
+		{
+			socket->Close();
+		}
+
+		std::scoped_lock<std::mutex> lock(m_dispatchLock);
+		if (0 == --m_dispatched)
+		{
+			m_dispatchDone.notify_all();
+		}
+	});
+}
+
+/////////////////////////////////////////////////////////////////////
+void SocketReactor::RunCompletions()
+{
+	std::vector<OVERLAPPED_ENTRY> entries(COMPLETION_BATCH);
+	auto checked = std::chrono::steady_clock::now();
+
+	while (true)
+	{
+		// The paused sockets are resumed as their replies are sent. A request
+		// may also end without a reply, so check them now and then too.
+		const bool paused = m_paused > 0;
+		ULONG count = 0;
+		if (!GetQueuedCompletionStatusEx(m_completionPort, entries.data(), COMPLETION_BATCH, &count, paused ? static_cast<DWORD>(PAUSED_POLL_MS) : INFINITE, FALSE))
+		{
+			if (GetLastError() != WAIT_TIMEOUT)
+			{
+				BOOST_LOG_TRIVIAL(error) << "GetQueuedCompletionStatusEx failed: " << GetLastError();
+				continue;
+			}
+			count = 0;
+		}
+
+		for (ULONG i = 0; i < count; i++)
+		{
+			if (nullptr == entries[i].lpOverlapped)
+			{
+				// Stop() posts a single empty completion, pass it on to the next thread
+				PostQueuedCompletionStatus(m_completionPort, 0, 0, nullptr);
+				return;
+			}
+
+			Complete(reinterpret_cast<Socket*>(entries[i].lpCompletionKey), entries[i].lpOverlapped, entries[i].dwNumberOfBytesTransferred);
+		}
+
+		const auto now = std::chrono::steady_clock::now();
+		if (paused && now - checked >= std::chrono::milliseconds(PAUSED_POLL_MS))
+		{
+			checked = now;
+			ResumePaused();
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+void SocketReactor::Complete(Socket* key, const OVERLAPPED* overlapped, DWORD bytes)
+{
+	if (key->IsSend(overlapped))
+	{
+		// the pending send keeps the socket alive until here, keep it until resumed
+		const std::shared_ptr<Socket> socket = key->SendCompleted();
+		if (m_engine == Engine::CompletionPort && socket)
+		{
+			Resume(socket);
+		}
+		return;
+	}
+
+	std::shared_ptr<Socket> socket;
+	{
+		std::scoped_lock<std::mutex> lock(m_completionLock);
+		const auto it = m_completions.find(key);
+		if (m_completions.end() == it)
+		{
+			return;
+		}
+		if (!it->second.registered)
+		{
+			m_completions.erase(it);  // the receive was cancelled by Unregister()
+			return;
+		}
+		socket = it->second.socket;
+	}
+
+	// Only splits the data into requests and posts them to the workers
+	bool keep = socket->ReceiveCompleted(bytes);
+	{
+		std::scoped_lock<std::mutex> lock(m_completionLock);
+		const auto it = m_completions.find(key);
+		if (m_completions.end() == it)
+		{
+			return;
+		}
+
+		const bool registered = it->second.registered;
+		if (keep && registered && socket->IsBacklogFull())
+		{
+			it->second.paused = true;  // too many requests in progress or replies not taken, resumed when they are sent
+			++m_paused;
+			return;
+		}
+
+		keep = keep && registered && socket->ReceiveAsync();
+		if (keep)
+		{
+			return;
+		}
+
+		m_completions.erase(it);
+		if (!registered)
+		{
+			return;  // unregistered meanwhile, the owner closes the socket
+		}
+	}
+
+	socket->Close();
+}
+
+/////////////////////////////////////////////////////////////////////
+void SocketReactor::Resume(const std::shared_ptr<Socket>& socket)
+{
+	std::shared_ptr<Socket> failed;
+	{
+		std::scoped_lock<std::mutex> lock(m_completionLock);
+		const auto it = m_completions.find(socket.get());
+		if (m_completions.end() == it || !it->second.registered || !it->second.paused
+			|| it->second.socket->IsBacklogFull())
+		{
+			return;
+		}
+
+		it->second.paused = false;
+		--m_paused;
+		if (it->second.socket->ReceiveAsync())
+		{
+			return;
+		}
+
+		failed = std::move(it->second.socket);
+		m_completions.erase(it);
+	}
+
+	failed->Close();
+}
+
+/////////////////////////////////////////////////////////////////////
+void SocketReactor::ResumePaused()
+{
+	std::vector<std::shared_ptr<Socket>> paused;
+	{
+		std::scoped_lock<std::mutex> lock(m_completionLock);
+		for (const auto& completion : m_completions)
+		{
+			if (completion.second.paused)
+			{
+				paused.push_back(completion.second.socket);
+			}
+		}
+	}
+
+	for (const auto& socket : paused)
+	{
+		Resume(socket);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+void SocketReactor::Associate(const std::shared_ptr<Socket>& socket)
+{
+	// Called with the completion lock held
+	if (m_associated.size() >= m_associatedLimit)
+	{
+		m_associated.erase(std::remove_if(m_associated.begin(), m_associated.end(),
+			[](const std::weak_ptr<Socket>& associated) { return associated.expired(); }), m_associated.end());
+		m_associatedLimit = std::max(ASSOCIATED_PRUNE_SIZE, m_associated.size() * 2);
+	}
+	m_associated.push_back(socket);
+}
+
+/////////////////////////////////////////////////////////////////////
+void SocketReactor::StopCompletions()
+{
+	PostQueuedCompletionStatus(m_completionPort, 0, 0, nullptr);
+	for (auto& thread : m_completionThreads)
+	{
+		if (thread.joinable())
+		{
+			thread.join();
+		}
+	}
+
+	// The system writes into the sockets until their receives end, and
+	// the sockets refer to themselves until their sends end
+	std::vector<std::weak_ptr<Socket>> associated;
+	{
+		std::scoped_lock<std::mutex> lock(m_completionLock);
+		for (auto it = m_completions.begin(); m_completions.end() != it;)
+		{
+			if (it->second.paused)
+			{
+				it = m_completions.erase(it);  // no receive is pending
+				--m_paused;
+				continue;
+			}
+
+			it->second.registered = false;
+			it->second.socket->CancelReceive();
+			++it;
+		}
+
+		associated.swap(m_associated);
+	}
+
+	std::vector<std::shared_ptr<Socket>> sending;
+	for (const auto& weak : associated)
+	{
+		auto socket = weak.lock();
+		if (socket && socket->IsSendPending())
+		{
+			sending.push_back(std::move(socket));
+		}
+	}
+
+	std::vector<OVERLAPPED_ENTRY> entries(COMPLETION_BATCH);
+	while (true)
+	{
+		size_t receives = 0, sends = 0;
+		{
+			std::scoped_lock<std::mutex> lock(m_completionLock);
+			receives = m_completions.size();
+		}
+		for (const auto& socket : sending)
+		{
+			if (socket->IsSendPending())
+			{
+				socket->CancelSend();  // again if the completed send has started the next one
+				++sends;
+			}
+		}
+		if (0 == receives && 0 == sends)
+		{
+			break;
+		}
+
+		ULONG count = 0;
+		if (!GetQueuedCompletionStatusEx(m_completionPort, entries.data(), COMPLETION_BATCH, &count, CANCEL_TIMEOUT_MS, FALSE))
+		{
+			BOOST_LOG_TRIVIAL(warning) << receives << " receives and " << sends << " sends were not cancelled in time";
+			break;
+		}
+
+		for (ULONG i = 0; i < count; i++)
+		{
+			Socket* key = reinterpret_cast<Socket*>(entries[i].lpCompletionKey);
+			if (entries[i].lpOverlapped == nullptr)
+			{
+				continue;
+			}
+			if (key->IsSend(entries[i].lpOverlapped))
+			{
+				key->SendCompleted();  // drops the replies of the aborted send and releases the socket
+				continue;
+			}
+
+			std::scoped_lock<std::mutex> lock(m_completionLock);
+			m_completions.erase(key);
+		}
+	}
+
+	m_completions.clear();
+	CloseHandle(m_completionPort);
+	m_completionPort = nullptr;
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+/////////////////////////////////////////////////////////////////////
+/// file: SocketReactor.h
+///
+/// summary: readiness-based multiplexer for the client sockets
+/////////////////////////////////////////////////////////////////////
+
+#ifndef ICENFSD_SOCKETREACTOR_H
+#define ICENFSD_SOCKETREACTOR_H
+
+#include <winsock2.h>
+#include <condition_variable>
+#include <unordered_map>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <mutex>
+
+class Socket;
+class WorkerPool;
+
+class SocketReactor
+{
+public:
+	enum class Engine
+	{
+		Poll,           // WSAPoll tells the ready sockets, the workers receive from them
+		CompletionPort  // overlapped receives, the I/O threads take their completions in batches
+	};
+
+	SocketReactor(size_t threadCount, WorkerPool& workers, Engine engine = Engine::Poll);
+	~SocketReactor();
+
+	/// <summary> Start watching the opened socket for incoming data </summary>
+	/// <param name="socket"> Socket to watch, the reactor shares its ownership </param>
+	void Register(std::shared_ptr<Socket> socket);
+	/// <summary> Stop watching the socket. A receive already running on a worker is not interrupted </summary>
+	/// <param name="socket"> Socket to forget about </param>
+	void Unregister(const Socket* socket);
+	/// <summary> Stop the I/O threads and release all the registered sockets </summary>
+	void Stop();
+
+private:
+	struct Entry
+	{
+		std::shared_ptr<Socket> socket;
+		bool armed = true; // false while a worker is receiving from the socket
+	};
+
+	struct IoThread
+	{
+		std::mutex lock;
+		std::vector<Entry> entries;
+		SOCKET wakeupSocket = INVALID_SOCKET;
+		std::thread thread;
+	};
+
+	struct Completion
+	{
+		std::shared_ptr<Socket> socket;
+		bool registered = true; // false once unregistered, forgotten when its receive ends
+		bool paused = false;    // no receive is pending until the backlog of the socket goes down
+	};
+
+	const Engine m_engine;
+	HANDLE m_completionPort;
+	std::mutex m_completionLock;
+	std::unordered_map<const Socket*, Completion> m_completions; // sockets with a receive pending
+	std::vector<std::weak_ptr<Socket>> m_associated; // sockets whose sends complete to the port, for stopping
+	size_t m_associatedLimit; // the expired ones are forgotten when there are more
+	std::atomic<size_t> m_paused; // completions with no receive pending, checked now and then
+	std::vector<std::thread> m_completionThreads;
+	std::atomic<bool> m_stopped;
+	std::atomic<size_t> m_nextThread;
+	std::vector<std::unique_ptr<IoThread>> m_threads;
+	WorkerPool& m_workers;
+	std::mutex m_dispatchLock;
+	std::condition_variable m_dispatchDone;
+	size_t m_dispatched; // receives posted to the workers and not finished yet
+
+	void Run(IoThread& ioThread);
+	void Dispatch(IoThread& ioThread, std::shared_ptr<Socket> socket);
+	void Wakeup(IoThread& ioThread);
+	void RunCompletions();
+	void Complete(Socket* key, const OVERLAPPED* overlapped, DWORD bytes);
+	void Resume(const std::shared_ptr<Socket>& socket);
+	void ResumePaused();
+	void Associate(const std::shared_ptr<Socket>& socket);
+	void StopCompletions();
+};
+
+#endif // ICENFSD_SOCKETREACTOR_H
\ No newline at end of file
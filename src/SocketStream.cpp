@@ -5,16 +5,22 @@
 /////////////////////////////////////////////////////////////////////
 
 #include "SocketStream.h"
+#include "Xdr.h"
+#include <windows.h>
 #include <sys/types.h>
+#include <stdexcept>
 #include <cstring>
 #include <cstdio>
 
-#define MAXDATA (1024 * 1024)
-
 /////////////////////////////////////////////////////////////////////
-SocketStream::SocketStream()
-	: m_inBuffer(new unsigned char[MAXDATA])
-	, m_outBuffer(new unsigned char[MAXDATA])
+SocketStream::SocketStream(BufferPool& bufferPool, bool fileAttachments)
+	: m_bufferPool(bufferPool)
+	, m_inBuffer(nullptr)
+	, m_outBuffer{}
+	, m_pending{}
+	, m_attachedSize(0)
+	, m_fileAttachments(fileAttachments)
+	, m_file{}
 	, m_inBufferSize(0)
 	, m_outBufferSize(0)
 	, m_inBufferIndex(0)
@@ -24,19 +30,14 @@ SocketStream::SocketStream()
 /////////////////////////////////////////////////////////////////////
 SocketStream::~SocketStream()
 {
-	delete[] m_inBuffer;
-	delete[] m_outBuffer;
-}
-
-/////////////////////////////////////////////////////////////////////
-unsigned char* SocketStream::GetInput() noexcept
-{
-	return m_inBuffer;
+	m_bufferPool.Release(m_outBuffer);
+	ReleaseAttachments();
 }
 
 /////////////////////////////////////////////////////////////////////
-void SocketStream::SetInputSize(size_t size)
+void SocketStream::SetInput(const unsigned char* data, size_t size) noexcept
 {
+	m_inBuffer = data;
 	m_inBufferIndex = 0;  //seek to the beginning of the input buffer
 	m_inBufferSize = size;
 }
@@ -44,19 +45,52 @@ void SocketStream::SetInputSize(size_t size)
 /////////////////////////////////////////////////////////////////////
 unsigned char* SocketStream::GetOutput() noexcept
 {
-	return m_outBuffer;  //output buffer
+	return m_outBuffer.data;  //output buffer
 }
 
 /////////////////////////////////////////////////////////////////////
 size_t SocketStream::GetOutputSize() const noexcept
 {
-	return m_outBufferSize;  //number of bytes of data in the output buffer
+	return m_outBufferSize + m_attachedSize;  //number of bytes of data to send
 }
 
 /////////////////////////////////////////////////////////////////////
-size_t SocketStream::GetBufferSize() const noexcept
+void SocketStream::GetOutputSegments(std::vector<Segment>& segments) const
 {
-	return MAXDATA;  //size of input/output buffer
+	segments.clear();
+
+	size_t offset = 0;
+	for (const auto& attachment : m_attachments)
+	{
+		if (attachment.offset > offset)
+		{
+			segments.push_back({ m_outBuffer.data + offset, attachment.offset - offset });
+			offset = attachment.offset;
+		}
+		segments.push_back({ attachment.buffer.data, attachment.size });
+	}
+
+	if (m_outBufferSize > offset)
+	{
+		segments.push_back({ m_outBuffer.data + offset, m_outBufferSize - offset });
+	}
+}
+
+
+/////////////////////////////////////////////////////////////////////
+bool SocketStream::GetOutputFile(FileRange& range, Segment& head, Segment& tail) const
+{
+	if (nullptr == m_file.file)
+	{
+		return false;
+	}
+
+	// the file range is the only attachment then
+	const size_t offset = m_attachments.front().offset;
+	range = m_file;
+	head = { m_outBuffer.data, offset };
+	tail = { m_outBuffer.data + offset, m_outBufferSize - offset };
+	return true;
 }
 
 /////////////////////////////////////////////////////////////////////
@@ -76,12 +110,18 @@ size_t SocketStream::Read(void* data, size_t size)
 size_t SocketStream::Read(uint32_t* value)
 {
 	constexpr size_t bufferLength = sizeof(uint32_t);
-	unsigned char buffer[bufferLength];
+	if (GetSize() >= bufferLength)
+	{
+		XdrDecode(m_inBuffer + m_inBufferIndex, *value);
+		m_inBufferIndex += static_cast<off_t>(bufferLength);
+		return bufferLength;
+	}
 
+	unsigned char buffer[bufferLength];
 	unsigned char* p = reinterpret_cast<unsigned char*>(value);
 	const auto n = Read(buffer, bufferLength);
 
-	for (auto i = 0; i < n; i++) // reverse byte order
+	for (size_t i = 0; i < n; i++) // truncated input, reverse byte order of what is there
 	{
 		p[bufferLength - 1 - i] = buffer[i];
 	}
@@ -93,18 +133,38 @@ size_t SocketStream::Read(uint32_t* value)
 size_t SocketStream::Read8(uint64_t* value)
 {
 	constexpr size_t bufferLength = sizeof(uint64_t);
-	unsigned char buffer[bufferLength];
+	if (GetSize() >= bufferLength)
+	{
+		XdrDecode(m_inBuffer + m_inBufferIndex, *value);
+		m_inBufferIndex += static_cast<off_t>(bufferLength);
+		return bufferLength;
+	}
 
+	unsigned char buffer[bufferLength];
 	unsigned char* p = (unsigned char*)value;
 	const auto n = Read(buffer, bufferLength);
 
-	for (auto i = 0; i < n; i++) { //reverse byte order
+	for (size_t i = 0; i < n; i++) { //reverse byte order
 		p[bufferLength - 1 - i] = buffer[i];
 	}
 
 	return n;
 }
 
+/////////////////////////////////////////////////////////////////////
+size_t SocketStream::ReadWords(uint32_t* values, size_t count)
+{
+	const size_t available = GetSize() / sizeof(uint32_t);
+	if (count > available) //only the whole words are read
+	{
+		count = available;
+	}
+
+	XdrDecodeWords(m_inBuffer + m_inBufferIndex, values, count);
+	m_inBufferIndex += static_cast<off_t>(count * sizeof(uint32_t));
+	return count;
+}
+
 /////////////////////////////////////////////////////////////////////
 size_t SocketStream::Skip(size_t size)
 {
@@ -123,74 +183,165 @@ size_t SocketStream::GetSize() const noexcept
 	return m_inBufferSize - m_inBufferIndex;  //number of bytes of rest data in the input buffer
 }
 
+/////////////////////////////////////////////////////////////////////
+const unsigned char* SocketStream::GetData() const noexcept
+{
+	return m_inBuffer + m_inBufferIndex;
+}
+
 /////////////////////////////////////////////////////////////////////
 void SocketStream::Write(const void* data, size_t size)
 {
-	if (m_outBufferIndex + size > MAXDATA) //over the size of output buffer
+	memcpy(Extend(size), data, size);
+}
+
+/////////////////////////////////////////////////////////////////////
+void SocketStream::Write(uint32_t value)
+{
+	XdrEncode(Extend(sizeof(value)), value);  //stored in place in the network byte order
+}
+
+/////////////////////////////////////////////////////////////////////
+void SocketStream::Write8(uint64_t value)
+{
+	XdrEncode(Extend(sizeof(value)), value);
+}
+
+/////////////////////////////////////////////////////////////////////
+void SocketStream::WriteWords(const uint32_t* values, size_t count)
+{
+	XdrEncodeWords(Extend(count * sizeof(uint32_t)), values, count);
+}
+
+/////////////////////////////////////////////////////////////////////
+void SocketStream::Seek(off_t offset, int from)
+{
+	off_t position = offset;
+	if (from == SEEK_CUR)
 	{
-		size = MAXDATA - m_outBufferIndex;
+		position += static_cast<off_t>(GetPosition());
+	}
+	else if (from == SEEK_END)
+	{
+		position += static_cast<off_t>(GetOutputSize());
+	}
+	else if (from != SEEK_SET)
+	{
+		return;
 	}
 
-	memcpy(m_outBuffer + m_outBufferIndex, data, size);
-	m_outBufferIndex += static_cast<off_t>(size);
-
-	if (m_outBufferIndex > m_outBufferSize)
+	// The position counts the attached segments, but only the bytes
+	// of the output buffer may be overwritten
+	size_t attached = 0;
+	for (const auto& attachment : m_attachments)
 	{
-		m_outBufferSize = m_outBufferIndex;
+		const size_t start = attachment.offset + attached;
+		if (static_cast<size_t>(position) < start)
+		{
+			break;
+		}
+		if (static_cast<size_t>(position) < start + attachment.size)
+		{
+			throw std::runtime_error("cannot seek into the attached segment");
+		}
+		attached += attachment.size;
 	}
+
+	m_outBufferIndex = position - static_cast<off_t>(attached);
 }
 
 /////////////////////////////////////////////////////////////////////
-void SocketStream::Write(uint32_t value)
+size_t SocketStream::GetPosition() const noexcept
 {
-	constexpr int32_t bufferLength = sizeof(uint32_t);
-	unsigned char buffer[bufferLength];
-	unsigned char* p = (unsigned char*)&value;
-
-	for (int32_t i = bufferLength - 1; i >= 0; i--) //reverse byte order
+	size_t position = m_outBufferIndex;
+	for (const auto& attachment : m_attachments)
 	{
-		buffer[i] = p[bufferLength - 1 - i];
+		if (attachment.offset > static_cast<size_t>(m_outBufferIndex))
+		{
+			break;
+		}
+		position += attachment.size;
 	}
 
-	Write(buffer, bufferLength);
+	return position;
 }
 
 /////////////////////////////////////////////////////////////////////
-void SocketStream::Write8(uint64_t value)
+unsigned char* SocketStream::GetWindow(size_t size, size_t& capacity)
 {
-	constexpr int32_t bufferLength = sizeof(uint64_t);
-	unsigned char buffer[bufferLength];
-	unsigned char* p = (unsigned char*)&value;
+	ReserveOutput(m_outBufferIndex + size);
+	capacity = m_outBuffer.capacity - m_outBufferIndex;
+	return m_outBuffer.data + m_outBufferIndex;
+}
 
-	for (int32_t i = bufferLength - 1; i >= 0; i--) //reverse byte order
+/////////////////////////////////////////////////////////////////////
+void SocketStream::Advance(size_t size)
+{
+	m_outBufferIndex += static_cast<off_t>(size);
+
+	if (m_outBufferIndex > m_outBufferSize)
 	{
-		buffer[i] = p[bufferLength - 1 - i];
+		m_outBufferSize = m_outBufferIndex;
 	}
+}
 
-	Write(buffer, bufferLength);
+/////////////////////////////////////////////////////////////////////
+unsigned char* SocketStream::AcquireSegment(size_t size)
+{
+	m_bufferPool.Release(m_pending);
+	m_pending = m_bufferPool.Acquire(size);
+	return m_pending.data;
 }
 
 /////////////////////////////////////////////////////////////////////
-void SocketStream::Seek(off_t offset, int from)
+void SocketStream::CommitSegment(size_t size)
 {
-	if (from == SEEK_SET)
+	if (size > m_pending.capacity)
 	{
-		m_outBufferIndex = offset;
+		throw std::runtime_error("segment size exceeds the acquired buffer");
 	}
-	else if (from == SEEK_CUR)
+	if (size > 0 && m_file.file != nullptr)
 	{
-		m_outBufferIndex += offset;
+		throw std::runtime_error("segments cannot be sent along with a file");
 	}
-	else if (from == SEEK_END)
+
+	if (size == 0)
+	{
+		m_bufferPool.Release(m_pending);
+	}
+	else
 	{
-		m_outBufferIndex = static_cast<off_t>(m_outBufferSize) + offset;
+		// keep the buffer until the stream is sent
+		m_attachments.push_back({ static_cast<size_t>(m_outBufferIndex), m_pending, size });
+		m_attachedSize += size;
 	}
+	m_pending = BufferPool::Buffer{};
 }
 
 /////////////////////////////////////////////////////////////////////
-size_t SocketStream::GetPosition() const noexcept
+bool SocketStream::CanAttachFile() const noexcept
 {
-	return m_outBufferIndex;
+	return m_fileAttachments;
+}
+
+/////////////////////////////////////////////////////////////////////
+void SocketStream::AttachFile(void* file, uint64_t offset, uint32_t size)
+{
+	if (!m_fileAttachments || m_file.file != nullptr || !m_attachments.empty())
+	{
+		CloseHandle(file);
+		throw std::runtime_error("cannot attach the file to the stream");
+	}
+
+	if (size == 0)
+	{
+		CloseHandle(file);  // nothing to send
+		return;
+	}
+
+	m_attachments.push_back({ static_cast<size_t>(m_outBufferIndex), BufferPool::Buffer{}, size });
+	m_attachedSize += size;
+	m_file = { file, offset, size };
 }
 
 /////////////////////////////////////////////////////////////////////
@@ -198,4 +349,54 @@ void SocketStream::Reset()
 {
 	m_outBufferIndex = 0;
 	m_outBufferSize = 0;  //clear output buffer
+	m_bufferPool.Release(m_outBuffer);  //and give it back until the next reply
+	m_outBuffer = BufferPool::Buffer{};
+	ReleaseAttachments();
+}
+
+/////////////////////////////////////////////////////////////////////
+void SocketStream::ReserveOutput(size_t size)
+{
+	if (size <= m_outBuffer.capacity)
+	{
+		return;
+	}
+
+	// move to the buffer of the next fitting size class
+	const auto buffer = m_bufferPool.Acquire(size);
+	if (m_outBufferSize > 0)
+	{
+		memcpy(buffer.data, m_outBuffer.data, m_outBufferSize);
+	}
+	m_bufferPool.Release(m_outBuffer);
+	m_outBuffer = buffer;
+}
+
+/////////////////////////////////////////////////////////////////////
+unsigned char* SocketStream::Extend(size_t size)
+{
+	size_t capacity = 0;
+	unsigned char* data = GetWindow(size, capacity);
+	Advance(size);
+	return data;
+}
+
+/////////////////////////////////////////////////////////////////////
+void SocketStream::ReleaseAttachments()
+{
+	for (const auto& attachment : m_attachments)
+	{
+		m_bufferPool.Release(attachment.buffer);
+	}
+	m_attachments.clear();
+	m_attachedSize = 0;
+
+	m_bufferPool.Release(m_pending);
+	m_pending = BufferPool::Buffer{};
+
+	if (m_file.file != nullptr)
+	{
+		CloseHandle(m_file.file);
+		m_file = FileRange{};
+	}
 }
\ No newline at end of file
@@ -9,38 +9,87 @@
 
 #include "InputStream.h"
 #include "OutputStream.h"
+#include "BufferPool.h"
+#include <vector>
 
 class SocketStream : public IInputStream, public IOutputStream
 {
 public:
-	SocketStream();
+	struct Segment
+	{
+		const unsigned char* data;
+		size_t size;
+	};
+
+	struct FileRange
+	{
+		void* file;
+		uint64_t offset;
+		uint32_t size;
+	};
+
+	SocketStream(BufferPool& bufferPool, bool fileAttachments = false);
 	virtual ~SocketStream();
 
-	unsigned char* GetInput() noexcept;
-	void SetInputSize(size_t size);
+	void SetInput(const unsigned char* data, size_t size) noexcept;
 	unsigned char* GetOutput() noexcept;
 	size_t GetOutputSize() const noexcept;
-	size_t GetBufferSize() const noexcept;
+	/// <summary> Get the output data as a list of buffers to be sent in a single gathering call </summary>
+	/// <param name="segments"> Receives the buffers in the order of sending </param>
+	void GetOutputSegments(std::vector<Segment>& segments) const;
+	/// <summary> Get the attached file range and the output data to be sent around it </summary>
+	/// <param name="range"> Receives the file range </param>
+	/// <param name="head"> Receives the data to be sent before the file range </param>
+	/// <param name="tail"> Receives the data to be sent after the file range </param>
+	/// <returns> False if there is no file attached to the stream </returns>
+	bool GetOutputFile(FileRange& range, Segment& head, Segment& tail) const;
 	void Reset();
 
 	// IInputStream implementation
 	size_t Read(void* data, size_t size) override;
 	size_t Read(uint32_t* value) override;
 	size_t Read8(uint64_t* value) override;
+	size_t ReadWords(uint32_t* values, size_t count) override;
 	size_t Skip(size_t size) override;
 	size_t GetSize() const noexcept override;
+	const unsigned char* GetData() const noexcept override;
 
 	// IOutputStream implementation
 	void Write(const void* data, size_t size) override;
 	void Write(uint32_t value) override;
 	void Write8(uint64_t value) override;
+	void WriteWords(const uint32_t* values, size_t count) override;
 	void Seek(off_t offset, int from) override;
 	size_t GetPosition() const noexcept override;
+	unsigned char* GetWindow(size_t size, size_t& capacity) override;
+	void Advance(size_t size) override;
+	unsigned char* AcquireSegment(size_t size) override;
+	void CommitSegment(size_t size) override;
+	bool CanAttachFile() const noexcept override;
+	void AttachFile(void* file, uint64_t offset, uint32_t size) override;
 
 private:
-	unsigned char* m_inBuffer, * m_outBuffer;
+	struct Attachment
+	{
+		size_t offset;              // sent before this byte of the output buffer
+		BufferPool::Buffer buffer;  // empty for the file range
+		size_t size;
+	};
+
+	BufferPool& m_bufferPool;
+	const unsigned char* m_inBuffer; // not owned, points into the received record
+	BufferPool::Buffer m_outBuffer;  // borrowed from the pool until Reset()
+	BufferPool::Buffer m_pending;    // acquired segment not committed yet
+	std::vector<Attachment> m_attachments;
+	size_t m_attachedSize;
+	bool m_fileAttachments;          // whether the owner is able to send files
+	FileRange m_file;                // attached file range, if any
 	size_t m_inBufferSize, m_outBufferSize;
 	off_t m_inBufferIndex, m_outBufferIndex;
+
+	void ReserveOutput(size_t size);
+	unsigned char* Extend(size_t size);
+	void ReleaseAttachments();
 };
 
 #endif // ICENFSD_SOCKETSTREAM_H
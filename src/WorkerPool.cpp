@@ -0,0 +1,91 @@
+/////////////////////////////////////////////////////////////////////
+/// file: WorkerPool.cpp
+///
+/// summary: fixed pool of threads executing the posted tasks
+/////////////////////////////////////////////////////////////////////
+
+#include "WorkerPool.h"
+#include <boost/log/trivial.hpp>
+#include <stdexcept>
+
+/////////////////////////////////////////////////////////////////////
+WorkerPool::WorkerPool(size_t threadCount)
+	: m_stopped(false)
+{
+	if (0 == threadCount)
+	{
+		throw std::runtime_error("at least one worker thread is required");
+	}
+
+	m_threads.reserve(threadCount);
+	for (size_t i = 0; i < threadCount; i++)
+	{
+		m_threads.emplace_back(&WorkerPool::Run, this);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+WorkerPool::~WorkerPool()
+{
+	Stop();
+}
+
+/////////////////////////////////////////////////////////////////////
+void WorkerPool::Post(Task task)
+{
+	{
+		std::scoped_lock<std::mutex> lock(m_lock);
+		if (m_stopped)
+		{
+			return;
+		}
+		m_tasks.emplace_back(std::move(task));
+	}
+	m_wakeup.notify_one();
+}
+
+/////////////////////////////////////////////////////////////////////
+void WorkerPool::Stop()
+{
+	{
+		std::scoped_lock<std::mutex> lock(m_lock);
+		m_stopped = true;
+	}
+	m_wakeup.notify_all();
+
+	for (auto& thread : m_threads)
+	{
+		if (thread.joinable())
+		{
+			thread.join();
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+void WorkerPool::Run()
+{
+	for (;;)
+	{
+		Task task;
+		{
+			std::unique_lock<std::mutex> lock(m_lock);
+			m_wakeup.wait(lock, [this] { return m_stopped || !m_tasks.empty(); });
+			if (m_tasks.empty())
+			{
+				return; // stopped and drained
+			}
+			task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+		}
+
+		try
+		{
+			task();
+		}
+		catch (const std::exception& e)
+		{
+			BOOST_LOG_TRIVIAL(error) << "worker task failed: " << e.what();
+		}
+	}
+}
\ No newline at end of file
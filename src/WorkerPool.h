@@ -0,0 +1,41 @@
+/////////////////////////////////////////////////////////////////////
+/// file: WorkerPool.h
+///
+/// summary: fixed pool of threads executing the posted tasks
+/////////////////////////////////////////////////////////////////////
+
+#ifndef ICENFSD_WORKERPOOL_H
+#define ICENFSD_WORKERPOOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <thread>
+#include <deque>
+#include <mutex>
+
+class WorkerPool
+{
+public:
+	using Task = std::function<void()>;
+
+	WorkerPool(size_t threadCount);
+	~WorkerPool();
+
+	/// <summary> Queue the task for execution on one of the workers </summary>
+	/// <param name="task"> Task to execute </param>
+	void Post(Task task);
+	/// <summary> Execute the tasks queued so far and stop the workers </summary>
+	void Stop();
+
+private:
+	bool m_stopped;
+	std::mutex m_lock;
+	std::condition_variable m_wakeup;
+	std::deque<Task> m_tasks;
+	std::vector<std::thread> m_threads;
+
+	void Run();
+};
+
+#endif // ICENFSD_WORKERPOOL_H
\ No newline at end of file
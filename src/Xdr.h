@@ -0,0 +1,178 @@
+/////////////////////////////////////////////////////////////////////
+/// file: Xdr.h
+///
+/// summary: XDR encoding of the words and the fixed-size structures
+/////////////////////////////////////////////////////////////////////
+
+#ifndef ICENFSD_XDR_H
+#define ICENFSD_XDR_H
+
+#include <stdlib.h>
+#include <type_traits>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <tuple>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#define ICENFSD_XDR_SSE2
+#endif
+
+// RFC 4506: the integers are big-endian and the booleans take 4 bytes.
+// The byte order is reversed with the compiler intrinsics, the arrays
+// of words four at a time with SSE2.
+// A structure is encoded by listing its members in the wire order once:
+//
+//   template <> struct XdrFields<NFSTime3>
+//   {
+//       static constexpr auto members = std::make_tuple(&NFSTime3::seconds, &NFSTime3::nseconds);
+//   };
+//
+// Its wire size is then known at compile time, so the whole structure
+// is stored into a stack buffer and written to the stream at once
+// instead of a virtual call per member.
+template <typename T>
+struct XdrFields;
+
+template <typename T>
+struct XdrMember;
+
+template <typename Class, typename Member>
+struct XdrMember<Member Class::*>
+{
+	using type = Member;
+};
+
+/////////////////////////////////////////////////////////////////////
+template <typename T>
+constexpr size_t XdrSizeOf()
+{
+	if constexpr (std::is_same_v<T, bool> || std::is_same_v<T, uint32_t>)
+	{
+		return sizeof(uint32_t);
+	}
+	else if constexpr (std::is_same_v<T, uint64_t>)
+	{
+		return sizeof(uint64_t);
+	}
+	else
+	{
+		return std::apply([](auto... members) {
+			return (size_t(0) + ... + XdrSizeOf<typename XdrMember<decltype(members)>::type>());
+		}, XdrFields<T>::members);
+	}
+}
+
+/// <summary> Amount of bytes the value of the type takes on the wire </summary>
+template <typename T>
+constexpr size_t XdrSize = XdrSizeOf<T>();
+
+/////////////////////////////////////////////////////////////////////
+inline unsigned char* XdrEncode(unsigned char* data, uint32_t value) noexcept
+{
+	value = _byteswap_ulong(value);
+	memcpy(data, &value, sizeof(value));  // unaligned store
+	return data + sizeof(value);
+}
+
+/////////////////////////////////////////////////////////////////////
+inline unsigned char* XdrEncode(unsigned char* data, uint64_t value) noexcept
+{
+	value = _byteswap_uint64(value);
+	memcpy(data, &value, sizeof(value));
+	return data + sizeof(value);
+}
+
+/////////////////////////////////////////////////////////////////////
+inline const unsigned char* XdrDecode(const unsigned char* data, uint32_t& value) noexcept
+{
+	memcpy(&value, data, sizeof(value));
+	value = _byteswap_ulong(value);
+	return data + sizeof(value);
+}
+
+/////////////////////////////////////////////////////////////////////
+inline const unsigned char* XdrDecode(const unsigned char* data, uint64_t& value) noexcept
+{
+	memcpy(&value, data, sizeof(value));
+	value = _byteswap_uint64(value);
+	return data + sizeof(value);
+}
+
+#ifdef ICENFSD_XDR_SSE2
+/////////////////////////////////////////////////////////////////////
+// Reverses the bytes of the four words: swaps their halves, then the
+// bytes of the halves. SSE2 is always there on x64, unlike pshufb.
+inline __m128i XdrSwapWords(__m128i words) noexcept
+{
+	words = _mm_shufflelo_epi16(words, _MM_SHUFFLE(2, 3, 0, 1));
+	words = _mm_shufflehi_epi16(words, _MM_SHUFFLE(2, 3, 0, 1));
+	return _mm_or_si128(_mm_slli_epi16(words, 8), _mm_srli_epi16(words, 8));
+}
+#endif
+
+/// <summary> Store the array of words in the network byte order </summary>
+/// <param name="data"> Buffer of count * 4 bytes at least </param>
+/// <param name="values"> Words to store </param>
+/// <param name="count"> Amount of the words </param>
+/// <returns> Pointer past the stored bytes </returns>
+inline unsigned char* XdrEncodeWords(unsigned char* data, const uint32_t* values, size_t count) noexcept
+{
+	size_t i = 0;
+#ifdef ICENFSD_XDR_SSE2
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(data + i * sizeof(uint32_t)), XdrSwapWords(words));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		XdrEncode(data + i * sizeof(uint32_t), values[i]);
+	}
+	return data + count * sizeof(uint32_t);
+}
+
+/// <summary> Load the array of words stored in the network byte order </summary>
+/// <param name="data"> Buffer of count * 4 bytes at least </param>
+/// <param name="values"> Receives the words </param>
+/// <param name="count"> Amount of the words </param>
+/// <returns> Pointer past the loaded bytes </returns>
+inline const unsigned char* XdrDecodeWords(const unsigned char* data, uint32_t* values, size_t count) noexcept
+{
+	size_t i = 0;
+#ifdef ICENFSD_XDR_SSE2
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i * sizeof(uint32_t)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(values + i), XdrSwapWords(words));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		XdrDecode(data + i * sizeof(uint32_t), values[i]);
+	}
+	return data + count * sizeof(uint32_t);
+}
+
+/////////////////////////////////////////////////////////////////////
+inline unsigned char* XdrEncode(unsigned char* data, bool value) noexcept
+{
+	return XdrEncode(data, static_cast<uint32_t>(value ? 1 : 0));
+}
+
+/// <summary> Store the structure listed by XdrFields into the buffer </summary>
+/// <param name="data"> Buffer of XdrSize bytes at least </param>
+/// <param name="value"> Structure to store </param>
+/// <returns> Pointer past the stored bytes </returns>
+template <typename T>
+unsigned char* XdrEncode(unsigned char* data, const T& value) noexcept
+{
+	std::apply([&data, &value](auto... members) {
+		((data = XdrEncode(data, value.*members)), ...);
+	}, XdrFields<T>::members);
+	return data;
+}
+
+#endif // ICENFSD_XDR_H
\ No newline at end of file
@@ -0,0 +1,243 @@
+/////////////////////////////////////////////////////////////////////
+/// file: XdrStream.h
+///
+/// summary: XDR reader and writer of the RPC programs
+/////////////////////////////////////////////////////////////////////
+
+#ifndef ICENFSD_XDRSTREAM_H
+#define ICENFSD_XDRSTREAM_H
+
+#include "Xdr.h"
+#include "OutputStream.h"
+#include <cstring>
+
+// The programs decode every request and encode every reply field by
+// field, so these types are concrete and their methods inline. The
+// reader works on the span of the received message. The writer stores
+// into a window of the output stream's buffer and calls the stream
+// only when the window is full or for the operations it cannot do
+// itself, so it has to be flushed at the end. The stream interfaces
+// remain the boundary to the sockets and to the tests.
+
+class XdrReader
+{
+public:
+	XdrReader(const unsigned char* data, size_t size) noexcept
+		: m_data(data)
+		, m_size(size)
+		, m_position(0)
+	{}
+
+	/// <summary> Read specified amount of data, less if the message ends </summary>
+	/// <returns> Amount of bytes actually read </returns>
+	size_t Read(void* data, size_t size) noexcept
+	{
+		size = Clamp(size);
+		memcpy(data, m_data + m_position, size);
+		m_position += size;
+		return size;
+	}
+
+	/// <summary> Read uint32_t value stored in the network byte order </summary>
+	/// <returns> Amount of bytes actually read (have to be 4) </returns>
+	size_t Read(uint32_t* value) noexcept
+	{
+		if (GetSize() < sizeof(*value))
+		{
+			return ReadTruncated(reinterpret_cast<unsigned char*>(value), sizeof(*value));
+		}
+		XdrDecode(m_data + m_position, *value);
+		m_position += sizeof(*value);
+		return sizeof(*value);
+	}
+
+	/// <summary> Read uint64_t value stored in the network byte order </summary>
+	/// <returns> Amount of bytes actually read (have to be 8) </returns>
+	size_t Read8(uint64_t* value) noexcept
+	{
+		if (GetSize() < sizeof(*value))
+		{
+			return ReadTruncated(reinterpret_cast<unsigned char*>(value), sizeof(*value));
+		}
+		XdrDecode(m_data + m_position, *value);
+		m_position += sizeof(*value);
+		return sizeof(*value);
+	}
+
+	/// <summary> Read an array of uint32_t values at once </summary>
+	/// <returns> Amount of the whole values actually read </returns>
+	size_t ReadWords(uint32_t* values, size_t count) noexcept
+	{
+		const size_t available = GetSize() / sizeof(uint32_t);
+		if (count > available)
+		{
+			count = available;
+		}
+		XdrDecodeWords(m_data + m_position, values, count);
+		m_position += count * sizeof(uint32_t);
+		return count;
+	}
+
+	/// <summary> Take specified amount of bytes in place, without copying them </summary>
+	/// <returns> Pointer into the message, valid while it is processed; nullptr if the message ends sooner </returns>
+	const unsigned char* View(size_t size) noexcept
+	{
+		if (size > GetSize())
+		{
+			return nullptr;
+		}
+		const unsigned char* data = m_data + m_position;
+		m_position += size;
+		return data;
+	}
+
+	/// <summary> Skip specified amount of bytes, less if the message ends </summary>
+	/// <returns> Amount of bytes actually skipped </returns>
+	size_t Skip(size_t size) noexcept
+	{
+		size = Clamp(size);
+		m_position += size;
+		return size;
+	}
+
+	/// <summary> Get amount of bytes left to read </summary>
+	size_t GetSize() const noexcept
+	{
+		return m_size - m_position;
+	}
+
+private:
+	const unsigned char* m_data; // not owned, the received message
+	size_t m_size;
+	size_t m_position;
+
+	size_t Clamp(size_t size) const noexcept
+	{
+		return size > GetSize() ? GetSize() : size;
+	}
+
+	size_t ReadTruncated(unsigned char* value, size_t length) noexcept
+	{
+		unsigned char buffer[sizeof(uint64_t)];
+		const size_t n = Read(buffer, length);
+		for (size_t i = 0; i < n; i++) // reverse byte order of what is there
+		{
+			value[length - 1 - i] = buffer[i];
+		}
+		return n;
+	}
+};
+
+class XdrWriter
+{
+public:
+	explicit XdrWriter(IOutputStream& stream) noexcept
+		: m_stream(stream)
+		, m_base(nullptr)
+		, m_cursor(nullptr)
+		, m_end(nullptr)
+	{}
+
+	XdrWriter(const XdrWriter&) = delete;
+	XdrWriter& operator=(const XdrWriter&) = delete;
+
+	/// <summary> Get the place for specified amount of bytes at the current position and move past it </summary>
+	/// <returns> Pointer to the bytes to be filled by the caller </returns>
+	unsigned char* Reserve(size_t size)
+	{
+		if (static_cast<size_t>(m_end - m_cursor) < size)
+		{
+			Refill(size);
+		}
+		unsigned char* data = m_cursor;
+		m_cursor += size;
+		return data;
+	}
+
+	void Write(const void* data, size_t size)
+	{
+		memcpy(Reserve(size), data, size);
+	}
+
+	void Write(uint32_t value)
+	{
+		XdrEncode(Reserve(sizeof(value)), value);
+	}
+
+	void Write8(uint64_t value)
+	{
+		XdrEncode(Reserve(sizeof(value)), value);
+	}
+
+	void WriteWords(const uint32_t* values, size_t count)
+	{
+		XdrEncodeWords(Reserve(count * sizeof(uint32_t)), values, count);
+	}
+
+	void Seek(off_t offset, int from)
+	{
+		Release();
+		m_stream.Seek(offset, from);
+	}
+
+	size_t GetPosition() const noexcept
+	{
+		return m_stream.GetPosition() + static_cast<size_t>(m_cursor - m_base);
+	}
+
+	unsigned char* AcquireSegment(size_t size)
+	{
+		return m_stream.AcquireSegment(size);
+	}
+
+	void CommitSegment(size_t size)
+	{
+		Release();
+		m_stream.CommitSegment(size);
+	}
+
+	bool CanAttachFile() const noexcept
+	{
+		return m_stream.CanAttachFile();
+	}
+
+	void AttachFile(void* file, uint64_t offset, uint32_t size)
+	{
+		Release();
+		m_stream.AttachFile(file, offset, size);
+	}
+
+	/// <summary> Pass the bytes stored so far to the stream, it must be done before the stream is used otherwise </summary>
+	void Flush()
+	{
+		if (m_cursor != m_base)
+		{
+			m_stream.Advance(static_cast<size_t>(m_cursor - m_base));
+			m_base = m_cursor;
+		}
+	}
+
+private:
+	IOutputStream& m_stream;
+	unsigned char* m_base;   // the window in the buffer of the stream, at its current position
+	unsigned char* m_cursor;
+	unsigned char* m_end;
+
+	void Refill(size_t size)
+	{
+		Flush();
+		size_t capacity = 0;
+		m_base = m_stream.GetWindow(size, capacity);
+		m_cursor = m_base;
+		m_end = m_base + capacity;
+	}
+
+	// The stream is changed otherwise, the window may be gone
+	void Release()
+	{
+		Flush();
+		m_base = m_cursor = m_end = nullptr;
+	}
+};
+
+#endif // ICENFSD_XDRSTREAM_H
\ No newline at end of file
@@ -5,7 +5,12 @@
 /////////////////////////////////////////////////////////////////////
 
 #include "Socket.h"
+#include "SocketReactor.h"
+#include "BufferPool.h"
+#include "WorkerPool.h"
 #include "RPCServer.h"
+#include "RequestArena.h"
+#include "HeapCounter.h"
 #include "PortmapProg.h"
 #include "NFSProg.h"
 #include "MountProg.h"
@@ -59,6 +64,53 @@ public:
 	}
 };
 
+/////////////////////////////////////////////////////////////////////
+static void LogStatistics(const BufferPool& bufferPool)
+{
+	for (const auto& sizeClass : bufferPool.GetStatistics())
+	{
+		BOOST_LOG_TRIVIAL(debug) << "Buffer pool class " << sizeClass.bufferSize
+			<< ": in use " << sizeClass.inUse << ", idle " << sizeClass.idle
+			<< ", acquired " << sizeClass.acquired << ", allocated " << sizeClass.allocated;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+static void LogStatistics(const RequestArena::Statistics& statistics)
+{
+	if (statistics.requests == 0)
+	{
+		return;
+	}
+	if constexpr (HeapCounter::ENABLED)
+	{
+		BOOST_LOG_TRIVIAL(info) << "Request arenas: " << statistics.requests << " requests, "
+			<< statistics.allocations << " allocations of " << statistics.bytes << " bytes, "
+			<< statistics.ownAllocations << " for the arenas; " << statistics.heapAllocations << " heap allocations besides, "
+			<< static_cast<double>(statistics.heapAllocations) / static_cast<double>(statistics.requests) << " per request";
+	}
+	else
+	{
+		BOOST_LOG_TRIVIAL(info) << "Request arenas: " << statistics.requests << " requests, "
+			<< statistics.allocations << " allocations of " << statistics.bytes << " bytes";
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+static void LogStatistics(const char* service, const ServerSocket& socket)
+{
+	const auto statistics = socket.GetStatistics();
+	BOOST_LOG_TRIVIAL(info) << service << " connections: accepted " << statistics.accepted
+		<< ", rejected " << statistics.rejected << ", active " << statistics.active
+		<< ", queued " << statistics.queued << ", reaped " << statistics.reaped
+		<< " (" << statistics.reclaimedBytes << " bytes reclaimed)";
+	if (statistics.sends > 0)
+	{
+		BOOST_LOG_TRIVIAL(info) << service << " replies: " << statistics.replies << " in " << statistics.sends
+			<< " sends, " << static_cast<double>(statistics.replies) / static_cast<double>(statistics.sends) << " per send";
+	}
+}
+
 /////////////////////////////////////////////////////////////////////
 int main(int argc, char* argv[])
 try
@@ -77,26 +129,44 @@ try
 
 	for (const auto& mountPoint : settings.GetExports())
 	{
-		mountServer->Export(mountPoint.first.c_str(), mountPoint.second.c_str());
+		const auto path = mountServer->Export(mountPoint.first.c_str(), mountPoint.second.alias.c_str());
+		if (mountPoint.second.zeroCopyRead)
+		{
+			nfsServer->EnableZeroCopyRead(path);
+		}
 	}
 
 	rpcServer->Set(PROG_PORTMAP, std::move(portMapper));  //program for portmap
 	rpcServer->Set(PROG_NFS, std::move(nfsServer));       //program for nfs
 	rpcServer->Set(PROG_MOUNT, std::move(mountServer));   //program for mount
 
-	ServerSocket rpcTcpSocket(settings.GetRpcEndpoint(), 3, rpcServer.get());
-	DatagramSocket rpcUdpSocket(settings.GetRpcEndpoint(), rpcServer.get());
+	// the workers must outlive the reactor, which must outlive the sockets
+	BufferPool bufferPool;
+	WorkerPool workers(settings.GetWorkerThreads());
+	const auto engine = settings.GetIoEngine() == IoEngine::CompletionPort ? SocketReactor::Engine::CompletionPort : SocketReactor::Engine::Poll;
+	SocketReactor reactor(settings.GetIoThreads(), workers, engine);
+	const ConnectionLimits limits{ settings.GetSoftConnectionLimit(), settings.GetHardConnectionLimit() };
+	const ConnectionTimeouts timeouts{ std::chrono::seconds(settings.GetIdleTimeout()),
+		std::chrono::seconds(settings.GetKeepAliveTime()), std::chrono::seconds(settings.GetKeepAliveInterval()) };
+	ServerSocket rpcTcpSocket(settings.GetRpcEndpoint(), limits, timeouts, rpcServer.get(), reactor, workers, bufferPool);
+	DatagramSocket rpcUdpSocket(settings.GetRpcEndpoint(), rpcServer.get(), reactor, workers, bufferPool);
 	BOOST_LOG_TRIVIAL(debug) << "Portmap daemon started at " << rpcTcpSocket.GetAddress();
-	ServerSocket nfsTcpSocket(settings.GetNfsEndpoint(), 10, rpcServer.get());
-	DatagramSocket nfsUdpSocket(settings.GetNfsEndpoint(), rpcServer.get());
+	ServerSocket nfsTcpSocket(settings.GetNfsEndpoint(), limits, timeouts, rpcServer.get(), reactor, workers, bufferPool);
+	DatagramSocket nfsUdpSocket(settings.GetNfsEndpoint(), rpcServer.get(), reactor, workers, bufferPool);
 	BOOST_LOG_TRIVIAL(debug) << "NFS daemon started at " << nfsTcpSocket.GetAddress();
-	ServerSocket mountTcpSocket(settings.GetMountEndpoint(), 3, rpcServer.get());
-	DatagramSocket mountUdpSocket(settings.GetMountEndpoint(), rpcServer.get());
+	ServerSocket mountTcpSocket(settings.GetMountEndpoint(), limits, timeouts, rpcServer.get(), reactor, workers, bufferPool);
+	DatagramSocket mountUdpSocket(settings.GetMountEndpoint(), rpcServer.get(), reactor, workers, bufferPool);
 	BOOST_LOG_TRIVIAL(debug) << "Mount daemon started at " << mountTcpSocket.GetAddress();
 
 	std::string data;
 	std::cin >> data;
 
+	LogStatistics("Portmap", rpcTcpSocket);
+	LogStatistics("NFS", nfsTcpSocket);
+	LogStatistics("Mount", mountTcpSocket);
+	LogStatistics(bufferPool);
+	LogStatistics(RequestArena::GetStatistics());
+
 	return EXIT_SUCCESS;
 }
 catch (const std::exception& e)
@@ -0,0 +1,54 @@
+/////////////////////////////////////////////////////////////////////
+/// file: tests/benchmark.h
+///
+/// summary: timing helpers shared by the benchmarks
+/////////////////////////////////////////////////////////////////////
+
+#ifndef ICENFSD_TESTS_BENCHMARK_H
+#define ICENFSD_TESTS_BENCHMARK_H
+
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+/// <summary> Run the function the given amount of times </summary>
+/// <returns> Milliseconds all the runs took </returns>
+template <typename Function>
+double Measure(int repeat, Function function)
+{
+	const auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < repeat; i++)
+	{
+		function();
+	}
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// <summary> Run the function once for each of the handles </summary>
+/// <returns> Nanoseconds a run took on average </returns>
+template <typename Function>
+double MeasureLookups(const std::vector<uint64_t>& handles, Function function)
+{
+	const auto start = std::chrono::steady_clock::now();
+	for (const uint64_t handle : handles)
+	{
+		function(handle);
+	}
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / handles.size();
+}
+
+/// <summary> Draw the handles uniformly from the range, the same ones for the same range </summary>
+inline std::vector<uint64_t> RandomHandles(uint64_t first, uint64_t last, size_t count)
+{
+	std::mt19937_64 random(first);
+	std::uniform_int_distribution<uint64_t> distribution(first, last);
+	std::vector<uint64_t> handles(count);
+	for (auto& handle : handles)
+	{
+		handle = distribution(random);
+	}
+	return handles;
+}
+
+#endif // ICENFSD_TESTS_BENCHMARK_H
\ No newline at end of file
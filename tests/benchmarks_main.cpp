@@ -0,0 +1,8 @@
+/////////////////////////////////////////////////////////////////////
+/// file: tests/benchmarks_main.cpp
+///
+/// summary: Entry point for the benchmarks
+/////////////////////////////////////////////////////////////////////
+
+#define BOOST_TEST_MODULE icenfsd_benchmarks
+#include <boost/test/unit_test.hpp>
\ No newline at end of file
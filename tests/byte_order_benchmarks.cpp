@@ -0,0 +1,82 @@
+/////////////////////////////////////////////////////////////////////
+/// file: tests/byte_order_benchmarks.cpp
+///
+/// summary: benchmarks of the word array conversions of the streams
+/////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include <boost/test/unit_test.hpp>
+#include <vector>
+
+#include "../src/BufferPool.cpp"
+#include "../src/SocketStream.cpp"
+#include "../src/XdrStream.h"
+#include "benchmark.h"
+
+/////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(BenchmarkByteOrder)
+BOOST_AUTO_TEST_CASE(EncodeWords)
+{
+	std::vector<uint32_t> words(64 * 1024);
+	for (size_t i = 0; i < words.size(); i++)
+	{
+		words[i] = static_cast<uint32_t>(i * 0x9E3779B9U);
+	}
+	std::vector<unsigned char> expected(words.size() * sizeof(uint32_t));
+	std::vector<unsigned char> actual(expected.size());
+
+	const double loop = Measure(100, [&] {
+		for (size_t i = 0; i < words.size(); i++)
+		{
+			XdrEncode(expected.data() + i * sizeof(uint32_t), words[i]);
+		}
+	});
+	const double bulk = Measure(100, [&] { XdrEncodeWords(actual.data(), words.data(), words.size()); });
+	BOOST_TEST(actual == expected);
+
+	BufferPool pool;
+	SocketStream stream(pool);
+	const double single = Measure(100, [&] {
+		stream.Reset();
+		for (const uint32_t word : words)
+		{
+			stream.Write(word);
+		}
+	});
+	const double array = Measure(100, [&] {
+		stream.Reset();
+		stream.WriteWords(words.data(), words.size());
+	});
+	BOOST_TEST(std::vector<unsigned char>(stream.GetOutput(), stream.GetOutput() + stream.GetOutputSize()) == expected);
+
+	BOOST_TEST_MESSAGE("100 x 64K words: word loop " << loop << " ms, bulk " << bulk << " ms, "
+		<< "stream per word " << single << " ms, stream array " << array << " ms");
+}
+BOOST_AUTO_TEST_CASE(DecodeWords)
+{
+	std::vector<unsigned char> data(64 * 1024 * sizeof(uint32_t));
+	for (size_t i = 0; i < data.size(); i++)
+	{
+		data[i] = static_cast<unsigned char>(i * 31);
+	}
+	std::vector<uint32_t> expected(data.size() / sizeof(uint32_t));
+	std::vector<uint32_t> actual(expected.size());
+
+	BufferPool pool;
+	SocketStream stream(pool);
+	const double single = Measure(100, [&] {
+		stream.SetInput(data.data(), data.size());
+		for (auto& word : expected)
+		{
+			stream.Read(&word);
+		}
+	});
+	const double array = Measure(100, [&] {
+		stream.SetInput(data.data(), data.size());
+		stream.ReadWords(actual.data(), actual.size());
+	});
+	BOOST_TEST(actual == expected);
+
+	BOOST_TEST_MESSAGE("100 x 64K words: stream per word " << single << " ms, stream array " << array << " ms");
+}
+BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
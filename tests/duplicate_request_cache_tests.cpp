@@ -0,0 +1,124 @@
+/////////////////////////////////////////////////////////////////////
+/// file: tests/duplicate_request_cache_tests.cpp
+///
+/// summary: unit tests for the duplicate request cache
+/////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include <boost/test/unit_test.hpp>
+#include <stdexcept>
+
+#include "../src/DuplicateRequestCache.cpp"
+
+/////////////////////////////////////////////////////////////////////
+static DuplicateRequestCache::Key MakeKey(uint32_t xid, uint32_t address = 0x0100007F, uint32_t checksum = 0)
+{
+	return { address, xid, 100003, 3, 8, 64, checksum };
+}
+
+/////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestDuplicateRequestCache)
+BOOST_AUTO_TEST_CASE(Retransmission)
+{
+	DuplicateRequestCache cache;
+	DuplicateRequestCache::Reply reply;
+
+	BOOST_TEST((cache.Begin(MakeKey(1), reply) == DuplicateRequestCache::Status::New));
+	BOOST_TEST((cache.Begin(MakeKey(1), reply) == DuplicateRequestCache::Status::InProgress));
+	BOOST_TEST(reply.empty());
+
+	cache.Complete(MakeKey(1), { 1, 2, 3 });
+	BOOST_TEST((cache.Begin(MakeKey(1), reply) == DuplicateRequestCache::Status::Completed));
+	BOOST_TEST((reply == DuplicateRequestCache::Reply{ 1, 2, 3 }));
+}
+
+/////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_CASE(DistinctClients)
+{
+	DuplicateRequestCache cache;
+	DuplicateRequestCache::Reply reply;
+
+	BOOST_TEST((cache.Begin(MakeKey(1), reply) == DuplicateRequestCache::Status::New));
+	BOOST_TEST((cache.Begin(MakeKey(1, 0x0200007F), reply) == DuplicateRequestCache::Status::New));
+	BOOST_TEST(cache.GetSize() == 2);
+}
+
+/////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_CASE(Abandon)
+{
+	DuplicateRequestCache cache;
+	DuplicateRequestCache::Reply reply;
+
+	BOOST_TEST((cache.Begin(MakeKey(1), reply) == DuplicateRequestCache::Status::New));
+	cache.Abandon(MakeKey(1));
+	BOOST_TEST(cache.GetSize() == 0);
+	BOOST_TEST((cache.Begin(MakeKey(1), reply) == DuplicateRequestCache::Status::New));
+}
+
+/////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_CASE(Eviction)
+{
+	DuplicateRequestCache cache(2);
+	DuplicateRequestCache::Reply reply;
+
+	cache.Begin(MakeKey(1), reply);
+	cache.Begin(MakeKey(2), reply);
+	cache.Complete(MakeKey(1), { 1 });
+	cache.Complete(MakeKey(2), { 2 });
+	cache.Begin(MakeKey(3), reply);
+	BOOST_TEST(cache.GetSize() == 2);
+
+	// the oldest one is forgotten
+	BOOST_TEST((cache.Begin(MakeKey(2), reply) == DuplicateRequestCache::Status::Completed));
+	BOOST_TEST((cache.Begin(MakeKey(3), reply) == DuplicateRequestCache::Status::InProgress));
+	BOOST_TEST((cache.Begin(MakeKey(1), reply) == DuplicateRequestCache::Status::New));
+	BOOST_TEST(cache.GetSize() == 2);
+}
+
+/////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_CASE(EvictionKeepsInProgress)
+{
+	DuplicateRequestCache cache(2);
+	DuplicateRequestCache::Reply reply;
+
+	cache.Begin(MakeKey(1), reply);
+	cache.Begin(MakeKey(2), reply);
+	cache.Complete(MakeKey(2), { 2 });
+	cache.Begin(MakeKey(3), reply);
+	BOOST_TEST(cache.GetSize() == 2);
+
+	// the completed one is forgotten rather than the older one in progress
+	BOOST_TEST((cache.Begin(MakeKey(1), reply) == DuplicateRequestCache::Status::InProgress));
+	BOOST_TEST((cache.Begin(MakeKey(3), reply) == DuplicateRequestCache::Status::InProgress));
+
+	// with all of them in progress the cache grows past its capacity
+	cache.Begin(MakeKey(4), reply);
+	BOOST_TEST(cache.GetSize() == 3);
+	BOOST_TEST((cache.Begin(MakeKey(1), reply) == DuplicateRequestCache::Status::InProgress));
+}
+
+/////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_CASE(ReusedXid)
+{
+	DuplicateRequestCache cache;
+	DuplicateRequestCache::Reply reply;
+	const unsigned char create[] = { 0, 0, 0, 1, 'a' };
+	const unsigned char remove[] = { 0, 0, 0, 1, 'b' };
+	const uint32_t createChecksum = DuplicateRequestCache::GetChecksum(create, sizeof(create));
+	const uint32_t removeChecksum = DuplicateRequestCache::GetChecksum(remove, sizeof(remove));
+	BOOST_TEST(createChecksum != removeChecksum);
+
+	BOOST_TEST((cache.Begin(MakeKey(1, 0x0100007F, createChecksum), reply) == DuplicateRequestCache::Status::New));
+	cache.Complete(MakeKey(1, 0x0100007F, createChecksum), { 1 });
+
+	// the same xid with other arguments is another call, not a retransmission
+	BOOST_TEST((cache.Begin(MakeKey(1, 0x0100007F, removeChecksum), reply) == DuplicateRequestCache::Status::New));
+	BOOST_TEST((cache.Begin(MakeKey(1, 0x0100007F, createChecksum), reply) == DuplicateRequestCache::Status::Completed));
+}
+
+/////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_CASE(ZeroCapacity)
+{
+	BOOST_CHECK_THROW(DuplicateRequestCache(0), std::runtime_error);
+}
+BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
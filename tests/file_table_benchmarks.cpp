@@ -0,0 +1,245 @@
+/////////////////////////////////////////////////////////////////////
+/// file: tests/file_table_benchmarks.cpp
+///
+/// summary: benchmarks of the indexes of the file table
+/////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include <boost/test/unit_test.hpp>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <vector>
+
+#include "../src/conv.cpp"
+#include "../src/FileTree.cpp"
+#include "../src/HandleIndex.h"
+#include "benchmark.h"
+
+/////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(BenchmarkHandleIndex)
+BOOST_AUTO_TEST_CASE(Lookup)
+{
+	const uint64_t size = 10 * 1000 * 1000;
+	const uint64_t rowSize = 1024;
+	HandleIndex<uint64_t> index(rowSize);
+	std::list<std::vector<uint64_t>> rows; // the table the index has replaced
+	for (uint64_t i = 0; i < size; i++)
+	{
+		index.Add(i);
+		if ((i & (rowSize - 1)) == 0)
+		{
+			rows.emplace_back(static_cast<size_t>(rowSize));
+		}
+		rows.back()[static_cast<size_t>(i & (rowSize - 1))] = i;
+	}
+
+	uint64_t mismatches = 0;
+	const auto lookup = [&](uint64_t handle) { mismatches += index.Get(handle) != handle; };
+	const auto walk = [&](uint64_t handle) {
+		auto row = rows.cbegin();
+		for (uint64_t i = rowSize; i <= handle; i += rowSize)
+		{
+			++row;
+		}
+		mismatches += (*row)[static_cast<size_t>(handle & (rowSize - 1))] != handle;
+	};
+
+	const size_t count = 1000 * 1000;
+	const double low = MeasureLookups(RandomHandles(0, 1023, count), lookup);
+	const double middle = MeasureLookups(RandomHandles(size / 2 - 1024, size / 2 - 1, count), lookup);
+	const double high = MeasureLookups(RandomHandles(size - 1024, size - 1, count), lookup);
+	const double spread = MeasureLookups(RandomHandles(0, size - 1, count), lookup);
+
+	// the walk is too slow for the same amount of lookups
+	const double walkLow = MeasureLookups(RandomHandles(0, 1023, 1000), walk);
+	const double walkHigh = MeasureLookups(RandomHandles(size - 1024, size - 1, 1000), walk);
+	BOOST_CHECK_EQUAL(mismatches, 0U);
+
+	BOOST_TEST_MESSAGE("10M handles, ns per lookup: index first " << low << ", middle " << middle << ", last " << high
+		<< ", whole range " << spread << "; row list first " << walkLow << ", last " << walkHigh);
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+/////////////////////////////////////////////////////////////////////
+static std::string ChildPath(const std::string& directory, size_t i)
+{
+	return directory + "\\file" + std::to_string(i);
+}
+
+/////////////////////////////////////////////////////////////////////
+static std::string ConvertedPath(const std::string& path, size_t begin, size_t end)
+{
+	// the way the tree split the paths before, through UTF-16 and back
+	auto wcs = ConvFromCp932(path.c_str());
+	if (wcs == nullptr)
+	{
+		return path.substr(begin, end - begin);
+	}
+	std::wstring wpath(wcs);
+	delete[] wcs;
+	auto dest = ConvToCp932(wpath.c_str());
+	if (dest == nullptr)
+	{
+		return path.substr(begin, end - begin);
+	}
+	std::string result(dest);
+	delete[] dest;
+	return result.substr(begin, end - begin);
+}
+
+/////////////////////////////////////////////////////////////////////
+static FileTree::Node FindByConvertedPath(std::string path, FileTree::Node node)
+{
+	while (node != nullptr)
+	{
+		const size_t separator = path.find('\\');
+		const std::string currentPath = ConvertedPath(path, 0, separator == std::string::npos ? path.size() : separator);
+		const std::string followingPath = separator == std::string::npos ? std::string() : ConvertedPath(path, separator + 1, path.size());
+
+		auto child = node->first_child;
+		while (child != nullptr && child->data.path != currentPath)
+		{
+			child = child->next_sibling;
+		}
+		node = child;
+		if (followingPath.empty())
+		{
+			break;
+		}
+		path = followingPath;
+	}
+	return node;
+}
+
+/////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(BenchmarkFileTree)
+BOOST_AUTO_TEST_CASE(DeepPaths)
+{
+	FileTree tree;
+	const std::string root = "C:\\export";
+	tree.AddItem(root, 0);
+	std::vector<std::string> paths;
+	for (size_t branch = 0; branch < 16; branch++)
+	{
+		std::string path = root + "\\branch" + std::to_string(branch);
+		tree.AddItem(path, paths.size());
+		for (size_t level = 1; level < 20; level++)
+		{
+			path += "\\level" + std::to_string(level);
+			tree.AddItem(path, paths.size());
+		}
+		paths.push_back(path);
+	}
+
+	size_t misses = 0;
+	const auto top = tree.FindFileItemForPath(root);
+	const std::vector<uint64_t> positions = RandomHandles(0, paths.size() - 1, 100 * 1000);
+	const double converted = MeasureLookups(positions, [&](uint64_t i) {
+		misses += FindByConvertedPath(paths[static_cast<size_t>(i)].substr(root.size() + 1), top) == nullptr;
+	});
+	const double tokenized = MeasureLookups(positions, [&](uint64_t i) { misses += tree.FindFileItemForPath(paths[static_cast<size_t>(i)]) == nullptr; });
+	BOOST_CHECK_EQUAL(misses, 0U);
+
+	BOOST_TEST_MESSAGE("ns per 20 levels deep path lookup: converted components " << converted << ", tokenized " << tokenized);
+}
+BOOST_AUTO_TEST_CASE(DeepFullPaths)
+{
+	FileTree tree;
+	const std::string root = "C:\\export";
+	tree.AddItem(root, 0);
+	std::vector<FileTree::Node> nodes;
+	for (size_t branch = 0; branch < 16; branch++)
+	{
+		std::string path = root + "\\branch" + std::to_string(branch);
+		FileTree::Node node = tree.AddItem(path, 0);
+		for (size_t level = 1; level < 20; level++)
+		{
+			path += "\\level" + std::to_string(level);
+			node = tree.AddItem(path, 0);
+		}
+		nodes.push_back(node);
+	}
+
+	size_t length = 0;
+	const std::vector<uint64_t> positions = RandomHandles(0, nodes.size() - 1, 100 * 1000);
+	const double built = MeasureLookups(positions, [&](uint64_t i) {
+		// the way the full paths were built before, from the node up
+		auto node = nodes[static_cast<size_t>(i)];
+		std::string path = node->data.path;
+		for (auto parent = node->parent; parent != nullptr; parent = parent->parent)
+		{
+			path.insert(0, "\\");
+			path.insert(0, parent->data.path);
+		}
+		length += path.size();
+	});
+	const double cached = MeasureLookups(positions, [&](uint64_t i) {
+		std::string path;
+		tree.GetNodeFullPath(nodes[static_cast<size_t>(i)], path);
+		length -= path.size();
+	});
+	BOOST_CHECK_EQUAL(length, 0U);
+
+	BOOST_TEST_MESSAGE("ns per 20 levels deep full path: built " << built << ", cached " << cached);
+}
+BOOST_AUTO_TEST_CASE(DirectorySize)
+{
+	FileTree tree;
+	const std::string root = "C:\\export";
+	const std::string small = root + "\\small";
+	const std::string large = root + "\\large";
+	const size_t smallSize = FileTree::CHILD_INDEX_THRESHOLD / 2;
+	const size_t largeSize = 100 * 1000;
+	tree.AddItem(root, 0);
+	tree.AddItem(small, 1);
+	tree.AddItem(large, 2);
+	for (size_t i = 0; i < smallSize; i++)
+	{
+		tree.AddItem(ChildPath(small, i), i);
+	}
+	for (size_t i = 0; i < largeSize; i++)
+	{
+		tree.AddItem(ChildPath(large, i), i);
+	}
+
+	std::vector<uint64_t> indexes = RandomHandles(0, smallSize - 1, 100 * 1000);
+	std::vector<std::string> smallPaths;
+	for (const uint64_t i : indexes)
+	{
+		smallPaths.push_back(ChildPath(small, static_cast<size_t>(i)));
+	}
+	indexes = RandomHandles(0, largeSize - 1, 100 * 1000);
+	std::vector<std::string> largePaths;
+	for (const uint64_t i : indexes)
+	{
+		largePaths.push_back(ChildPath(large, static_cast<size_t>(i)));
+	}
+
+	size_t misses = 0;
+	std::vector<uint64_t> positions(smallPaths.size());
+	for (size_t i = 0; i < positions.size(); i++)
+	{
+		positions[i] = i;
+	}
+	const double scanned = MeasureLookups(positions, [&](uint64_t i) { misses += tree.FindFileItemForPath(smallPaths[static_cast<size_t>(i)]) == nullptr; });
+	const double indexed = MeasureLookups(positions, [&](uint64_t i) { misses += tree.FindFileItemForPath(largePaths[static_cast<size_t>(i)]) == nullptr; });
+
+	// the scan of the large directory the index has replaced, too slow for the same amount of lookups
+	const auto directory = tree.FindFileItemForPath(large);
+	positions.resize(1000);
+	const double largeScanned = MeasureLookups(positions, [&](uint64_t i) {
+		const std::string name = largePaths[static_cast<size_t>(i)].substr(large.size() + 1);
+		auto child = directory->first_child;
+		while (child != nullptr && child->data.path != name)
+		{
+			child = child->next_sibling;
+		}
+		misses += child == nullptr;
+	});
+	BOOST_CHECK_EQUAL(misses, 0U);
+
+	BOOST_TEST_MESSAGE("ns per path lookup: " << smallSize << " entries scanned " << scanned << ", " << largeSize << " entries indexed " << indexed
+		<< ", " << largeSize << " entries scanned " << largeScanned);
+}
+BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
@@ -0,0 +1,325 @@
+/////////////////////////////////////////////////////////////////////
+/// file: tests/file_table_tests.cpp
+///
+/// summary: unit tests for the indexes of the file table
+/////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include <boost/test/unit_test.hpp>
+#include <filesystem>
+#include <cstdint>
+#include <vector>
+
+#include "../src/conv.cpp"
+#include "../src/FileTree.cpp"
+#include "../src/FileTable.cpp"
+#include "../src/PathIndex.cpp"
+#include "temporary_export.h"
+
+/////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestHandleIndex)
+BOOST_AUTO_TEST_CASE(Sequence)
+{
+	HandleIndex<uint64_t> index(4);
+	for (uint64_t i = 0; i < 10; i++)
+	{
+		BOOST_CHECK_EQUAL(index.Add(i + 100), i);
+	}
+
+	BOOST_CHECK_EQUAL(index.GetSize(), 10U);
+	BOOST_CHECK_EQUAL(index.Get(0), 100U);
+	BOOST_CHECK_EQUAL(index.Get(4), 104U); // first slot of the second chunk
+	BOOST_CHECK_EQUAL(index.Get(9), 109U);
+	BOOST_CHECK_EQUAL(index.Get(10), 0U);  // not given out yet
+	BOOST_CHECK_EQUAL(index.Get(UINT64_MAX), 0U);
+}
+BOOST_AUTO_TEST_CASE(Clear)
+{
+	HandleIndex<const char*> index(4);
+	index.Add("a");
+	index.Add("b");
+
+	BOOST_CHECK(index.Clear(1));
+	BOOST_CHECK(index.Get(1) == nullptr);
+	BOOST_CHECK(index.Clear(1));
+	BOOST_CHECK(!index.Clear(2));
+
+	// the cleared handle is not given out again
+	BOOST_CHECK_EQUAL(index.Add("c"), 2U);
+	BOOST_CHECK_EQUAL(index.Get(0), "a");
+}
+BOOST_AUTO_TEST_CASE(ChunkSize)
+{
+	BOOST_CHECK_THROW(HandleIndex<int>(0), std::runtime_error);
+	BOOST_CHECK_THROW(HandleIndex<int>(1000), std::runtime_error);
+	BOOST_CHECK_NO_THROW(HandleIndex<int>(1));
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+/////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestPathIndex)
+BOOST_AUTO_TEST_CASE(FindInsertErase)
+{
+	PathIndex index;
+	uint64_t handle = 0;
+	BOOST_CHECK(!index.Find("C:\\export", handle));
+
+	index.Insert("C:\\export", 1);
+	index.Insert("C:\\export\\file", 2);
+	index.Insert("C:\\export\\file", 3); // replaced
+	BOOST_CHECK(index.Find("C:\\export\\file", handle));
+	BOOST_CHECK_EQUAL(handle, 3U);
+	BOOST_CHECK(!index.Find("C:\\export\\File", handle));
+	BOOST_CHECK_EQUAL(index.GetSize(), 2U);
+
+	index.Erase("C:\\export");
+	BOOST_CHECK(!index.Find("C:\\export", handle));
+	BOOST_CHECK_EQUAL(index.GetSize(), 1U);
+}
+BOOST_AUTO_TEST_CASE(FindByView)
+{
+	PathIndex index;
+	uint64_t handle = 0;
+	{
+		std::string path = "C:\\export\\a file name longer than the small string buffer";
+		index.Insert(path, 1);
+		path.assign(path.size(), 'x'); // the index keeps its own copy
+	}
+
+	const std::pmr::string longer("C:\\export\\a file name longer than the small string buffer, and more");
+	BOOST_CHECK(!index.Find(longer, handle));
+	const std::string_view path = std::string_view(longer).substr(0, longer.size() - 10); // not terminated where it ends
+	BOOST_CHECK(index.Find(path, handle));
+	BOOST_CHECK_EQUAL(handle, 1U);
+	index.Erase(path);
+	BOOST_CHECK(!index.Find(path, handle));
+	BOOST_CHECK_EQUAL(index.GetSize(), 0U);
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+/////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestFileTable)
+BOOST_AUTO_TEST_CASE(HandlesByPath)
+{
+	FileTable table;
+	const std::string root = "C:\\export";
+	const std::string file = root + "\\file";
+	std::pmr::string path;
+
+	BOOST_CHECK_EQUAL(table.GetHandleByPath(root), 0U);
+	BOOST_CHECK_EQUAL(table.GetHandleByPath(file), 1U);
+	BOOST_CHECK_EQUAL(table.GetHandleByPath(file), 1U);
+	BOOST_CHECK(table.GetPathByHandle(1, path));
+	BOOST_CHECK_EQUAL(path, file.c_str());
+	BOOST_CHECK(!table.GetPathByHandle(2, path));
+}
+BOOST_AUTO_TEST_CASE(RemoveDirectory)
+{
+	FileTable table;
+	const std::string root = "C:\\export";
+	const std::string directory = root + "\\directory";
+	const std::string file = directory + "\\file";
+	table.GetHandleByPath(root);
+	const uint64_t directoryHandle = table.GetHandleByPath(directory);
+	const uint64_t fileHandle = table.GetHandleByPath(file);
+	std::pmr::string path;
+
+	BOOST_CHECK(table.RemoveItem(directory));
+	BOOST_CHECK(!table.GetPathByHandle(directoryHandle, path));
+	BOOST_CHECK(!table.GetPathByHandle(fileHandle, path)); // removed along with the directory
+	BOOST_CHECK(!table.RemoveItem(file));
+
+	// the paths are new files now
+	BOOST_CHECK_GT(table.GetHandleByPath(directory), fileHandle);
+	BOOST_CHECK_GT(table.GetHandleByPath(file), fileHandle);
+}
+BOOST_AUTO_TEST_CASE(RenameDirectory)
+{
+	TemporaryExport exported("icenfsd_rename_directory");
+	FileTable table;
+	table.GetHandleByPath(exported.root);
+	const std::string directory = exported.MakeDirectory("from");
+	const std::string file = directory + "\\file";
+	const uint64_t directoryHandle = table.GetHandleByPath(directory);
+	const uint64_t fileHandle = table.GetHandleByPath(file);
+	const std::string renamed = exported.root + "\\to";
+	std::pmr::string path;
+
+	BOOST_CHECK_EQUAL(table.RenameFile(directory, renamed), 0);
+	BOOST_CHECK_EQUAL(table.GetHandleByPath(renamed), directoryHandle);
+	BOOST_CHECK_EQUAL(table.GetHandleByPath(renamed + "\\file"), fileHandle);
+	BOOST_CHECK(table.GetPathByHandle(fileHandle, path));
+	BOOST_CHECK_EQUAL(path, (renamed + "\\file").c_str());
+	BOOST_CHECK_NE(table.GetHandleByPath(file), fileHandle);
+}
+BOOST_AUTO_TEST_CASE(RenameOverFile)
+{
+	TemporaryExport exported("icenfsd_rename_over_file");
+	FileTable table;
+	table.GetHandleByPath(exported.root);
+	const std::string from = exported.MakeFile("from");
+	const std::string to = exported.MakeFile("to");
+	const uint64_t fromHandle = table.GetHandleByPath(from);
+	table.GetHandleByPath(to);
+
+	std::filesystem::remove(to); // rename() does not replace on Windows
+	BOOST_CHECK_EQUAL(table.RenameFile(from, to), 0);
+	BOOST_CHECK_EQUAL(table.GetHandleByPath(to), fromHandle);
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+/////////////////////////////////////////////////////////////////////
+static std::string ChildPath(const std::string& directory, size_t i)
+{
+	return directory + "\\file" + std::to_string(i);
+}
+
+/////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestFileTree)
+BOOST_AUTO_TEST_CASE(LargeDirectory)
+{
+	FileTree tree;
+	const std::string root = "C:\\export";
+	const size_t count = FileTree::CHILD_INDEX_THRESHOLD * 4;
+	tree.AddItem(root, 0);
+	for (size_t i = 0; i < count; i++)
+	{
+		tree.AddItem(ChildPath(root, i), i + 1);
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		auto node = tree.FindFileItemForPath(ChildPath(root, i));
+		BOOST_REQUIRE(node != nullptr);
+		BOOST_CHECK_EQUAL(node->data.handle, i + 1);
+	}
+	BOOST_CHECK(tree.FindFileItemForPath(root + "\\FILE1") == nullptr); // the case has to match
+	BOOST_CHECK(tree.FindFileItemForPath(root + "\\file") == nullptr);
+
+	tree.RemoveItem(ChildPath(root, 7));
+	BOOST_CHECK(tree.FindFileItemForPath(ChildPath(root, 7)) == nullptr);
+	BOOST_CHECK(tree.FindFileItemForPath(ChildPath(root, 8)) != nullptr);
+}
+BOOST_AUTO_TEST_CASE(RenameBetweenDirectories)
+{
+	FileTree tree;
+	const std::string root = "C:\\export";
+	const std::string large = root + "\\large";
+	const std::string small = root + "\\small";
+	const size_t count = FileTree::CHILD_INDEX_THRESHOLD * 2;
+	tree.AddItem(root, 0);
+	tree.AddItem(large, 1);
+	tree.AddItem(small, 2);
+	tree.AddItem(small + "\\other", 3);
+	for (size_t i = 0; i < count; i++)
+	{
+		tree.AddItem(ChildPath(large, i), i + 10);
+	}
+
+	tree.RenameItem(ChildPath(large, 5), small + "\\moved");
+	BOOST_CHECK(tree.FindFileItemForPath(ChildPath(large, 5)) == nullptr);
+	BOOST_REQUIRE(tree.FindFileItemForPath(small + "\\moved") != nullptr);
+	BOOST_CHECK_EQUAL(tree.FindFileItemForPath(small + "\\moved")->data.handle, 15U);
+
+	// renamed over another file of the directory, the renamed one is found
+	tree.RenameItem(ChildPath(large, 6), ChildPath(large, 7));
+	BOOST_REQUIRE(tree.FindFileItemForPath(ChildPath(large, 7)) != nullptr);
+	BOOST_CHECK_EQUAL(tree.FindFileItemForPath(ChildPath(large, 7))->data.handle, 16U);
+	tree.RemoveItem(ChildPath(large, 7));
+	BOOST_REQUIRE(tree.FindFileItemForPath(ChildPath(large, 7)) != nullptr);
+	BOOST_CHECK_EQUAL(tree.FindFileItemForPath(ChildPath(large, 7))->data.handle, 17U);
+}
+BOOST_AUTO_TEST_CASE(DoubleByteNames)
+{
+	FileTree tree;
+	const std::string root = "C:\\export";
+	const std::string directory = root + "\\\x95\x5C"; // the second byte is a backslash
+	const std::string file = directory + "\\\x83\x5C\x83\x5C";
+	tree.AddItem(root, 0);
+	tree.AddItem(directory, 1);
+	tree.AddItem(file, 2);
+
+	auto node = tree.FindFileItemForPath(file);
+	BOOST_REQUIRE(node != nullptr);
+	BOOST_CHECK_EQUAL(node->data.handle, 2U);
+	BOOST_CHECK_EQUAL(node->data.path, "\x83\x5C\x83\x5C");
+	BOOST_CHECK_EQUAL(node->parent->data.path, "\x95\x5C");
+
+	std::string path;
+	tree.GetNodeFullPath(node, path);
+	BOOST_CHECK_EQUAL(path, file);
+}
+BOOST_AUTO_TEST_CASE(DeepPaths)
+{
+	FileTree tree;
+	const std::string root = "C:\\export";
+	tree.AddItem(root, 0);
+	std::vector<std::string> paths;
+	std::string path = root;
+	for (size_t level = 1; level < 20; level++)
+	{
+		path += "\\level" + std::to_string(level);
+		tree.AddItem(path, level);
+		paths.push_back(path);
+	}
+	tree.AddItem(root + "\\level1\\other", 100);
+
+	for (size_t level = 1; level < 20; level++)
+	{
+		auto node = tree.FindFileItemForPath(paths[level - 1]);
+		BOOST_REQUIRE(node != nullptr);
+		BOOST_CHECK_EQUAL(node->data.handle, level);
+	}
+	BOOST_CHECK(tree.FindFileItemForPath(root + "\\level1\\level3") == nullptr);
+	BOOST_CHECK(tree.FindFileItemForPath(root + "\\level1\\other\\level3") == nullptr);
+	BOOST_CHECK(tree.FindFileItemForPath(paths.back() + "\\missing") == nullptr);
+}
+BOOST_AUTO_TEST_CASE(DeepFullPaths)
+{
+	FileTree tree;
+	const std::string root = "C:\\export";
+	tree.AddItem(root, 0);
+	std::vector<std::pair<FileTree::Node, std::string>> nodes;
+	std::string path = root;
+	for (size_t level = 1; level < 20; level++)
+	{
+		path += "\\level" + std::to_string(level);
+		nodes.emplace_back(tree.AddItem(path, level), path);
+	}
+
+	// the deepest first, so the ancestors are cached on the way
+	for (auto node = nodes.rbegin(); node != nodes.rend(); ++node)
+	{
+		std::string fullPath;
+		tree.GetNodeFullPath(node->first, fullPath);
+		BOOST_CHECK_EQUAL(fullPath, node->second);
+	}
+}
+BOOST_AUTO_TEST_CASE(FullPathAfterRename)
+{
+	FileTree tree;
+	const std::string root = "C:\\export";
+	tree.AddItem(root, 0);
+	tree.AddItem(root + "\\a", 1);
+	tree.AddItem(root + "\\a\\b", 2);
+	auto node = tree.AddItem(root + "\\a\\b\\file", 3);
+	tree.AddItem(root + "\\other", 4);
+
+	std::string path;
+	tree.GetNodeFullPath(node, path);
+	BOOST_CHECK_EQUAL(path, root + "\\a\\b\\file");
+	path.clear();
+	tree.GetNodeFullPath(node, path);
+	BOOST_CHECK_EQUAL(path, root + "\\a\\b\\file");
+
+	// an ancestor renamed, and moved under another directory
+	tree.RenameItem(root + "\\a\\b", root + "\\other\\c");
+	path.clear();
+	tree.GetNodeFullPath(node, path);
+	BOOST_CHECK_EQUAL(path, root + "\\other\\c\\file");
+
+	path = "prefix:";
+	tree.GetNodeFullPath(node, path); // appended the way it was
+	BOOST_CHECK_EQUAL(path, "prefix:" + root + "\\other\\c\\file");
+}
+BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
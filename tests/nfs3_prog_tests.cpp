@@ -0,0 +1,188 @@
+/////////////////////////////////////////////////////////////////////
+/// file: tests/nfs3_prog_tests.cpp
+///
+/// summary: unit tests for the NFS3 procedures
+/////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include <boost/test/unit_test.hpp>
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/log/trivial.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+// the file table, the socket stream and the arena are built with their own tests
+#include "../src/NFS3Prog.cpp"
+#include "../src/BufferPool.h"
+#include "../src/HeapCounter.h"
+#include "../src/SocketStream.h"
+#include "temporary_export.h"
+
+/////////////////////////////////////////////////////////////////////
+static void AppendWord(std::vector<unsigned char>& data, uint32_t value)
+{
+	unsigned char bytes[sizeof(value)];
+	XdrEncode(bytes, value);
+	data.insert(data.end(), bytes, bytes + sizeof(bytes));
+}
+
+/////////////////////////////////////////////////////////////////////
+static void AppendHyper(std::vector<unsigned char>& data, uint64_t value)
+{
+	unsigned char bytes[sizeof(value)];
+	XdrEncode(bytes, value);
+	data.insert(data.end(), bytes, bytes + sizeof(bytes));
+}
+
+/////////////////////////////////////////////////////////////////////
+static void AppendHandle(std::vector<unsigned char>& data, uint64_t handle)
+{
+	// the handles are opaque to the clients, the server stores them as they are
+	AppendWord(data, sizeof(handle));
+	const auto bytes = reinterpret_cast<const unsigned char*>(&handle);
+	data.insert(data.end(), bytes, bytes + sizeof(handle));
+}
+
+/////////////////////////////////////////////////////////////////////
+static void AppendName(std::vector<unsigned char>& data, const std::string& name)
+{
+	AppendWord(data, static_cast<uint32_t>(name.size()));
+	data.insert(data.end(), name.begin(), name.end());
+	data.resize(data.size() + ((4 - (name.size() & 3)) & 3));
+}
+
+/////////////////////////////////////////////////////////////////////
+static std::vector<unsigned char> GetReply(const SocketStream& stream)
+{
+	std::vector<SocketStream::Segment> segments;
+	stream.GetOutputSegments(segments);
+	std::vector<unsigned char> reply;
+	for (const auto& segment : segments)
+	{
+		reply.insert(reply.end(), segment.data, segment.data + segment.size);
+	}
+	return reply;
+}
+
+/////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestNFS3Prog)
+BOOST_AUTO_TEST_CASE(SteadyStateWithoutHeap)
+{
+	TemporaryExport exported("icenfsd_nfs3_heap");
+	const std::string file = exported.MakeFile("file");
+	auto fileTable = std::make_shared<FileTable>();
+	const uint64_t rootHandle = fileTable->GetFileHandle(exported.root);
+	const uint64_t fileHandle = fileTable->GetFileHandle(file);
+	NFS3Prog prog(fileTable, 0, 0);
+
+	std::vector<unsigned char> getattr;
+	AppendHandle(getattr, fileHandle);
+	std::vector<unsigned char> lookup;
+	AppendHandle(lookup, rootHandle);
+	AppendName(lookup, "file");
+
+	BufferPool pool;
+	SocketStream stream(pool);
+	RequestArena arena;
+	RPCParam param{ 3, 0, "127.0.0.1" };
+	const auto execute = [&](unsigned int procedure, const std::vector<unsigned char>& arguments, uint64_t& heapAllocations) {
+		param.procNum = procedure;
+		stream.Reset();
+		XdrReader reader(arguments.data(), arguments.size());
+		XdrWriter writer(stream);
+		int result = PRC_FAIL;
+		{
+			// the checks allocate, so they are done outside of the scope
+			RequestArena::Scope scope(arena);
+			result = prog.Process(reader, writer, param);
+			writer.Flush();
+			heapAllocations = scope.GetHeapAllocations();
+		}
+		BOOST_REQUIRE_EQUAL(result, PRC_OK);
+		uint32_t stat = NFS3ERR_SERVERFAULT;
+		BOOST_REQUIRE_GE(stream.GetOutputSize(), sizeof(stat));
+		XdrDecode(stream.GetOutput(), stat);
+		return stat;
+	};
+
+	// the debug records allocate, the server logs from the info level by default
+	boost::log::core::get()->set_filter(boost::log::trivial::severity >= boost::log::trivial::info);
+	uint64_t first = 0;
+	uint64_t getattrAllocations = 0;
+	uint64_t lookupAllocations = 0;
+	BOOST_CHECK_EQUAL(execute(NFSPROC3_GETATTR, getattr, first), NFS3_OK);  // the arena gets its blocks
+	BOOST_CHECK_EQUAL(execute(NFSPROC3_LOOKUP, lookup, first), NFS3_OK);
+	BOOST_CHECK_EQUAL(execute(NFSPROC3_GETATTR, getattr, getattrAllocations), NFS3_OK);
+	BOOST_CHECK_EQUAL(execute(NFSPROC3_LOOKUP, lookup, lookupAllocations), NFS3_OK);
+	boost::log::core::get()->reset_filter();
+
+	BOOST_CHECK_EQUAL(getattrAllocations, 0U);
+	BOOST_CHECK_EQUAL(lookupAllocations, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(ReadAfterUnstableWrite)
+{
+	TemporaryExport exported("icenfsd_nfs3_unstable");
+	const std::string file = exported.MakeFile("file");
+	auto fileTable = std::make_shared<FileTable>();
+	fileTable->GetFileHandle(exported.root);  // the export is mounted first
+	const uint64_t fileHandle = fileTable->GetFileHandle(file);
+	NFS3Prog prog(fileTable, 0, 0);
+
+	const auto write = [fileHandle](const std::string& contents) {
+		std::vector<unsigned char> arguments;
+		AppendHandle(arguments, fileHandle);
+		AppendHyper(arguments, 0);
+		AppendWord(arguments, static_cast<uint32_t>(contents.size()));
+		AppendWord(arguments, UNSTABLE);
+		AppendName(arguments, contents);
+		return arguments;
+	};
+	const auto read = [fileHandle](uint32_t count) {
+		std::vector<unsigned char> arguments;
+		AppendHandle(arguments, fileHandle);
+		AppendHyper(arguments, 0);
+		AppendWord(arguments, count);
+		return arguments;
+	};
+	std::vector<unsigned char> commit;
+	AppendHandle(commit, fileHandle);
+	AppendHyper(commit, 0);
+	AppendWord(commit, 0);
+
+	BufferPool pool;
+	SocketStream stream(pool);
+	RPCParam param{ 3, 0, "127.0.0.1" };
+	const auto execute = [&](unsigned int procedure, const std::vector<unsigned char>& arguments) {
+		param.procNum = procedure;
+		stream.Reset();
+		XdrReader reader(arguments.data(), arguments.size());
+		XdrWriter writer(stream);
+		BOOST_REQUIRE_EQUAL(prog.Process(reader, writer, param), PRC_OK);
+		writer.Flush();
+		uint32_t stat = NFS3ERR_SERVERFAULT;
+		BOOST_REQUIRE_GE(stream.GetOutputSize(), sizeof(stat));
+		XdrDecode(stream.GetOutput(), stat);
+		return stat;
+	};
+	// the data is the end of the reply, its length is a multiple of four
+	const auto readBack = [&](const std::string& contents) {
+		BOOST_REQUIRE_EQUAL(execute(NFSPROC3_READ, read(static_cast<uint32_t>(contents.size()))), NFS3_OK);
+		const std::vector<unsigned char> reply = GetReply(stream);
+		BOOST_REQUIRE_GE(reply.size(), contents.size());
+		return std::string(reply.end() - contents.size(), reply.end());
+	};
+
+	// the file stays open until COMMIT, the data must be readable before
+	BOOST_REQUIRE_EQUAL(execute(NFSPROC3_WRITE, write("unstable")), NFS3_OK);
+	BOOST_CHECK_EQUAL(readBack("unstable"), "unstable");
+
+	// the writes after COMMIT open the file again
+	BOOST_REQUIRE_EQUAL(execute(NFSPROC3_COMMIT, commit), NFS3_OK);
+	BOOST_REQUIRE_EQUAL(execute(NFSPROC3_WRITE, write("reopened")), NFS3_OK);
+	BOOST_CHECK_EQUAL(readBack("reopened"), "reopened");
+	BOOST_REQUIRE_EQUAL(execute(NFSPROC3_COMMIT, commit), NFS3_OK);
+}
+BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
@@ -0,0 +1,102 @@
+/////////////////////////////////////////////////////////////////////
+/// file: tests/record_assembler_tests.cpp
+///
+/// summary: unit tests for the RPC record marking decoder
+/////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include <boost/test/unit_test.hpp>
+#include <vector>
+#include <string>
+
+#include "../src/RecordAssembler.cpp"
+
+/////////////////////////////////////////////////////////////////////
+static std::vector<unsigned char> Fragment(const std::string& payload, bool last)
+{
+	const uint32_t header = static_cast<uint32_t>(payload.size()) | (last ? 0x80000000 : 0);
+	std::vector<unsigned char> result = {
+		static_cast<unsigned char>(header >> 24), static_cast<unsigned char>(header >> 16),
+		static_cast<unsigned char>(header >> 8), static_cast<unsigned char>(header)
+	};
+	result.insert(result.end(), payload.begin(), payload.end());
+	return result;
+}
+
+/////////////////////////////////////////////////////////////////////
+static std::string ToString(const RecordAssembler::Record& record)
+{
+	return std::string(record.begin(), record.end());
+}
+
+/////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestRecordAssembler)
+BOOST_AUTO_TEST_CASE(SingleFragment)
+{
+	RecordAssembler assembler;
+	RecordAssembler::Record record;
+	const auto data = Fragment("hello", true);
+
+	assembler.Append(data.data(), data.size());
+	BOOST_CHECK(assembler.NextRecord(record));
+	BOOST_CHECK_EQUAL(ToString(record), "hello");
+	BOOST_CHECK(!assembler.NextRecord(record));
+}
+BOOST_AUTO_TEST_CASE(ByteByByte)
+{
+	RecordAssembler assembler;
+	RecordAssembler::Record record;
+	const auto data = Fragment("split", true);
+
+	for (size_t i = 0; i + 1 < data.size(); i++)
+	{
+		assembler.Append(&data[i], 1);
+		BOOST_CHECK(!assembler.NextRecord(record));
+	}
+	assembler.Append(&data.back(), 1);
+	BOOST_CHECK(assembler.NextRecord(record));
+	BOOST_CHECK_EQUAL(ToString(record), "split");
+}
+BOOST_AUTO_TEST_CASE(MultipleFragments)
+{
+	RecordAssembler assembler;
+	RecordAssembler::Record record;
+	auto data = Fragment("one,", false);
+	const auto empty = Fragment("", false);
+	const auto last = Fragment("two", true);
+	data.insert(data.end(), empty.begin(), empty.end());
+	data.insert(data.end(), last.begin(), last.end());
+
+	assembler.Append(data.data(), data.size());
+	BOOST_CHECK(assembler.NextRecord(record));
+	BOOST_CHECK_EQUAL(ToString(record), "one,two");
+}
+BOOST_AUTO_TEST_CASE(PipelinedRecords)
+{
+	RecordAssembler assembler;
+	RecordAssembler::Record record;
+	auto data = Fragment("first", true);
+	const auto empty = Fragment("", true);
+	const auto second = Fragment("second", true);
+	data.insert(data.end(), empty.begin(), empty.end());
+	data.insert(data.end(), second.begin(), second.end());
+
+	assembler.Append(data.data(), data.size());
+	BOOST_CHECK(assembler.NextRecord(record));
+	BOOST_CHECK_EQUAL(ToString(record), "first");
+	BOOST_CHECK(assembler.NextRecord(record));
+	BOOST_CHECK(record.empty());
+	BOOST_CHECK(assembler.NextRecord(record));
+	BOOST_CHECK_EQUAL(ToString(record), "second");
+	BOOST_CHECK(!assembler.NextRecord(record));
+}
+BOOST_AUTO_TEST_CASE(RecordTooLarge)
+{
+	RecordAssembler assembler(8);
+	const auto first = Fragment("12345", false);
+	const auto second = Fragment("6789", true);
+
+	BOOST_CHECK_NO_THROW(assembler.Append(first.data(), first.size()));
+	BOOST_CHECK_THROW(assembler.Append(second.data(), second.size()), std::runtime_error);
+}
+BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
@@ -0,0 +1,94 @@
+/////////////////////////////////////////////////////////////////////
+/// file: tests/request_arena_tests.cpp
+///
+/// summary: unit tests for the arena of the request temporaries
+/////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include <boost/test/unit_test.hpp>
+#include <cstdint>
+#include <string>
+
+#include "../src/HeapCounter.cpp"
+#include "../src/RequestArena.cpp"
+
+/////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestRequestArena)
+BOOST_AUTO_TEST_CASE(Alignment)
+{
+	RequestArena arena(256);
+	void* byte = arena.allocate(1, 1);
+	void* word = arena.allocate(8, 8);
+	void* wide = arena.allocate(16, 64);
+
+	BOOST_CHECK(byte != word);
+	BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(word) % 8, 0U);
+	BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(wide) % 64, 0U);
+	BOOST_CHECK_EQUAL(arena.GetUsedSize(), 25U);
+}
+BOOST_AUTO_TEST_CASE(ReuseAfterReset)
+{
+	RequestArena arena(256);
+	for (int i = 0; i < 2; i++)
+	{
+		RequestArena::Scope scope(arena);
+		static_cast<void>(arena.allocate(200, 1));
+		static_cast<void>(arena.allocate(200, 1));    // a second block
+		static_cast<void>(arena.allocate(1000, 1));   // an oversized one
+	}
+
+	const uint64_t heapAllocations = HeapCounter::GetThreadAllocations();
+	void* first = nullptr;
+	{
+		RequestArena::Scope scope(arena);
+		first = arena.allocate(200, 1);
+		static_cast<void>(arena.allocate(200, 1));
+		static_cast<void>(arena.allocate(1000, 1));
+	}
+	BOOST_CHECK_EQUAL(HeapCounter::GetThreadAllocations(), heapAllocations); // the blocks are kept
+	BOOST_CHECK_EQUAL(arena.GetUsedSize(), 0U);
+
+	RequestArena::Scope scope(arena);
+	BOOST_CHECK(arena.allocate(10, 1) == first);
+}
+BOOST_AUTO_TEST_CASE(CurrentArena)
+{
+	RequestArena outer;
+	RequestArena inner;
+	BOOST_CHECK(RequestArena::GetCurrent() == nullptr);
+	{
+		RequestArena::Scope outerScope(outer);
+		BOOST_CHECK(RequestArena::GetCurrent() == &outer);
+		{
+			RequestArena::Scope innerScope(inner);
+			BOOST_CHECK(RequestArena::GetCurrent() == &inner);
+		}
+		BOOST_CHECK(RequestArena::GetCurrent() == &outer);
+	}
+	BOOST_CHECK(RequestArena::GetCurrent() == nullptr);
+}
+BOOST_AUTO_TEST_CASE(HeapAllocationsOfScope)
+{
+	RequestArena arena;
+	const auto before = RequestArena::GetStatistics();
+	uint64_t arenaString = 0;
+	uint64_t heapString = 0;
+	{
+		// the checks allocate, so they are done outside of the scope
+		RequestArena::Scope scope(arena);
+		std::pmr::string inArena("a path long enough not to fit the string itself", &arena);
+		arenaString = scope.GetHeapAllocations();
+
+		std::string onHeap("a path long enough not to fit the string itself");
+		heapString = scope.GetHeapAllocations();
+	}
+	const auto after = RequestArena::GetStatistics();
+
+	BOOST_CHECK_EQUAL(arenaString, 0U);
+	BOOST_CHECK_EQUAL(heapString, 1U);
+	BOOST_CHECK_EQUAL(after.requests - before.requests, 1U);
+	BOOST_CHECK_EQUAL(after.allocations - before.allocations, 1U);
+	BOOST_CHECK_GT(after.ownAllocations, before.ownAllocations);
+	BOOST_CHECK_EQUAL(after.heapAllocations - before.heapAllocations, 1U);
+}
+BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
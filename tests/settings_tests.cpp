@@ -80,7 +80,38 @@ BOOST_FIXTURE_TEST_CASE(ValidExport, ParseExportsFileFixture)
 
 	const auto& item = *result.cbegin();
 	BOOST_CHECK_EQUAL(item.first, "C:\\Temp");
-	BOOST_CHECK_EQUAL(item.second, "/test");
+	BOOST_CHECK_EQUAL(item.second.alias, "/test");
+	BOOST_CHECK(!item.second.zeroCopyRead);
+}
+
+/////////////////////////////////////////////////////////////////////
+BOOST_FIXTURE_TEST_CASE(ExportOptions, ParseExportsFileFixture)
+{
+	const std::string exports =
+		"C:\\Media > /media ( zerocopy )\n"
+		"C:\\Temp > /test ()\n";
+	CreateExports(exports);
+	Exports result;
+	BOOST_CHECK_NO_THROW(result = ParseExportsFile(exportsFile));
+	BOOST_REQUIRE_EQUAL(2, result.size());
+
+	const auto& media = result.at("C:\\Media");
+	BOOST_CHECK_EQUAL(media.alias, "/media");
+	BOOST_CHECK(media.zeroCopyRead);
+	const auto& temp = result.at("C:\\Temp");
+	BOOST_CHECK_EQUAL(temp.alias, "/test");
+	BOOST_CHECK(!temp.zeroCopyRead);
+}
+
+/////////////////////////////////////////////////////////////////////
+BOOST_FIXTURE_TEST_CASE(InvalidExportOptions, ParseExportsFileFixture)
+{
+	Exports result;
+	CreateExports("C:\\Media > /media (sync)\n");
+	BOOST_CHECK_THROW(result = ParseExportsFile(exportsFile), std::runtime_error);
+	CreateExports("C:\\Media > /media (zerocopy\n");
+	BOOST_CHECK_THROW(result = ParseExportsFile(exportsFile), std::runtime_error);
+	BOOST_CHECK(result.empty());
 }
 BOOST_AUTO_TEST_SUITE_END()
 
@@ -138,6 +169,27 @@ BOOST_AUTO_TEST_CASE(InvalidCommandLine)
 	char* commandLine[] = { "icenfsd.exe", "-u", "ice" };
 	BOOST_CHECK_THROW(Settings(3, commandLine), std::runtime_error);
 }
+BOOST_AUTO_TEST_CASE(InvalidConnectionLimits)
+{
+	char* commandLine[] = { "icenfsd.exe", "--soft-connection-limit", "10", "--hard-connection-limit", "5" };
+	BOOST_CHECK_THROW(Settings(5, commandLine), std::runtime_error);
+}
+BOOST_AUTO_TEST_CASE(InvalidKeepAlive)
+{
+	char* commandLine[] = { "icenfsd.exe", "--keepalive-interval", "0" };
+	BOOST_CHECK_THROW(Settings(3, commandLine), std::runtime_error);
+
+	char* disabled[] = { "icenfsd.exe", "--keepalive-time", "0", "--keepalive-interval", "0" };
+	BOOST_CHECK_NO_THROW(Settings(5, disabled));
+}
+BOOST_AUTO_TEST_CASE(IoEngineOption)
+{
+	char* completionPort[] = { "icenfsd.exe", "--io-engine", "iocp" };
+	BOOST_CHECK(Settings(3, completionPort).GetIoEngine() == IoEngine::CompletionPort);
+
+	char* unknown[] = { "icenfsd.exe", "--io-engine", "uring" };
+	BOOST_CHECK_THROW(Settings(3, unknown), std::runtime_error);
+}
 BOOST_AUTO_TEST_CASE(DefaultSettings)
 {
 	char* commandLine[] = {
@@ -147,6 +199,14 @@ BOOST_AUTO_TEST_CASE(DefaultSettings)
 	BOOST_CHECK_NO_THROW(settings = std::make_unique<Settings>(1, commandLine));
 	BOOST_CHECK_EQUAL(settings->GetUid(), 0U);
 	BOOST_CHECK_EQUAL(settings->GetGid(), 0U);
+	BOOST_CHECK_EQUAL(settings->GetIoThreads(), DEFAULT_IO_THREADS);
+	BOOST_CHECK_EQUAL(settings->GetWorkerThreads(), DefaultWorkerThreads());
+	BOOST_CHECK(settings->GetIoEngine() == IoEngine::Poll);
+	BOOST_CHECK_EQUAL(settings->GetSoftConnectionLimit(), DEFAULT_SOFT_CONNECTION_LIMIT);
+	BOOST_CHECK_EQUAL(settings->GetHardConnectionLimit(), DEFAULT_HARD_CONNECTION_LIMIT);
+	BOOST_CHECK_EQUAL(settings->GetIdleTimeout(), DEFAULT_IDLE_TIMEOUT);
+	BOOST_CHECK_EQUAL(settings->GetKeepAliveTime(), DEFAULT_KEEPALIVE_TIME);
+	BOOST_CHECK_EQUAL(settings->GetKeepAliveInterval(), DEFAULT_KEEPALIVE_INTERVAL);
 	BOOST_CHECK(settings->GetExports().empty());
 
 	const sockaddr_in expectedNfsEndpoint = {
@@ -0,0 +1,331 @@
+/////////////////////////////////////////////////////////////////////
+/// file: tests/socket_stream_tests.cpp
+///
+/// summary: unit tests for the socket stream and its buffer pool
+/////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include <boost/test/unit_test.hpp>
+#include <vector>
+
+#include "../src/BufferPool.cpp"
+#include "../src/SocketStream.cpp"
+#include "../src/XdrStream.h"
+
+/////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestBufferPool)
+BOOST_AUTO_TEST_CASE(SizeClasses)
+{
+	BufferPool pool;
+	auto small = pool.Acquire(100);
+	auto medium = pool.Acquire(5000);
+	auto huge = pool.Acquire(3 * 1024 * 1024);
+	BOOST_CHECK_EQUAL(small.capacity, 4 * 1024U);
+	BOOST_CHECK_EQUAL(medium.capacity, 16 * 1024U);
+	BOOST_CHECK_EQUAL(huge.capacity, 3 * 1024 * 1024U);
+
+	pool.Release(small);
+	pool.Release(medium);
+	pool.Release(huge);
+
+	const auto stats = pool.GetStatistics();
+	BOOST_CHECK_EQUAL(stats.front().idle, 1U);
+	BOOST_CHECK_EQUAL(stats.back().bufferSize, 0U);
+	BOOST_CHECK_EQUAL(stats.back().idle, 0U); // oversized buffers are freed
+	for (const auto& sizeClass : stats)
+	{
+		BOOST_CHECK_EQUAL(sizeClass.inUse, 0U);
+	}
+}
+BOOST_AUTO_TEST_CASE(Reuse)
+{
+	BufferPool pool;
+	pool.Release(pool.Acquire(10));
+	pool.Release(pool.Acquire(20));
+
+	const auto& stats = pool.GetStatistics().front();
+	BOOST_CHECK_EQUAL(stats.acquired, 2U);
+	BOOST_CHECK_EQUAL(stats.allocated, 1U);
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+/////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestSocketStream)
+BOOST_AUTO_TEST_CASE(BigEndianRoundTrip)
+{
+	BufferPool pool;
+	SocketStream stream(pool);
+	stream.Write(0x01020304U);
+	stream.Write8(0x0102030405060708ULL);
+
+	BOOST_REQUIRE_EQUAL(stream.GetOutputSize(), 12U);
+	const unsigned char* output = stream.GetOutput();
+	BOOST_CHECK_EQUAL(output[0], 0x01);
+	BOOST_CHECK_EQUAL(output[3], 0x04);
+	BOOST_CHECK_EQUAL(output[4], 0x01);
+	BOOST_CHECK_EQUAL(output[11], 0x08);
+
+	const std::vector<unsigned char> input(output, output + stream.GetOutputSize());
+	stream.SetInput(input.data(), input.size());
+	uint32_t value = 0;
+	uint64_t value8 = 0;
+	BOOST_CHECK_EQUAL(stream.Read(&value), 4U);
+	BOOST_CHECK_EQUAL(stream.Read8(&value8), 8U);
+	BOOST_CHECK_EQUAL(value, 0x01020304U);
+	BOOST_CHECK_EQUAL(value8, 0x0102030405060708ULL);
+	BOOST_CHECK_EQUAL(stream.GetSize(), 0U);
+	BOOST_CHECK_EQUAL(stream.Read(&value), 0U);
+}
+BOOST_AUTO_TEST_CASE(WordArrays)
+{
+	BufferPool pool;
+	SocketStream stream(pool);
+	const std::vector<uint32_t> words = { 1, 2, 3, 4, 5, 6, 0x01020304, 0xFFFFFFFE, 0x80000000 };
+	stream.Write(0xAABBCCDDU);
+	stream.WriteWords(words.data(), words.size());
+
+	BOOST_REQUIRE_EQUAL(stream.GetOutputSize(), 4 * (words.size() + 1));
+	const unsigned char* output = stream.GetOutput();
+	BOOST_CHECK_EQUAL(output[4 + 3], 0x01);
+	BOOST_CHECK_EQUAL(output[4 + 6 * 4], 0x01);
+	BOOST_CHECK_EQUAL(output[4 + 6 * 4 + 3], 0x04);
+
+	// a truncated word is left in the stream
+	const std::vector<unsigned char> input(output, output + stream.GetOutputSize() - 1);
+	stream.SetInput(input.data(), input.size());
+	uint32_t first = 0;
+	std::vector<uint32_t> read(words.size(), 0);
+	BOOST_CHECK_EQUAL(stream.Read(&first), 4U);
+	BOOST_CHECK_EQUAL(first, 0xAABBCCDDU);
+	BOOST_CHECK_EQUAL(stream.ReadWords(read.data(), read.size()), words.size() - 1);
+	BOOST_CHECK_EQUAL(stream.GetSize(), 3U);
+	read.back() = words.back();
+	BOOST_TEST(read == words, boost::test_tools::per_element());
+}
+BOOST_AUTO_TEST_CASE(GrowWithoutTruncation)
+{
+	BufferPool pool;
+	SocketStream stream(pool);
+	const std::vector<unsigned char> chunk(1000, 0xAB);
+	const size_t total = 2 * 1024 * 1024;
+
+	size_t written = 0;
+	for (; written < total; written += chunk.size())
+	{
+		stream.Write(chunk.data(), chunk.size());
+	}
+	stream.Seek(0, SEEK_SET);
+	stream.Write(0xFFFFFFFFU);
+
+	BOOST_CHECK_EQUAL(stream.GetOutputSize(), written);
+	BOOST_CHECK_EQUAL(stream.GetOutput()[4], 0xAB);
+	BOOST_CHECK_EQUAL(stream.GetOutput()[stream.GetOutputSize() - 1], 0xAB);
+
+	stream.Reset();
+	BOOST_CHECK_EQUAL(stream.GetOutputSize(), 0U);
+	for (const auto& sizeClass : pool.GetStatistics())
+	{
+		BOOST_CHECK_EQUAL(sizeClass.inUse, 0U);
+	}
+}
+BOOST_AUTO_TEST_CASE(AttachedSegment)
+{
+	BufferPool pool;
+	SocketStream stream(pool);
+	stream.Write(0x11111111U);
+
+	unsigned char* data = stream.AcquireSegment(100);
+	memset(data, 0xCD, 6);
+	stream.CommitSegment(6);
+	stream.Write(0x2222U);
+
+	BOOST_CHECK_EQUAL(stream.GetOutputSize(), 14U);
+	BOOST_CHECK_EQUAL(stream.GetPosition(), 14U);
+
+	std::vector<SocketStream::Segment> segments;
+	stream.GetOutputSegments(segments);
+	BOOST_REQUIRE_EQUAL(segments.size(), 3U);
+	BOOST_CHECK_EQUAL(segments[0].size, 4U);
+	BOOST_CHECK(segments[1].data == data);
+	BOOST_CHECK_EQUAL(segments[1].size, 6U);
+	BOOST_CHECK_EQUAL(segments[2].size, 4U);
+	BOOST_CHECK_EQUAL(segments[2].data[3], 0x22);
+
+	// the bytes around the segment may be rewritten, the segment itself not
+	stream.Seek(0, SEEK_SET);
+	stream.Write(0x33333333U);
+	BOOST_CHECK_EQUAL(stream.GetPosition(), 10U);
+	BOOST_CHECK_EQUAL(segments[0].data[0], 0x33);
+	BOOST_CHECK_THROW(stream.Seek(-8, SEEK_END), std::runtime_error);
+	stream.Seek(-4, SEEK_END);
+	BOOST_CHECK_EQUAL(stream.GetPosition(), 10U);
+
+	stream.Reset();
+	BOOST_CHECK_EQUAL(stream.GetOutputSize(), 0U);
+	stream.GetOutputSegments(segments);
+	BOOST_CHECK(segments.empty());
+	BOOST_CHECK_EQUAL(pool.GetStatistics().front().inUse, 0U);
+}
+BOOST_AUTO_TEST_CASE(DroppedSegment)
+{
+	BufferPool pool;
+	SocketStream stream(pool);
+	stream.AcquireSegment(10);
+	stream.CommitSegment(0);
+	stream.AcquireSegment(10);
+	BOOST_CHECK_THROW(stream.CommitSegment(1024 * 1024), std::runtime_error);
+	BOOST_CHECK_EQUAL(stream.GetOutputSize(), 0U);
+
+	stream.Reset();
+	BOOST_CHECK_EQUAL(pool.GetStatistics().front().inUse, 0U);
+}
+BOOST_AUTO_TEST_CASE(AttachedFile)
+{
+	BufferPool pool;
+	SocketStream stream(pool, true);
+	BOOST_REQUIRE(stream.CanAttachFile());
+	stream.Write(0x11111111U);
+	stream.AttachFile(INVALID_HANDLE_VALUE, 100, 10);  // closing the pseudo handle does nothing
+	stream.Write(0x2222U);
+
+	BOOST_CHECK_EQUAL(stream.GetOutputSize(), 18U);
+	BOOST_CHECK_EQUAL(stream.GetPosition(), 18U);
+
+	SocketStream::FileRange range{};
+	SocketStream::Segment head{}, tail{};
+	BOOST_REQUIRE(stream.GetOutputFile(range, head, tail));
+	BOOST_CHECK_EQUAL(range.offset, 100U);
+	BOOST_CHECK_EQUAL(range.size, 10U);
+	BOOST_CHECK_EQUAL(head.size, 4U);
+	BOOST_CHECK_EQUAL(tail.size, 4U);
+	BOOST_CHECK_EQUAL(tail.data[3], 0x22);
+
+	stream.AcquireSegment(10);
+	BOOST_CHECK_THROW(stream.CommitSegment(5), std::runtime_error);
+
+	stream.Reset();
+	BOOST_CHECK(!stream.GetOutputFile(range, head, tail));
+	BOOST_CHECK_EQUAL(stream.GetOutputSize(), 0U);
+}
+BOOST_AUTO_TEST_CASE(FileNotSupported)
+{
+	BufferPool pool;
+	SocketStream stream(pool);
+	BOOST_CHECK(!stream.CanAttachFile());
+	BOOST_CHECK_THROW(stream.AttachFile(INVALID_HANDLE_VALUE, 0, 10), std::runtime_error);
+	BOOST_CHECK_EQUAL(stream.GetOutputSize(), 0U);
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+/////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestXdrWriter)
+BOOST_AUTO_TEST_CASE(WindowGrowth)
+{
+	BufferPool pool;
+	SocketStream stream(pool);
+	stream.Write(0x01020304U);
+
+	XdrWriter writer(stream);
+	BOOST_CHECK_EQUAL(writer.GetPosition(), 4U);
+	for (uint32_t i = 0; i < 10000; i++) // over the smallest buffer size class
+	{
+		writer.Write(i);
+	}
+	writer.Write8(0x0102030405060708ULL);
+	BOOST_CHECK_EQUAL(writer.GetPosition(), 4 + 40000 + 8U);
+	BOOST_CHECK_LT(stream.GetOutputSize(), writer.GetPosition()); // the last window is not passed to the stream yet
+
+	writer.Seek(4, SEEK_SET);
+	writer.Write(0xFFFFFFFFU);
+	writer.Seek(0, SEEK_END);
+	writer.Write(0xEEEEEEEEU);
+	writer.Flush();
+
+	BOOST_REQUIRE_EQUAL(stream.GetOutputSize(), 4 + 40000 + 8 + 4U);
+	const unsigned char* output = stream.GetOutput();
+	BOOST_CHECK_EQUAL(output[0], 0x01);
+	BOOST_CHECK_EQUAL(output[4], 0xFF);
+	BOOST_CHECK_EQUAL(output[4 + 4 * 9999 + 3], 9999 & 0xFF);
+	BOOST_CHECK_EQUAL(output[4 + 40000], 0x01);
+	BOOST_CHECK_EQUAL(output[4 + 40000 + 8], 0xEE);
+}
+BOOST_AUTO_TEST_CASE(Segments)
+{
+	BufferPool pool;
+	SocketStream stream(pool);
+	XdrWriter writer(stream);
+	writer.Write(0x11111111U);
+
+	unsigned char* data = writer.AcquireSegment(100);
+	memset(data, 0xAB, 100);
+	writer.CommitSegment(100);
+	BOOST_CHECK_EQUAL(writer.GetPosition(), 104U);
+	writer.Write(0x22222222U);
+	writer.Flush();
+
+	std::vector<SocketStream::Segment> segments;
+	stream.GetOutputSegments(segments);
+	BOOST_REQUIRE_EQUAL(segments.size(), 3U);
+	BOOST_CHECK_EQUAL(segments[0].size, 4U);
+	BOOST_CHECK_EQUAL(segments[1].size, 100U);
+	BOOST_CHECK_EQUAL(segments[2].size, 4U);
+	BOOST_CHECK_EQUAL(segments[2].data[0], 0x22);
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+/////////////////////////////////////////////////////////////////////
+// The byte by byte reversal the stream did before, the reference for the bulk conversion
+static void ReverseWords(unsigned char* data, const uint32_t* values, size_t count)
+{
+	for (size_t word = 0; word < count; word++)
+	{
+		const unsigned char* p = reinterpret_cast<const unsigned char*>(values + word);
+		for (int32_t i = sizeof(uint32_t) - 1; i >= 0; i--)
+		{
+			data[word * sizeof(uint32_t) + i] = p[sizeof(uint32_t) - 1 - i];
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestByteOrder)
+BOOST_AUTO_TEST_CASE(EncodeWords)
+{
+	// every count up to a few vector widths, so the unaligned tails are covered
+	for (size_t count = 0; count <= 37; count++)
+	{
+		std::vector<uint32_t> words(count);
+		for (size_t i = 0; i < words.size(); i++)
+		{
+			words[i] = static_cast<uint32_t>((i + 1) * 0x9E3779B9U);
+		}
+		std::vector<unsigned char> expected(count * sizeof(uint32_t));
+		std::vector<unsigned char> actual(expected.size() + 1, 0xCC);
+		ReverseWords(expected.data(), words.data(), count);
+
+		BOOST_CHECK(XdrEncodeWords(actual.data(), words.data(), count) == actual.data() + expected.size());
+		BOOST_CHECK_EQUAL(actual.back(), 0xCC);
+		actual.pop_back();
+		BOOST_TEST(actual == expected, "count " << count);
+	}
+}
+BOOST_AUTO_TEST_CASE(DecodeWords)
+{
+	for (size_t count = 0; count <= 37; count++)
+	{
+		std::vector<unsigned char> data(count * sizeof(uint32_t));
+		for (size_t i = 0; i < data.size(); i++)
+		{
+			data[i] = static_cast<unsigned char>(i * 31 + 7);
+		}
+		std::vector<uint32_t> actual(count + 1, 0xCCCCCCCCU);
+
+		BOOST_CHECK(XdrDecodeWords(data.data(), actual.data(), count) == data.data() + data.size());
+		BOOST_CHECK_EQUAL(actual.back(), 0xCCCCCCCCU);
+		actual.pop_back();
+		std::vector<unsigned char> encoded(data.size());
+		ReverseWords(encoded.data(), actual.data(), count);
+		BOOST_TEST(encoded == data, "count " << count);
+	}
+}
+BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
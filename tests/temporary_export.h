@@ -0,0 +1,48 @@
+/////////////////////////////////////////////////////////////////////
+/// file: tests/temporary_export.h
+///
+/// summary: directory of the files a test exports, removed after it
+/////////////////////////////////////////////////////////////////////
+
+#ifndef ICENFSD_TESTS_TEMPORARY_EXPORT_H
+#define ICENFSD_TESTS_TEMPORARY_EXPORT_H
+
+#include <boost/test/unit_test.hpp>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+struct TemporaryExport
+{
+	explicit TemporaryExport(const std::string& name)
+		: root((std::filesystem::temp_directory_path() / name).string())
+	{
+		std::filesystem::remove_all(root);
+		std::filesystem::create_directories(root);
+	}
+
+	~TemporaryExport()
+	{
+		std::error_code error;
+		std::filesystem::remove_all(root, error);
+	}
+
+	std::string MakeFile(const std::string& name) const
+	{
+		const std::string path = root + "\\" + name;
+		std::ofstream file(path);
+		BOOST_REQUIRE(file.is_open());
+		return path;
+	}
+
+	std::string MakeDirectory(const std::string& name) const
+	{
+		const std::string path = root + "\\" + name;
+		std::filesystem::create_directory(path);
+		return path;
+	}
+
+	const std::string root;
+};
+
+#endif // ICENFSD_TESTS_TEMPORARY_EXPORT_H
\ No newline at end of file
@@ -0,0 +1,101 @@
+/////////////////////////////////////////////////////////////////////
+/// file: tests/xdr_tests.cpp
+///
+/// summary: unit tests for the XDR encoding of the fixed-size structures
+/////////////////////////////////////////////////////////////////////
+
+#include "stdafx.h"
+#include <boost/test/unit_test.hpp>
+#include <vector>
+
+#include "../src/XdrStream.h"
+
+struct XdrTime
+{
+	uint32_t seconds;
+	uint32_t nseconds;
+};
+
+struct XdrRecord
+{
+	bool flag;
+	uint64_t size;
+	XdrTime time;
+};
+
+template <>
+struct XdrFields<XdrTime>
+{
+	static constexpr auto members = std::make_tuple(&XdrTime::seconds, &XdrTime::nseconds);
+};
+
+template <>
+struct XdrFields<XdrRecord>
+{
+	static constexpr auto members = std::make_tuple(&XdrRecord::flag, &XdrRecord::size, &XdrRecord::time);
+};
+
+/////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_SUITE(TestXdr)
+BOOST_AUTO_TEST_CASE(Sizes)
+{
+	static_assert(XdrSize<bool> == 4, "booleans take a word");
+	static_assert(XdrSize<uint64_t> == 8, "hypers take two words");
+	static_assert(XdrSize<XdrTime> == 8, "members are summed");
+	static_assert(XdrSize<XdrRecord> == 20, "nested structures are summed");
+}
+
+/////////////////////////////////////////////////////////////////////
+BOOST_AUTO_TEST_CASE(BigEndianLayout)
+{
+	const XdrRecord record{ true, 0x0102030405060708, { 0x11121314, 0x21222324 } };
+	unsigned char buffer[XdrSize<XdrRecord>] = {};
+
+	BOOST_TEST(XdrEncode(buffer, record) == buffer + sizeof(buffer));
+
+	const std::vector<unsigned char> expected = {
+		0, 0, 0, 1,
+		1, 2, 3, 4, 5, 6, 7, 8,
+		0x11, 0x12, 0x13, 0x14,
+		0x21, 0x22, 0x23, 0x24
+	};
+	BOOST_TEST(std::vector<unsigned char>(buffer, buffer + sizeof(buffer)) == expected, boost::test_tools::per_element());
+}
+BOOST_AUTO_TEST_CASE(Reader)
+{
+	const unsigned char message[] = { 0, 0, 0, 7, 1, 2, 3, 4, 5, 6, 7, 8, 0xAA, 0xBB, 0xCC, 0xDD, 0x11, 0x22 };
+	XdrReader reader(message, sizeof(message));
+	uint32_t value = 0;
+	uint64_t value8 = 0;
+	unsigned char bytes[2] = {};
+
+	BOOST_CHECK_EQUAL(reader.Read(&value), 4U);
+	BOOST_CHECK_EQUAL(value, 7U);
+	BOOST_CHECK_EQUAL(reader.Read8(&value8), 8U);
+	BOOST_CHECK_EQUAL(value8, 0x0102030405060708ULL);
+	BOOST_CHECK_EQUAL(reader.Skip(2), 2U);
+	BOOST_CHECK_EQUAL(reader.Read(bytes, 2), 2U);
+	BOOST_CHECK_EQUAL(bytes[1], 0xDD);
+	BOOST_CHECK_EQUAL(reader.GetSize(), 2U);
+
+	// a truncated value takes what is left, the way the socket stream does
+	value = 0;
+	BOOST_CHECK_EQUAL(reader.ReadWords(&value, 1), 0U);
+	BOOST_CHECK_EQUAL(reader.Read(&value), 2U);
+	BOOST_CHECK_EQUAL(value, 0x11220000U);
+	BOOST_CHECK_EQUAL(reader.Skip(10), 0U);
+}
+BOOST_AUTO_TEST_CASE(ReaderView)
+{
+	const unsigned char message[] = { 0, 0, 0, 3, 'a', 'b', 'c', 0 };
+	XdrReader reader(message, sizeof(message));
+	uint32_t length = 0;
+
+	reader.Read(&length);
+	const unsigned char* data = reader.View(length);
+	BOOST_CHECK(data == message + 4);
+	BOOST_CHECK_EQUAL(reader.GetSize(), 1U);
+	BOOST_CHECK(reader.View(2) == nullptr); // nothing is taken then
+	BOOST_CHECK_EQUAL(reader.GetSize(), 1U);
+}
+BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file